@@ -33,6 +33,7 @@
 #include "Poco/Task.h"
 #include "Poco/TaskManager.h"
 #include "Poco/Util/HelpFormatter.h"
+#include "Poco/Util/IntValidator.h"
 #include "Poco/Util/Option.h"
 #include "Poco/Util/OptionSet.h"
 #include "Poco/Util/ServerApplication.h"
@@ -40,6 +41,7 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "portutils.h"
 
@@ -53,6 +55,7 @@ using Poco::Task;
 using Poco::TaskManager;
 using Poco::Util::Application;
 using Poco::Util::HelpFormatter;
+using Poco::Util::IntValidator;
 using Poco::Util::Option;
 using Poco::Util::OptionCallback;
 using Poco::Util::OptionSet;
@@ -60,25 +63,106 @@ using Poco::Util::ServerApplication;
 
 class ServerTask : public Task {
 public:
-  ServerTask(std::string srv_addr_port) : Task("AssuranceBrkrAppServerTask") {
+  ServerTask(std::string srv_addr_port, unsigned threads)
+      : Task("AssuranceBrkrAppServerTask") {
     _logger.information("Server task starting");
     server_addr_port = srv_addr_port;
+    cq_threads = threads;
   }
 
   void runTask() {
     Application &app = Application::instance();
-    RunServer(_logger, server_addr_port); // Runs forever
+    RunServer(_logger, server_addr_port, cq_threads); // Runs until cancelled
     _logger.information("Exiting server task");
   }
 
+  void cancel() {
+    StopServer();
+    Task::cancel();
+  }
+
 private:
   Logger &_logger = Logger::get("Application");
   std::string server_addr_port;
+  unsigned cq_threads;
+};
+
+// Saves the monitor states periodically, and once more when cancelled
+class CheckpointTask : public Task {
+public:
+  CheckpointTask(std::string path) : Task("AssuranceBrkrAppCheckpointTask") {
+    checkpoint_path = path;
+  }
+
+  void runTask() {
+    while (!sleep(CHECKPOINT_INTERVAL_MS)) {
+      CheckpointMonitors(_logger, checkpoint_path);
+    }
+    CheckpointMonitors(_logger, checkpoint_path);
+  }
+
+private:
+  static const long CHECKPOINT_INTERVAL_MS = 1000;
+  Logger &_logger = Logger::get("Application");
+  std::string checkpoint_path;
+};
+
+// Writes the profile of the monitors periodically, and once more when
+// cancelled
+class ProfileTask : public Task {
+public:
+  ProfileTask() : Task("AssuranceBrkrAppProfileTask") {}
+
+  void runTask() {
+    while (!sleep(PROFILE_INTERVAL_MS)) {
+      WriteProfile(_logger);
+    }
+    WriteProfile(_logger);
+  }
+
+private:
+  static const long PROFILE_INTERVAL_MS = 10000;
+  Logger &_logger = Logger::get("Application");
+};
+
+// Watches the monitor files and swaps in new monitors when they change
+class ReloadTask : public Task {
+public:
+  ReloadTask() : Task("AssuranceBrkrAppReloadTask") {}
+
+  void runTask() {
+    while (!sleep(RELOAD_INTERVAL_MS)) {
+      ReloadMonitors(_logger);
+    }
+  }
+
+private:
+  static const long RELOAD_INTERVAL_MS = 1000;
+  Logger &_logger = Logger::get("Application");
+};
+
+// Finds the deadlines of timed monitors that pass without an event, when
+// they pass or at least every second
+class DeadlineTask : public Task {
+public:
+  DeadlineTask() : Task("AssuranceBrkrAppDeadlineTask") {}
+
+  void runTask() {
+    long wait = MAX_WAIT_MS;
+    while (!sleep(wait)) {
+      wait = ExpireDeadlines(MAX_WAIT_MS);
+    }
+  }
+
+private:
+  static const long MAX_WAIT_MS = 1000;
 };
 
 class AssuranceBrkrApp : public ServerApplication {
 public:
-  AssuranceBrkrApp() : _helpRequested(false) {}
+  AssuranceBrkrApp()
+      : _helpRequested(false), _checkpointPath("assurancebrkr.ckpt"),
+        _fresh(false), _cqThreads(0) {}
 
   ~AssuranceBrkrApp() {}
 
@@ -113,6 +197,136 @@ protected:
             .repeatable(false)
             .callback(OptionCallback<AssuranceBrkrApp>(
                 this, &AssuranceBrkrApp::handleHelp)));
+
+    options.addOption(
+        Option("checkpoint", "c",
+               "file where monitor states are saved and resumed from "
+               "(default assurancebrkr.ckpt)")
+            .required(false)
+            .repeatable(false)
+            .argument("file")
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleCheckpoint)));
+
+    options.addOption(
+        Option("fresh", "f",
+               "start monitors from their initial states, ignoring the "
+               "checkpoint")
+            .required(false)
+            .repeatable(false)
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleFresh)));
+
+    options.addOption(
+        Option("profile", "p",
+               "count transitions, unknown actions and time per state, and "
+               "write them to the given .csv or .json file every 10 s")
+            .required(false)
+            .repeatable(false)
+            .argument("file")
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleProfile)));
+
+    options.addOption(
+        Option("audit", "a",
+               "record every check and the monitor steps it causes in the "
+               "given binary audit log, printing only violations; "
+               "ltlmon-audit-csv converts it to CSV")
+            .required(false)
+            .repeatable(false)
+            .argument("file")
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleAudit)));
+
+    options.addOption(
+        Option("monitor", "m",
+               "also check the monitor in the given .mon or .monb file, "
+               "reloading it when the file changes")
+            .required(false)
+            .repeatable(true)
+            .argument("file")
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleMonitor)));
+
+    options.addOption(
+        Option("timed", "t",
+               "also check the timed monitor in the given .mon file, "
+               "reloading it when the file changes; timestamps are in "
+               "milliseconds")
+            .required(false)
+            .repeatable(true)
+            .argument("file")
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleTimed)));
+
+    options.addOption(
+        Option("monitor-dir", "d",
+               "check all .mon and .monb files in the given directory instead "
+               "of the compiled monitor, picking up added, removed and "
+               "changed files; .mon files with clock constraints are timed")
+            .required(false)
+            .repeatable(true)
+            .argument("dir")
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleMonitorDir)));
+
+    options.addOption(
+        Option("predicates", "s",
+               "derive actions from the telemetry that guidance sends with "
+               "saveStatus, using the predicates in the given file")
+            .required(false)
+            .repeatable(false)
+            .argument("file")
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handlePredicates)));
+
+    options.addOption(
+        Option("cq-threads", "q",
+               "serve with the async server on the given number of "
+               "completion queue threads, each pinned to a core (default 0, "
+               "the sync server)")
+            .required(false)
+            .repeatable(false)
+            .argument("threads")
+            .validator(new IntValidator(0, 1024))
+            .callback(OptionCallback<AssuranceBrkrApp>(
+                this, &AssuranceBrkrApp::handleCqThreads)));
+  }
+
+  void handleCqThreads(const std::string &name, const std::string &value) {
+    _cqThreads = std::stoi(value);
+  }
+
+  void handleProfile(const std::string &name, const std::string &value) {
+    _profilePath = value;
+  }
+
+  void handleAudit(const std::string &name, const std::string &value) {
+    _auditPath = value;
+  }
+
+  void handleMonitor(const std::string &name, const std::string &value) {
+    _monitorPaths.push_back(value);
+  }
+
+  void handleTimed(const std::string &name, const std::string &value) {
+    _timedPaths.push_back(value);
+  }
+
+  void handleMonitorDir(const std::string &name, const std::string &value) {
+    _monitorDirs.push_back(value);
+  }
+
+  void handlePredicates(const std::string &name, const std::string &value) {
+    _predicatesPath = value;
+  }
+
+  void handleCheckpoint(const std::string &name, const std::string &value) {
+    _checkpointPath = value;
+  }
+
+  void handleFresh(const std::string &name, const std::string &value) {
+    _fresh = true;
   }
 
   void handleHelp(const std::string &name, const std::string &value) {
@@ -138,8 +352,26 @@ protected:
       std::string server_addr_port = ports.getAddress("ASSURANCEBRKR_PORT");
       std::cout << "server address: " << server_addr_port << std::endl;
 
+      if (!_profilePath.empty()) {
+        EnableProfiling(_profilePath);
+      }
+      if (!_auditPath.empty()) {
+        EnableAudit(logger(), _auditPath);
+      }
+      LoadMonitors(logger(), _checkpointPath, _fresh, _monitorPaths,
+                   _timedPaths, _monitorDirs);
+      if (!_predicatesPath.empty()) {
+        LoadPredicates(logger(), _predicatesPath);
+      }
+
       TaskManager tm;
-      tm.start(new ServerTask(server_addr_port));
+      tm.start(new ServerTask(server_addr_port, _cqThreads));
+      tm.start(new CheckpointTask(_checkpointPath));
+      tm.start(new ReloadTask());
+      tm.start(new DeadlineTask());
+      if (!_profilePath.empty()) {
+        tm.start(new ProfileTask());
+      }
       waitForTerminationRequest();
       tm.cancelAll();
       tm.joinAll();
@@ -149,6 +381,15 @@ protected:
 
 private:
   bool _helpRequested;
+  std::string _checkpointPath;
+  bool _fresh;
+  std::string _profilePath;
+  std::string _auditPath;
+  std::vector<std::string> _monitorPaths;
+  std::vector<std::string> _timedPaths;
+  std::vector<std::string> _monitorDirs;
+  std::string _predicatesPath;
+  unsigned _cqThreads;
 };
 
 // This is a substitute for the main program in C++
@@ -0,0 +1,145 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+// Load benchmark of the assurance broker: closed-loop clients, each with its
+// own connection, call checkState for a few seconds against the sync server
+// and the async server, and the median and 99th percentile latency and the
+// calls per second are printed for each number of clients. The server runs in
+// this process, on the compiled monitors.
+//
+// Usage: brkrbench [seconds per run (default 5)] [async threads (default 4)]
+
+#include "server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using grpc::Channel;
+using grpc::ChannelArguments;
+using grpc::ClientContext;
+
+static const char *SERVER_ADDRESS = "127.0.0.1:50990";
+static const unsigned CLIENTS[] = {1, 4, 16, 64};
+
+struct RunResult {
+  double qps;
+  double p50Us;
+  double p99Us;
+};
+
+static std::shared_ptr<Channel> NewChannel() {
+  // Without a local subchannel pool, all clients would share one connection
+  ChannelArguments args;
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  return grpc::CreateCustomChannel(
+      SERVER_ADDRESS, grpc::InsecureChannelCredentials(), args);
+}
+
+static double Percentile(const std::vector<double> &sorted, double q) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[std::min(sorted.size() - 1, size_t(q * sorted.size()))];
+}
+
+static RunResult RunClients(unsigned clients, int seconds) {
+  std::atomic<bool> done(false);
+  std::vector<std::vector<double>> latencies(clients);
+  std::vector<std::thread> threads;
+  for (unsigned c = 0; c < clients; ++c) {
+    threads.emplace_back([&, c] {
+      auto stub = Assurance::NewStub(NewChannel());
+      ::google::protobuf::StringValue request;
+      ::google::protobuf::BoolValue response;
+      request.set_value("at_destination");
+      while (!done) {
+        ClientContext context;
+        auto start = std::chrono::steady_clock::now();
+        Status status = stub->checkState(&context, request, &response);
+        auto end = std::chrono::steady_clock::now();
+        if (status.ok()) {
+          latencies[c].push_back(
+              std::chrono::duration<double, std::micro>(end - start).count());
+        }
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  done = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::vector<double> all;
+  for (const auto &client : latencies) {
+    all.insert(all.end(), client.begin(), client.end());
+  }
+  std::sort(all.begin(), all.end());
+  return RunResult{double(all.size()) / seconds, Percentile(all, 0.5),
+                   Percentile(all, 0.99)};
+}
+
+// Runs the clients against a server with the given number of completion queue
+// threads (0 for the sync server), and prints one line per number of clients
+static void RunBenchmark(std::ostream &out, Logger &logger,
+                         unsigned cq_threads, int seconds) {
+  std::thread server([&] { RunServer(logger, SERVER_ADDRESS, cq_threads); });
+  NewChannel()->WaitForConnected(std::chrono::system_clock::now() +
+                                 std::chrono::seconds(10));
+
+  std::string name =
+      cq_threads == 0 ? "sync" : "async/" + std::to_string(cq_threads);
+  double maxQps = 0;
+  for (unsigned clients : CLIENTS) {
+    RunResult result = RunClients(clients, seconds);
+    maxQps = std::max(maxQps, result.qps);
+    out << name << "\t" << clients << "\t" << int64_t(result.qps) << "\t"
+        << result.p50Us << "\t" << result.p99Us << std::endl;
+  }
+  out << name << "\tmax QPS " << int64_t(maxQps) << std::endl;
+
+  StopServer();
+  server.join();
+}
+
+int main(int argc, char **argv) {
+  int seconds = argc > 1 ? std::stoi(argv[1]) : 5;
+  unsigned cq_threads = argc > 2 ? std::stoi(argv[2]) : 4;
+
+  // The broker prints every verdict to stdout, which would be measured too
+  std::ostream out(std::cout.rdbuf());
+  std::cout.setstate(std::ios::badbit);
+
+  Logger &logger = Logger::get("Benchmark");
+  LoadMonitors(logger, "brkrbench.ckpt", true, {}, {});
+
+  out << "server\tclients\tQPS\tp50 us\tp99 us" << std::endl;
+  RunBenchmark(out, logger, 0, seconds);
+  RunBenchmark(out, logger, cq_threads, seconds);
+  return 0;
+}
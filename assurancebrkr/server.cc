@@ -25,31 +25,1601 @@
  */
 
 #include "server.h"
-#include "ltlmonrt.hpp"
+#include "instancetable.hpp"
+#include "ltlmonaudit.hpp"
+#include "ltlmonbank.hpp"
+#include "ltlmoncheckpoint.hpp"
+#include "ltlmonimage.hpp"
+#include "ltlmontimed.hpp"
+#include "prop1_monitor.hpp"
+#include "telemetry.h"
+#include "verdicthub.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-static LTLMonitor monitor;
-static std::string monFile = "../ltlmon-rt/tests/prop1.mon";
+#include <grpcpp/alarm.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+// State of a timed monitor for the events of one mission, or for those that
+// don't name a mission
+struct TimedState {
+  TimedLTLMonitor monitor;
+  // Time of the last step, which the next one can't be earlier than
+  TimedLTLMonitor::TimeT lastTime = 0;
+  // Whether subscribers were told that the property is satisfied
+  bool accepted = false;
+};
+
+struct TimedEntry {
+  std::string path;
+  // The monitor as loaded, copied for each new mission
+  TimedLTLMonitor initial;
+  std::mutex mutex;
+  TimedState shared;
+  std::map<std::string, TimedState, std::less<>> missions;
+};
+
+// States of the monitors of the bank for one mission, and whether
+// subscribers were told that each property is satisfied for it
+struct MissionEntry {
+  std::vector<InstanceTable::SlotT> slots;
+  std::vector<bool> accepted;
+};
+
+struct MissionStates {
+  // InstanceTable is not thread-safe, so missions are stepped with the states
+  // locked
+  std::mutex mutex;
+  // Set when a reload has copied the states into a new set. Checks that
+  // still hold this set then retry on the new one, so no event is lost.
+  bool retired = false;
+  // One table per monitor of the bank, keyed by the number of each mission
+  std::vector<std::unique_ptr<InstanceTable>> tables;
+  std::map<std::string, MissionEntry, std::less<>> missions;
+};
+
+struct MonitorSet {
+  // All properties are checked together. checkState runs on the threads of
+  // the sync server or on the completion queue threads of the async server,
+  // so the bank is stepped with stepConcurrent(). Its states are those of
+  // the events that don't name a mission.
+  LTLMonitorBank bank;
+
+  // Events of a mission step its own instances of the monitors of the bank
+  MissionStates missions;
+
+  // Properties with time bounds, stepped with the timestamp of each event or
+  // the time at which the broker receives it. Each mission has its own
+  // states of them, whose clocks start with its first event. Missed
+  // deadlines are found on the next event or by ExpireDeadlines().
+  std::vector<std::shared_ptr<TimedEntry>> timed;
+
+  // Per monitor of the bank, whether subscribers were told that its property
+  // is satisfied. Only kept up to date while there are subscribers.
+  std::unique_ptr<std::atomic<bool>[]> accepted;
+
+  // The monitors of the bank as images, for clients that step them locally
+  // (getMonitorTables). Timed monitors are only checked by the broker.
+  MonitorTables tables;
+};
+
+// Monitors that are checked on every event. The set is published through an
+// atomically swapped shared_ptr: checkState takes a reference for the whole
+// call, so a reload never blocks it, and the old set is freed when the last
+// call that uses it returns.
+static std::shared_ptr<MonitorSet> monitors = std::make_shared<MonitorSet>();
+
+// Sets replaced by a reload, with the shared states they had when they were
+// swapped out, until the calls that still use them have returned. Only used
+// by ReloadMonitors().
+struct RetiredSet {
+  std::shared_ptr<MonitorSet> set;
+  std::vector<MonitorSnapshot> states;
+};
+static std::vector<RetiredSet> retiredSets;
+
+// Subscribers of subscribeVerdicts
+static VerdictHub verdictHub;
+
+// How often the sync server checks that a subscriber is still there
+static const long SUBSCRIBER_POLL_MS = 1000;
+
+// Turn the telemetry received with saveStatus into actions
+static TelemetryPredicates predicates;
+
+// Files the monitors were loaded from, with their modification times and
+// inodes when they were last read. listed is set for files found in a monitor
+// directory.
+struct WatchedFile {
+  std::string path;
+  bool timed;
+  std::filesystem::file_time_type mtime;
+  bool listed;
+  ino_t inode;
+};
+
+static std::vector<WatchedFile> watchedFiles;
+
+// Directories whose .mon and .monb files are all loaded. The compiled monitor
+// is only checked if no directory is given.
+static std::vector<std::string> monitorDirs;
+static bool compiledMonitors = true;
+
+// Where the profile of the monitors is written; profiling is off if empty
+static std::string profilePath;
+
+// Last tables version and state digest reported by each client that steps
+// replicated tables, by mission
+static std::mutex replicasMutex;
+static std::map<std::string, ReplicaReport> replicas;
+
+// Where every check and the monitor steps it causes are recorded, if
+// EnableAudit() opened it
+static AuditLog auditLog;
+static bool auditing = false;
+
+static TimedLTLMonitor::TimeT NowMillis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::filesystem::file_time_type ModificationTime(
+    const std::string &path) {
+  std::error_code error;
+  auto mtime = std::filesystem::last_write_time(path, error);
+  return error ? std::filesystem::file_time_type::min() : mtime;
+}
+
+static ino_t Inode(const std::string &path) {
+  struct stat status;
+  return stat(path.c_str(), &status) == 0 ? status.st_ino : 0;
+}
+
+// A .mon file with clock constraints is loaded as a timed monitor
+static bool HasClocks(const std::string &path) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.rfind("TIMED:", 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Lists the monitor directories again and replaces the files found in them.
+// Files that are still there keep their modification time, so that they are
+// only reloaded if they changed. Returns true if the list changed.
+static bool ScanMonitorDirs(Logger &logger) {
+  std::vector<WatchedFile> files;
+  std::vector<WatchedFile> previous;
+  for (const auto &file : watchedFiles) {
+    (file.listed ? previous : files).push_back(file);
+  }
+
+  std::vector<WatchedFile> listed;
+  for (const auto &dir : monitorDirs) {
+    std::error_code error;
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+      auto extension = entry.path().extension();
+      if (entry.is_regular_file() &&
+          (extension == ".mon" || extension == ".monb")) {
+        paths.push_back(entry.path().string());
+      }
+    }
+    if (error) {
+      logger.error("Could not list monitor directory " + dir);
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto &path : paths) {
+      WatchedFile file{path, false, std::filesystem::file_time_type::min(),
+                       true, 0};
+      for (const auto &old : previous) {
+        if (old.path == path) {
+          file.mtime = old.mtime;
+          file.inode = old.inode;
+        }
+      }
+      file.timed = std::filesystem::path(path).extension() == ".mon" &&
+                   HasClocks(path);
+      listed.push_back(file);
+    }
+  }
+
+  bool changed = listed.size() != previous.size() ||
+                 !std::equal(listed.begin(), listed.end(), previous.begin(),
+                             [](const WatchedFile &a, const WatchedFile &b) {
+                               return a.path == b.path;
+                             });
+  files.insert(files.end(), listed.begin(), listed.end());
+  watchedFiles.swap(files);
+  return changed;
+}
+
+static bool SameStates(const std::vector<MonitorSnapshot> &a,
+                       const std::vector<MonitorSnapshot> &b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(),
+                    [](const MonitorSnapshot &x, const MonitorSnapshot &y) {
+                      return x.fingerprint == y.fingerprint &&
+                             x.state == y.state;
+                    });
+}
+
+static bool IsAccepting(const MonitorAutomaton &automaton,
+                        MonitorAutomaton::IndexT state) {
+  return automaton.getStateType(state) == State::ACCEPT;
+}
+
+// Serializes the monitors of the bank for getMonitorTables. The version is a
+// hash of the images, so it only changes when an automaton does, and is the
+// same after a restart.
+static bool BuildTables(MonitorSet &set) {
+  std::uint64_t version = FNV1A_BASIS;
+  std::vector<unsigned char> image;
+  for (size_t i = 0; i < set.bank.size(); ++i) {
+    const LTLMonitor &monitor = set.bank.getMonitor(i);
+    if (!monitor.writeImage(image)) {
+      set.tables.Clear();
+      return false;
+    }
+    version = fnv1a(version, image.data(), image.size());
+    MonitorTable *table = set.tables.add_tables();
+    table->set_property(monitor.getProperty());
+    table->set_image(image.data(), image.size());
+  }
+  set.tables.set_version(version);
+  return true;
+}
+
+// A timed monitor in its initial state, whose clocks start with the first
+// event it checks
+static TimedState MakeTimed(const TimedLTLMonitor &initial) {
+  TimedState state;
+  state.monitor = initial;
+  state.accepted =
+      IsAccepting(initial.getAutomaton(), initial.getCurrentState());
+  return state;
+}
+
+// Returns the state of a timed monitor for a mission, or the shared one for
+// events that don't name a mission. Called with the entry locked.
+static TimedState &GetTimed(TimedEntry &entry, std::string_view mission_id) {
+  if (mission_id.empty()) {
+    return entry.shared;
+  }
+  auto found = entry.missions.find(mission_id);
+  if (found != entry.missions.end()) {
+    return found->second;
+  }
+  return entry.missions
+      .emplace(std::string(mission_id), MakeTimed(entry.initial))
+      .first->second;
+}
+
+// Builds a new set from the watched files. Timed monitors whose file did not
+// change are shared with the previous set, so they keep their clocks.
+static std::shared_ptr<MonitorSet>
+BuildMonitors(Logger &logger, const MonitorSet *previous) {
+  auto set = std::make_shared<MonitorSet>();
+  if (!profilePath.empty()) {
+    set->bank.enableProfiling();
+  }
+
+  // Compiled in from ltlmon-rt/tests/prop1.mon, so it is ready at startup.
+  // It is stepped in the bank rather than as a StaticLTLMonitor, so that it
+  // is also checked per mission, checkpointed, audited and sent to replicas.
+  if (compiledMonitors) {
+    LTLMonitor prop1;
+    prop1.initialize<Prop1Monitor>();
+    set->bank.add(std::move(prop1));
+  }
+
+  for (auto &file : watchedFiles) {
+    // Recorded first, so that a file that fails to load is retried only
+    // after it changes again
+    auto mtime = ModificationTime(file.path);
+    bool unchanged = (mtime == file.mtime);
+    ino_t inode = Inode(file.path);
+    if (!unchanged && inode == file.inode) {
+      logger.warning("Monitor file " + file.path +
+                     " was written in place; replace it with a rename");
+    }
+    file.mtime = mtime;
+    file.inode = inode;
+    if (!file.timed) {
+      if (!set->bank.load(file.path)) {
+        logger.error("Could not load monitor " + file.path);
+        return nullptr;
+      }
+      continue;
+    }
+
+    std::shared_ptr<TimedEntry> entry;
+    if (previous != nullptr && unchanged) {
+      for (const auto &candidate : previous->timed) {
+        if (candidate->path == file.path) {
+          entry = candidate;
+        }
+      }
+    }
+    if (entry == nullptr) {
+      entry = std::make_shared<TimedEntry>();
+      entry->path = file.path;
+      if (!entry->initial.initialize(file.path, true)) {
+        logger.error("Could not load timed monitor " + file.path);
+        return nullptr;
+      }
+      entry->shared = MakeTimed(entry->initial);
+    }
+    set->timed.push_back(entry);
+  }
+  for (size_t i = 0; i < set->bank.size(); ++i) {
+    set->missions.tables.push_back(std::make_unique<InstanceTable>(
+        set->bank.getMonitor(i).shareAutomaton()));
+  }
+  set->accepted.reset(new std::atomic<bool>[set->bank.size()]);
+  if (!BuildTables(*set)) {
+    logger.error("Could not serialize the monitors for replicas");
+  }
+  return set;
+}
+
+// Notes which monitors of a set are satisfied already, so that subscribers
+// are not told again after a reload
+static void MarkAccepted(MonitorSet &set) {
+  for (size_t i = 0; i < set.bank.size(); ++i) {
+    set.accepted[i].store(IsAccepting(set.bank.getMonitor(i).getAutomaton(),
+                                      set.bank.getState(i)),
+                          std::memory_order_relaxed);
+  }
+}
+
+// Returns the states of a mission, which start in the initial states of the
+// monitors. Called with the states locked, or before the set is published.
+static MissionEntry &GetMission(MissionStates &states,
+                                std::string_view mission_id) {
+  auto found = states.missions.find(mission_id);
+  if (found != states.missions.end()) {
+    return found->second;
+  }
+  InstanceTable::KeyT key = states.missions.size();
+  MissionEntry &mission = states.missions[std::string(mission_id)];
+  for (auto &table : states.tables) {
+    mission.slots.push_back(table->acquire(key));
+    mission.accepted.push_back(IsAccepting(
+        table->getAutomaton(), table->get(mission.slots.back()).state));
+  }
+  return mission;
+}
+
+// Called with the states locked
+static InstanceSnapshots SnapshotMissions(const MissionStates &states) {
+  InstanceSnapshots snapshots;
+  for (const auto &mission : states.missions) {
+    auto &saved = snapshots[mission.first];
+    for (size_t i = 0; i < states.tables.size(); ++i) {
+      const InstanceTable &table = *states.tables[i];
+      saved.push_back(
+          MonitorSnapshot{table.getAutomaton().getFingerprint(),
+                          table.get(mission.second.slots[i]).state});
+    }
+  }
+  return snapshots;
+}
+
+// Restores the monitors of each mission from the first unused snapshot of the
+// same automaton, as LTLMonitorBank::restore() does. Called before the set is
+// published.
+static void RestoreMissions(MissionStates &states,
+                            const InstanceSnapshots &snapshots) {
+  for (const auto &saved : snapshots) {
+    MissionEntry &mission = GetMission(states, saved.first);
+    std::vector<bool> used(saved.second.size(), false);
+    for (size_t i = 0; i < states.tables.size(); ++i) {
+      const MonitorAutomaton &automaton = states.tables[i]->getAutomaton();
+      for (size_t s = 0; s < saved.second.size(); ++s) {
+        const MonitorSnapshot &snapshot = saved.second[s];
+        if (!used[s] && snapshot.fingerprint == automaton.getFingerprint() &&
+            snapshot.state >= 0 && snapshot.state < automaton.getStateCount()) {
+          used[s] = true;
+          states.tables[i]->get(mission.slots[i]).state = snapshot.state;
+          mission.accepted[i] = IsAccepting(automaton, snapshot.state);
+          break;
+        }
+      }
+    }
+  }
+}
+
+// Snapshots of the timed monitors of a set by mission, each taken with the
+// monitor locked. Those of the events without a mission are under "".
+static TimedSnapshots SnapshotTimed(const MonitorSet &set) {
+  TimedSnapshots snapshots;
+  for (const auto &entry : set.timed) {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    snapshots[""].push_back(entry->shared.monitor.snapshot());
+    for (const auto &mission : entry->missions) {
+      snapshots[mission.first].push_back(mission.second.monitor.snapshot());
+    }
+  }
+  return snapshots;
+}
+
+// Restores the states of the timed monitors of a set that is not published
+// yet, for each mission from the first unused snapshot of the same
+// automaton. Returns the number of shared states restored.
+static size_t RestoreTimed(MonitorSet &set, const TimedSnapshots &snapshots) {
+  size_t restored = 0;
+  for (const auto &saved : snapshots) {
+    std::vector<bool> used(saved.second.size(), false);
+    for (const auto &entry : set.timed) {
+      const auto fingerprint = entry->initial.getAutomaton().getFingerprint();
+      TimedState &state = GetTimed(*entry, saved.first);
+      for (size_t s = 0; s < saved.second.size(); ++s) {
+        const TimedSnapshot &snapshot = saved.second[s];
+        if (!used[s] && snapshot.monitor.fingerprint == fingerprint &&
+            state.monitor.restore(snapshot)) {
+          used[s] = true;
+          state.lastTime = snapshot.lastTime;
+          state.accepted = IsAccepting(state.monitor.getAutomaton(),
+                                       state.monitor.getCurrentState());
+          restored += saved.first.empty();
+          break;
+        }
+      }
+    }
+  }
+  return restored;
+}
+
+static bool SameTimed(const TimedSnapshots &a, const TimedSnapshots &b) {
+  auto same = [](const TimedSnapshot &x, const TimedSnapshot &y) {
+    return x.monitor.fingerprint == y.monitor.fingerprint &&
+           x.monitor.state == y.monitor.state && x.started == y.started &&
+           x.lastTime == y.lastTime && x.pending == y.pending;
+  };
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(),
+                    [&](const auto &x, const auto &y) {
+                      return x.first == y.first &&
+                             x.second.size() == y.second.size() &&
+                             std::equal(x.second.begin(), x.second.end(),
+                                        y.second.begin(), same);
+                    });
+}
+
+static bool SameMissions(const InstanceSnapshots &a,
+                         const InstanceSnapshots &b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(),
+                    [](const auto &x, const auto &y) {
+                      return x.first == y.first &&
+                             SameStates(x.second, y.second);
+                    });
+}
+
+// Writes the names of the actions and the properties of the monitors of a
+// new set to the audit log, so that the ids in the records that follow can be
+// resolved. Timed monitors come after those of the bank.
+static void AuditDictionary(const MonitorSet &set) {
+  if (!auditing) {
+    return;
+  }
+  AuditRecord record = {};
+  record.sequence = auditLog.nextSequence();
+  record.timestamp = NowMillis();
+  record.kind = AUDIT_ACTION;
+  record.monitor = -1;
+  for (size_t a = 0; a < set.bank.getActionCount(); ++a) {
+    record.action = a;
+    auditLog.append(record, set.bank.getActionName(a));
+  }
+  record.kind = AUDIT_MONITOR;
+  record.action = -1;
+  for (size_t i = 0; i < set.bank.size(); ++i) {
+    record.monitor = i;
+    auditLog.append(record, set.bank.getMonitor(i).getProperty());
+  }
+  for (size_t j = 0; j < set.timed.size(); ++j) {
+    record.monitor = set.bank.size() + j;
+    auditLog.append(record, set.timed[j]->initial.getProperty());
+  }
+}
+
+void LoadMonitors(Logger &logger, const std::string &checkpoint_path,
+                  bool fresh, const std::vector<std::string> &monitor_paths,
+                  const std::vector<std::string> &timed_paths,
+                  const std::vector<std::string> &monitor_dirs) {
+  for (const auto &path : monitor_paths) {
+    watchedFiles.push_back(WatchedFile{
+        path, false, std::filesystem::file_time_type::min(), false, 0});
+  }
+  for (const auto &path : timed_paths) {
+    watchedFiles.push_back(WatchedFile{
+        path, true, std::filesystem::file_time_type::min(), false, 0});
+  }
+  monitorDirs = monitor_dirs;
+  compiledMonitors = monitorDirs.empty();
+  ScanMonitorDirs(logger);
+  auto set = BuildMonitors(logger, nullptr);
+  if (set == nullptr) {
+    logger.error("Checking only the compiled monitors");
+    watchedFiles.clear();
+    monitorDirs.clear();
+    compiledMonitors = true;
+    set = BuildMonitors(logger, nullptr);
+  }
+
+  std::vector<MonitorSnapshot> snapshots;
+  InstanceSnapshots missions;
+  TimedSnapshots timed;
+  if (fresh || !std::ifstream(checkpoint_path).good()) {
+    logger.information("Starting monitors from their initial states");
+  } else if (readCheckpoint(checkpoint_path, snapshots, missions, timed)) {
+    size_t restored = set->bank.restore(snapshots);
+    RestoreMissions(set->missions, missions);
+    size_t restoredTimed = RestoreTimed(*set, timed);
+    logger.information("Resumed " + std::to_string(restored) + " of " +
+                       std::to_string(set->bank.size()) + " monitors, " +
+                       std::to_string(restoredTimed) + " of " +
+                       std::to_string(set->timed.size()) +
+                       " timed monitors and " +
+                       std::to_string(missions.size()) + " missions from " +
+                       checkpoint_path);
+  } else {
+    logger.warning("Ignoring unreadable checkpoint " + checkpoint_path);
+  }
+  MarkAccepted(*set);
+  AuditDictionary(*set);
+  std::atomic_store(&monitors, set);
+}
+
+// Compares the states of the retired sets that are no longer used with those
+// they had when they were swapped out, and frees them
+static void DropRetiredSets(Logger &logger) {
+  auto unused = std::remove_if(
+      retiredSets.begin(), retiredSets.end(), [&](const RetiredSet &retired) {
+        // No reference is taken once the set is swapped out
+        if (retired.set.use_count() > 1) {
+          return false;
+        }
+        if (!SameStates(retired.states, retired.set->bank.snapshot())) {
+          logger.warning("Events checked during the reload only stepped the "
+                         "old monitors");
+        }
+        return true;
+      });
+  retiredSets.erase(unused, retiredSets.end());
+}
+
+bool ReloadMonitors(Logger &logger) {
+  DropRetiredSets(logger);
+  bool changed = ScanMonitorDirs(logger);
+  for (const auto &file : watchedFiles) {
+    changed = changed || ModificationTime(file.path) != file.mtime;
+  }
+  if (!changed) {
+    return false;
+  }
+
+  // Parse and build off the hot path; on failure the current set is kept
+  auto old = std::atomic_load(&monitors);
+  auto set = BuildMonitors(logger, old.get());
+  if (set == nullptr) {
+    logger.error("Keeping the current monitors");
+    return false;
+  }
+
+  // Carry over the states of unchanged automata into the new set while it is
+  // still private, then publish it. The missions of the old set stay locked
+  // until then, and checks that wait for them retry on the new set.
+  AuditDictionary(*set);
+  std::unique_lock<std::mutex> missionsLock(old->missions.mutex);
+  RestoreMissions(set->missions, SnapshotMissions(old->missions));
+  std::vector<MonitorSnapshot> before = old->bank.snapshot();
+  size_t restored = set->bank.restore(before);
+  MarkAccepted(*set);
+  std::atomic_store(&monitors, set);
+  old->missions.retired = true;
+  missionsLock.unlock();
+
+  // Calls that started before the swap may still step the shared states of
+  // the old set. It is kept until they have returned, without waiting for
+  // them, to tell whether any event was lost.
+  retiredSets.push_back({std::move(old), std::move(before)});
+
+  logger.information("Reloaded " + std::to_string(set->bank.size()) +
+                     " monitors, " + std::to_string(restored) +
+                     " kept their state");
+  for (size_t i = 0; i < set->bank.size(); ++i) {
+    logger.information("Monitoring property: " +
+                       set->bank.getMonitor(i).getProperty());
+  }
+  return true;
+}
+
+bool LoadPredicates(Logger &logger, const std::string &predicates_path) {
+  std::string message;
+  if (!predicates.load(predicates_path, message)) {
+    logger.error(message);
+    return false;
+  }
+  logger.information("Loaded " + std::to_string(predicates.size()) +
+                     " telemetry predicates from " + predicates_path);
+  return true;
+}
+
+void EnableProfiling(const std::string &profile_path) {
+  profilePath = profile_path;
+}
+
+bool EnableAudit(Logger &logger, const std::string &audit_path) {
+  auditing = auditLog.open(audit_path);
+  if (!auditing) {
+    logger.error("Could not open audit log " + audit_path);
+  }
+  return auditing;
+}
+
+void WriteProfile(Logger &logger) {
+  if (!profilePath.empty() &&
+      !std::atomic_load(&monitors)->bank.writeProfile(profilePath)) {
+    logger.error("Could not write profile " + profilePath);
+  }
+}
+
+void CheckpointMonitors(Logger &logger, const std::string &checkpoint_path) {
+  static std::vector<MonitorSnapshot> lastCheckpoint;
+  static InstanceSnapshots lastMissions;
+  static TimedSnapshots lastTimed;
+  auto set = std::atomic_load(&monitors);
+  std::vector<MonitorSnapshot> snapshots = set->bank.snapshot();
+  InstanceSnapshots missions;
+  {
+    std::lock_guard<std::mutex> lock(set->missions.mutex);
+    missions = SnapshotMissions(set->missions);
+  }
+  TimedSnapshots timed = SnapshotTimed(*set);
+  if (SameStates(snapshots, lastCheckpoint) &&
+      SameMissions(missions, lastMissions) && SameTimed(timed, lastTimed)) {
+    return;
+  }
+  if (writeCheckpoint(checkpoint_path, snapshots, missions, timed)) {
+    lastCheckpoint = snapshots;
+    lastMissions = missions;
+    lastTimed = timed;
+  } else {
+    logger.error("Could not write checkpoint " + checkpoint_path);
+  }
+}
+
+static void LogProperties(Logger &logger) {
+  auto set = std::atomic_load(&monitors);
+  for (size_t i = 0; i < set->bank.size(); ++i) {
+    logger.information("Monitoring property: " +
+                       set->bank.getMonitor(i).getProperty());
+  }
+  for (const auto &entry : set->timed) {
+    logger.information("Monitoring timed property: " +
+                       entry->initial.getProperty());
+  }
+}
 
 AssuranceBrokerServiceImplementation::AssuranceBrokerServiceImplementation(
     Logger *log) {
   log_ptr = log;
-  if (!monitor.initialize(monFile)) {
-    std::cout << "Could not load monitor from " << monFile << std::endl;
-  };
+  LogProperties(*log_ptr);
+}
+
+// Time at which a timed monitor checks an event: its timestamp, or the time
+// the broker received it if it has none. An event older than the previous one
+// is checked at the time of the previous one. Called with the entry locked.
+static TimedLTLMonitor::TimeT EventTime(TimedState &state,
+                                        TimedLTLMonitor::TimeT timestamp) {
+  state.lastTime =
+      std::max(state.lastTime, timestamp > 0 ? timestamp : NowMillis());
+  return state.lastTime;
+}
+
+using Transitions = std::vector<LTLMonitorBank::Transition>;
+
+// Adds the step of timed monitor j to the transitions of an event, if it
+// knows the action or the event moved or violated it. Called with the entry
+// locked, after the step.
+static void AddTimedStep(Transitions &steps, const MonitorSet &set, size_t j,
+                         const TimedLTLMonitor &monitor, uint32_t event,
+                         std::string_view action, LTLMonitor::IndexT from,
+                         bool ok) {
+  LTLMonitor::IndexT to = monitor.getCurrentState();
+  if (ok && to == from &&
+      monitor.internAction(action) == LTLMonitor::UNKNOWN_ACTION) {
+    return;
+  }
+  steps.push_back(LTLMonitorBank::Transition{
+      event, static_cast<uint32_t>(set.bank.size() + j), from, to, !ok});
+}
+
+// Appends the records of one checked event to the audit log: the name of its
+// action if the bank doesn't know it, the steps of the monitors, then the
+// verdict. Records are copied into the mapped file and written to disk by
+// its flusher, so nothing is formatted or synced here.
+static void AuditCheck(const MonitorSet &set, TimedLTLMonitor::TimeT timestamp,
+                       std::string_view action, const std::string &mission_id,
+                       bool result, const LTLMonitorBank::Transition *steps,
+                       size_t count) {
+  AuditRecord record = {};
+  record.sequence = auditLog.nextSequence();
+  record.timestamp = timestamp;
+  record.monitor = -1;
+  record.from = -1;
+  record.to = -1;
+  LTLMonitorBank::ActionId id = set.bank.internAction(action);
+  if (id == LTLMonitor::UNKNOWN_ACTION) {
+    record.action = -1;
+    record.kind = AUDIT_UNKNOWN;
+    auditLog.append(record, action);
+  } else {
+    record.action = id;
+  }
+
+  record.kind = AUDIT_STEP;
+  for (size_t k = 0; k < count; ++k) {
+    record.monitor = steps[k].monitor;
+    record.from = steps[k].from;
+    record.to = steps[k].to;
+    record.verdict = !steps[k].violated;
+    auditLog.append(record, mission_id);
+  }
+  record.kind = AUDIT_CHECK;
+  record.monitor = -1;
+  record.from = -1;
+  record.to = -1;
+  record.verdict = result;
+  auditLog.append(record, mission_id);
+}
+
+// Prints the verdict of an action, and the properties it violates according
+// to the bits of violated from first on. With the audit log, where every
+// verdict is recorded, only violations are printed.
+static void PrintVerdict(const MonitorSet &set, const std::string &action,
+                         bool result, const LTLMonitorBank::MaskT &violated,
+                         size_t first) {
+  if (!auditing) {
+    std::cout << "Result of step[" << action << "] -> " << result
+              << std::endl;
+  }
+  for (size_t i = 0; !result && i < set.bank.size(); ++i) {
+    if (LTLMonitorBank::isViolated(violated, first + i)) {
+      std::cout << "Action " << action << " violates property "
+                << set.bank.getMonitor(i).getProperty() << std::endl;
+    }
+  }
+}
+
+static void PublishVerdict(PropertyVerdict::Kind kind,
+                           const std::string &property,
+                           const std::string &action,
+                           const std::string &mission_id,
+                           TimedLTLMonitor::TimeT timestamp) {
+  PropertyVerdict verdict;
+  verdict.set_kind(kind);
+  verdict.set_property(property);
+  verdict.set_action(action);
+  verdict.set_missionid(mission_id);
+  verdict.set_timestamp(timestamp);
+  verdictHub.publish(verdict);
+}
+
+// Tells the subscribers about the monitors of the bank that the action
+// violates (bits of violated from first on) and, with check_accepted, those
+// that are newly satisfied. Monitors that became satisfied while nobody was
+// subscribed are reported with the next action that is published.
+static void PublishBankVerdicts(MonitorSet &set, const std::string &action,
+                                const std::string &mission_id,
+                                TimedLTLMonitor::TimeT timestamp,
+                                const LTLMonitorBank::MaskT &violated,
+                                size_t first, bool check_accepted) {
+  for (size_t i = 0; i < set.bank.size(); ++i) {
+    const LTLMonitor &monitor = set.bank.getMonitor(i);
+    if (LTLMonitorBank::isViolated(violated, first + i)) {
+      PublishVerdict(PropertyVerdict::VIOLATION, monitor.getProperty(), action,
+                     mission_id, timestamp);
+    } else if (check_accepted &&
+               IsAccepting(monitor.getAutomaton(), set.bank.getState(i)) &&
+               !set.accepted[i].exchange(true, std::memory_order_relaxed)) {
+      PublishVerdict(PropertyVerdict::ACCEPTANCE, monitor.getProperty(),
+                     action, mission_id, timestamp);
+    }
+  }
+}
+
+// Same for a timed monitor that was just stepped. Called with the entry
+// locked.
+static void PublishTimedVerdict(TimedState &state, bool result,
+                                const std::string &action,
+                                const std::string &mission_id) {
+  if (!result) {
+    PublishVerdict(PropertyVerdict::VIOLATION, state.monitor.getProperty(),
+                   action, mission_id, state.lastTime);
+  } else if (!state.accepted && IsAccepting(state.monitor.getAutomaton(),
+                                            state.monitor.getCurrentState())) {
+    state.accepted = true;
+    PublishVerdict(PropertyVerdict::ACCEPTANCE, state.monitor.getProperty(),
+                   action, mission_id, state.lastTime);
+  }
+}
+
+// Steps all monitors with the action and returns false if any of them is
+// violated. Called concurrently by the handlers of all RPCs.
+static bool CheckAction(const std::string &action) {
+  // Keeps the set alive until the call returns, even if it is reloaded
+  std::shared_ptr<MonitorSet> set = std::atomic_load(&monitors);
+  bool publish = verdictHub.hasSubscribers();
+  // Reused by the calls of each thread, so that auditing doesn't allocate
+  static thread_local Transitions steps;
+  steps.clear();
+  LTLMonitorBank::MaskT violated;
+  set->bank.stepConcurrent(action, violated, auditing ? &steps : nullptr);
+  bool result = !LTLMonitorBank::anyViolated(violated);
+  for (size_t j = 0; j < set->timed.size(); ++j) {
+    TimedEntry &entry = *set->timed[j];
+    // The time is read under the lock so that steps are in time order
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    TimedState &state = entry.shared;
+    LTLMonitor::IndexT from = state.monitor.getCurrentState();
+    bool ok = state.monitor.step(action, EventTime(state, 0));
+    if (publish) {
+      PublishTimedVerdict(state, ok, action, "");
+    }
+    if (auditing) {
+      AddTimedStep(steps, *set, j, state.monitor, 0, action, from, ok);
+    }
+    result = ok && result;
+  }
+  if (publish || auditing) {
+    TimedLTLMonitor::TimeT now = NowMillis();
+    if (publish) {
+      PublishBankVerdicts(*set, action, "", now, violated, 0, true);
+    }
+    if (auditing) {
+      AuditCheck(*set, now, action, "", result, steps.data(), steps.size());
+    }
+  }
+  PrintVerdict(*set, action, result, violated, 0);
+  return result;
+}
+
+// Steps the monitors of the bank that belong to a mission with its events of
+// a batch, given by their indices. Each monitor goes through the events in
+// one pass. Violations are set in violated at the position of each event, as
+// stepBatchConcurrent() does, and are published along with the properties the
+// mission newly satisfies. Called with the states locked.
+static void CheckMission(MonitorSet &set, const Events &request,
+                         std::string_view mission_id,
+                         const std::vector<int> &indices,
+                         LTLMonitorBank::MaskT &violated, Transitions *steps,
+                         bool publish) {
+  MissionEntry &mission = GetMission(set.missions, mission_id);
+  const size_t words = set.bank.maskWords();
+  // Event at which each monitor became satisfied, or -1
+  std::vector<int> acceptedAt(set.bank.size(), -1);
+  for (size_t i = 0; i < set.bank.size(); ++i) {
+    InstanceTable &table = *set.missions.tables[i];
+    const MonitorAutomaton &automaton = table.getAutomaton();
+    const InstanceTable::SlotT slot = mission.slots[i];
+    for (int e : indices) {
+      auto action = automaton.internAction(request.events(e).action());
+      LTLMonitor::IndexT from = table.get(slot).state;
+      bool ok = table.step(slot, action);
+      LTLMonitor::IndexT to = table.get(slot).state;
+      if (!ok) {
+        violated[e * words + i / 64] |= uint64_t(1) << (i % 64);
+      } else if (!mission.accepted[i] && IsAccepting(automaton, to)) {
+        mission.accepted[i] = true;
+        acceptedAt[i] = e;
+      }
+      if (steps != nullptr && (!ok || action != LTLMonitor::UNKNOWN_ACTION)) {
+        steps->push_back(LTLMonitorBank::Transition{
+            static_cast<uint32_t>(e), static_cast<uint32_t>(i), from, to,
+            !ok});
+      }
+    }
+  }
+
+  for (int e = 0; publish && e < int(indices.size()); ++e) {
+    const Event &event = request.events(indices[e]);
+    TimedLTLMonitor::TimeT time =
+        event.timestamp() > 0 ? event.timestamp() : NowMillis();
+    for (size_t i = 0; i < set.bank.size(); ++i) {
+      const std::string &property = set.bank.getMonitor(i).getProperty();
+      if (LTLMonitorBank::isViolated(violated,
+                                     (indices[e] * words) * 64 + i)) {
+        PublishVerdict(PropertyVerdict::VIOLATION, property, event.action(),
+                       event.missionid(), time);
+      } else if (acceptedAt[i] == indices[e]) {
+        PublishVerdict(PropertyVerdict::ACCEPTANCE, property, event.action(),
+                       event.missionid(), time);
+      }
+    }
+  }
+}
+
+// Steps the state of timed monitor j for a mission, or the shared one, with
+// its events of a batch, given by their indices, and clears the results of
+// those that fail. Called with the entry locked.
+static void CheckTimed(const MonitorSet &set, size_t j, TimedState &state,
+                       const Events &request, const std::vector<int> &indices,
+                       std::vector<bool> &results, Transitions *steps,
+                       bool publish) {
+  for (int e : indices) {
+    const Event &event = request.events(e);
+    auto time = EventTime(state, event.timestamp());
+    LTLMonitor::IndexT from = state.monitor.getCurrentState();
+    bool ok = state.monitor.step(event.action(), time);
+    if (publish) {
+      PublishTimedVerdict(state, ok, event.action(), event.missionid());
+    }
+    if (steps != nullptr) {
+      AddTimedStep(*steps, set, j, state.monitor, e, event.action(), from,
+                   ok);
+    }
+    results[e] = ok && results[e];
+  }
+}
+
+// Advances a timed monitor state to now if one of its deadlines passed, and
+// lowers next to its next deadline. Called with the entry locked.
+static void ExpireTimed(TimedState &state, const std::string &mission_id,
+                        bool publish, TimedLTLMonitor::TimeT &next) {
+  if (state.monitor.nextDeadline() < NowMillis()) {
+    bool ok = state.monitor.advance(EventTime(state, 0));
+    if (!ok) {
+      std::cout << "Missed deadline violates property "
+                << state.monitor.getProperty();
+      if (!mission_id.empty()) {
+        std::cout << " of mission " << mission_id;
+      }
+      std::cout << std::endl;
+    }
+    if (publish) {
+      PublishTimedVerdict(state, ok, "", mission_id);
+    }
+  }
+  next = std::min(next, state.monitor.nextDeadline());
+}
+
+long ExpireDeadlines(long max_wait_ms) {
+  std::shared_ptr<MonitorSet> set = std::atomic_load(&monitors);
+  bool publish = verdictHub.hasSubscribers();
+  TimedLTLMonitor::TimeT next = TimedLTLMonitor::NO_DEADLINE;
+  for (const auto &timed : set->timed) {
+    std::lock_guard<std::mutex> lock(timed->mutex);
+    ExpireTimed(timed->shared, "", publish, next);
+    for (auto &mission : timed->missions) {
+      ExpireTimed(mission.second, mission.first, publish, next);
+    }
+  }
+  if (next == TimedLTLMonitor::NO_DEADLINE) {
+    return max_wait_ms;
+  }
+  // A deadline is missed once the time is past it
+  return std::clamp<TimedLTLMonitor::TimeT>(next + 1 - NowMillis(), 1,
+                                            max_wait_ms);
+}
+
+// Steps all monitors with a batch of events and returns one verdict per
+// event. Events that name a mission step its own states of the monitors,
+// grouped by mission, and the others the shared states. Either way, each
+// monitor goes through the events in one pass, and each timed monitor is
+// locked once for the batch.
+static void CheckEvents(const Events &request, Verdicts &response) {
+  const auto &events = request.events();
+  std::vector<std::string_view> actions;
+  std::vector<int> shared;
+  std::map<std::string_view, std::vector<int>> missions;
+  for (int e = 0; e < events.size(); ++e) {
+    if (events[e].missionid().empty()) {
+      shared.push_back(e);
+      actions.push_back(events[e].action());
+    } else {
+      missions[events[e].missionid()].push_back(e);
+    }
+  }
+
+  bool publish = verdictHub.hasSubscribers();
+  static thread_local Transitions steps;
+  steps.clear();
+  std::shared_ptr<MonitorSet> set = std::atomic_load(&monitors);
+  LTLMonitorBank::MaskT violated;
+  if (!missions.empty()) {
+    std::unique_lock<std::mutex> lock(set->missions.mutex);
+    while (set->missions.retired) {
+      lock.unlock();
+      set = std::atomic_load(&monitors);
+      lock = std::unique_lock<std::mutex>(set->missions.mutex);
+    }
+    violated.assign(events.size() * set->bank.maskWords(), 0);
+    for (const auto &mission : missions) {
+      CheckMission(*set, request, mission.first, mission.second, violated,
+                   auditing ? &steps : nullptr, publish);
+    }
+  }
+  const size_t words = set->bank.maskWords();
+  violated.resize(events.size() * words, 0);
+  if (!shared.empty()) {
+    // The bank numbers the events it is given from 0
+    LTLMonitorBank::MaskT sharedViolated;
+    size_t first = steps.size();
+    set->bank.stepBatchConcurrent(actions, sharedViolated,
+                                  auditing ? &steps : nullptr);
+    for (size_t k = 0; k < shared.size(); ++k) {
+      std::copy_n(sharedViolated.begin() + k * words, words,
+                  violated.begin() + shared[k] * words);
+    }
+    for (size_t k = first; k < steps.size(); ++k) {
+      steps[k].event = shared[steps[k].event];
+    }
+  }
+
+  std::vector<bool> results(events.size());
+  for (int e = 0; e < events.size(); ++e) {
+    auto mask = violated.begin() + e * words;
+    results[e] = std::none_of(mask, mask + words,
+                              [](uint64_t bits) { return bits != 0; });
+  }
+  for (size_t j = 0; j < set->timed.size(); ++j) {
+    TimedEntry &entry = *set->timed[j];
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    CheckTimed(*set, j, entry.shared, request, shared, results,
+               auditing ? &steps : nullptr, publish);
+    for (const auto &mission : missions) {
+      CheckTimed(*set, j, GetTimed(entry, mission.first), request,
+                 mission.second, results, auditing ? &steps : nullptr,
+                 publish);
+    }
+  }
+
+  for (int e = 0; e < events.size(); ++e) {
+    response.add_verdicts()->set_value(results[e]);
+    PrintVerdict(*set, events[e].action(), results[e], violated,
+                 e * words * 64);
+  }
+  if (auditing) {
+    // The bank gives the steps monitor by monitor; the log has them by event
+    std::stable_sort(steps.begin(), steps.end(),
+                     [](const LTLMonitorBank::Transition &a,
+                        const LTLMonitorBank::Transition &b) {
+                       return a.event < b.event;
+                     });
+    TimedLTLMonitor::TimeT now = NowMillis();
+    size_t k = 0;
+    for (int e = 0; e < events.size(); ++e) {
+      size_t first = k;
+      while (k < steps.size() && steps[k].event == uint32_t(e)) {
+        ++k;
+      }
+      const Event &event = events[e];
+      AuditCheck(*set, event.timestamp() > 0 ? event.timestamp() : now,
+                 event.action(), event.missionid(), results[e],
+                 steps.data() + first, k - first);
+    }
+  }
+  // The bank only has its shared states after the whole batch, so monitors
+  // it satisfies are reported with the last event that has no mission
+  for (size_t k = 0; publish && k < shared.size(); ++k) {
+    const Event &event = events[shared[k]];
+    TimedLTLMonitor::TimeT time =
+        event.timestamp() > 0 ? event.timestamp() : NowMillis();
+    PublishBankVerdicts(*set, event.action(), "", time, violated,
+                        shared[k] * words * 64, k + 1 == shared.size());
+  }
+}
+
+// Checks the actions of the predicates that a telemetry sample changed, as
+// one batch of events of its mission at the time of the sample
+static void CheckTelemetry(const std::vector<std::string> &actions,
+                           TimedLTLMonitor::TimeT timestamp,
+                           const std::string &mission_id) {
+  Events events;
+  for (const auto &action : actions) {
+    Event *event = events.add_events();
+    event->set_action(action);
+    event->set_timestamp(timestamp);
+    event->set_missionid(mission_id);
+  }
+  Verdicts verdicts;
+  CheckEvents(events, verdicts);
+}
+
+static void GetMonitorTables(const ::google::protobuf::Empty &request,
+                             MonitorTables &response) {
+  response = std::atomic_load(&monitors)->tables;
+}
+
+// Passes on the verdicts of a client that steps the tables locally, as if
+// the broker had found them, and keeps its state digest. The client fetches
+// the tables again if the version returned is not the one it steps.
+static void ReportReplica(const ReplicaReport &request,
+                          ReplicaStatus &response) {
+  std::shared_ptr<MonitorSet> set = std::atomic_load(&monitors);
+  if (request.dropped() > 0) {
+    std::cout << "Replica of mission " << request.missionid() << " dropped "
+              << request.dropped() << " verdicts" << std::endl;
+  }
+  for (const auto &reported : request.verdicts()) {
+    if (reported.kind() == PropertyVerdict::VIOLATION) {
+      std::cout << "Action " << reported.action() << " violates property "
+                << reported.property() << " on the replica of mission "
+                << request.missionid() << std::endl;
+    }
+    PropertyVerdict verdict = reported;
+    verdict.set_missionid(request.missionid());
+    verdict.set_replica(true);
+    verdictHub.publish(verdict);
+  }
+
+  std::lock_guard<std::mutex> lock(replicasMutex);
+  ReplicaReport &digest = replicas[request.missionid()];
+  if (digest.version() != request.version()) {
+    std::cout << "Replica of mission " << request.missionid()
+              << " steps tables version " << request.version() << std::endl;
+  }
+  digest = request;
+  digest.clear_verdicts();
+  digest.clear_dropped();
+  response.set_version(set->tables.version());
+}
+
+// Serves saveStatus with the loaded predicates, or nothing if there are none
+static std::unique_ptr<grpc::Service> MakeTelemetryService() {
+  if (predicates.size() == 0) {
+    return nullptr;
+  }
+  return NewTelemetryService(predicates, CheckTelemetry);
 }
 
 Status AssuranceBrokerServiceImplementation::checkState(
     ServerContext *context, const ::google::protobuf::StringValue *request,
     ::google::protobuf::BoolValue *response) {
-  bool result = true;
-  result = monitor.step(request->value());
-  std::cout << "Result of step[" << request->value() << "] -> " << result
-            << std::endl;
-  response->set_value(result);
+  response->set_value(CheckAction(request->value()));
+  return Status::OK;
+}
+
+Status AssuranceBrokerServiceImplementation::checkStates(ServerContext *context,
+                                                         const Events *request,
+                                                         Verdicts *response) {
+  CheckEvents(*request, *response);
+  return Status::OK;
+}
+
+Status AssuranceBrokerServiceImplementation::getMonitorTables(
+    ServerContext *context, const ::google::protobuf::Empty *request,
+    MonitorTables *response) {
+  GetMonitorTables(*request, *response);
+  return Status::OK;
+}
+
+Status AssuranceBrokerServiceImplementation::reportReplica(
+    ServerContext *context, const ReplicaReport *request,
+    ReplicaStatus *response) {
+  ReportReplica(*request, *response);
+  return Status::OK;
+}
+
+Status AssuranceBrokerServiceImplementation::checkStateStream(
+    ServerContext *context,
+    ServerReaderWriter<::google::protobuf::BoolValue,
+                       ::google::protobuf::StringValue> *stream) {
+  log_ptr->information("Assurance stream opened by " + context->peer());
+  ::google::protobuf::StringValue request;
+  ::google::protobuf::BoolValue response;
+  while (stream->Read(&request)) {
+    response.set_value(CheckAction(request.value()));
+    if (!stream->Write(response)) {
+      break;
+    }
+  }
+  log_ptr->information("Assurance stream closed by " + context->peer());
   return Status::OK;
 }
 
-void RunServer(Logger &logger, std::string server_address) {
+// Sends the verdicts to the subscriber until it cancels the call or the
+// server stops
+Status AssuranceBrokerServiceImplementation::subscribeVerdicts(
+    ServerContext *context, const Subscription *request,
+    ServerWriter<PropertyVerdict> *writer) {
+  log_ptr->information("Verdict subscription opened by " + context->peer());
+  auto queue =
+      verdictHub.subscribe(request->missionid(), request->untagged());
+  PropertyVerdict verdict;
+  while (!context->IsCancelled() && !queue->isClosed()) {
+    if (queue->pop(verdict, std::chrono::milliseconds(SUBSCRIBER_POLL_MS)) &&
+        !writer->Write(verdict)) {
+      break;
+    }
+  }
+  verdictHub.unsubscribe(queue);
+  log_ptr->information("Verdict subscription closed by " + context->peer());
+  return Status::OK;
+}
+
+// A call on the async server. The call is the tag of its pending operation,
+// and Proceed() is called on its completion queue thread when it completes.
+class AsyncCall {
+public:
+  virtual ~AsyncCall() {}
+  virtual void Proceed(bool ok) = 0;
+};
+
+// Set on a completion queue thread once it has shut its queue down. Calls
+// that complete after that are dropped instead of starting new operations.
+static thread_local bool draining = false;
+
+// A unary call, answered on the completion queue thread that received it
+template <typename Request, typename Response>
+class AsyncUnaryCall final : public AsyncCall {
+public:
+  using RequestMethod = void (Assurance::AsyncService::*)(
+      ServerContext *, Request *, ServerAsyncResponseWriter<Response> *,
+      grpc::CompletionQueue *, ServerCompletionQueue *, void *);
+  using Handler = void (*)(const Request &, Response &);
+
+  AsyncUnaryCall(Assurance::AsyncService *service, ServerCompletionQueue *cq,
+                 RequestMethod method, Handler handler)
+      : service_(service), cq_(cq), method_(method), handler_(handler),
+        responder_(&context_), finished_(false) {
+    (service_->*method_)(&context_, &request_, &responder_, cq_, cq_, this);
+  }
+
+  void Proceed(bool ok) override {
+    if (!ok || finished_ || draining) {
+      delete this;
+      return;
+    }
+    // Waits for the next call before handling this one
+    new AsyncUnaryCall(service_, cq_, method_, handler_);
+    handler_(request_, response_);
+    finished_ = true;
+    responder_.Finish(response_, Status::OK, this);
+  }
+
+private:
+  Assurance::AsyncService *service_;
+  ServerCompletionQueue *cq_;
+  RequestMethod method_;
+  Handler handler_;
+  ServerContext context_;
+  Request request_;
+  Response response_;
+  ServerAsyncResponseWriter<Response> responder_;
+  bool finished_;
+};
+
+static void HandleCheckState(const ::google::protobuf::StringValue &request,
+                             ::google::protobuf::BoolValue &response) {
+  response.set_value(CheckAction(request.value()));
+}
+
+// Reads an action, writes its verdict, and repeats until the client is done.
+// Only one operation is pending at a time, so verdicts keep the order of the
+// actions.
+class AsyncCheckStateStream final : public AsyncCall {
+public:
+  AsyncCheckStateStream(Assurance::AsyncService *service,
+                        ServerCompletionQueue *cq, Logger *log)
+      : service_(service), cq_(cq), log_ptr(log), stream_(&context_),
+        step_(Step::CONNECT) {
+    service_->RequestcheckStateStream(&context_, &stream_, cq_, cq_, this);
+  }
+
+  void Proceed(bool ok) override {
+    if (draining) {
+      delete this;
+      return;
+    }
+    switch (step_) {
+    case Step::CONNECT:
+      if (!ok) {
+        delete this;
+        return;
+      }
+      new AsyncCheckStateStream(service_, cq_, log_ptr);
+      log_ptr->information("Assurance stream opened by " + context_.peer());
+      read();
+      break;
+    case Step::READ:
+      if (!ok) {
+        finish();
+        return;
+      }
+      response_.set_value(CheckAction(request_.value()));
+      step_ = Step::WRITE;
+      stream_.Write(response_, this);
+      break;
+    case Step::WRITE:
+      if (ok) {
+        read();
+      } else {
+        finish();
+      }
+      break;
+    case Step::FINISH:
+      delete this;
+      break;
+    }
+  }
+
+private:
+  enum class Step { CONNECT, READ, WRITE, FINISH };
+
+  void read() {
+    step_ = Step::READ;
+    stream_.Read(&request_, this);
+  }
+
+  void finish() {
+    log_ptr->information("Assurance stream closed by " + context_.peer());
+    step_ = Step::FINISH;
+    stream_.Finish(Status::OK, this);
+  }
+
+  Assurance::AsyncService *service_;
+  ServerCompletionQueue *cq_;
+  Logger *log_ptr;
+  ServerContext context_;
+  ::google::protobuf::StringValue request_;
+  ::google::protobuf::BoolValue response_;
+  ServerAsyncReaderWriter<::google::protobuf::BoolValue,
+                          ::google::protobuf::StringValue>
+      stream_;
+  Step step_;
+};
+
+// Sends the verdicts of one subscriber as they are published. While its queue
+// is empty the call has no operation pending; the next verdict sets an alarm
+// that wakes it on its completion queue thread. A subscriber that went away
+// is noticed when the next verdict can't be written.
+class AsyncSubscribeVerdicts final : public AsyncCall {
+public:
+  AsyncSubscribeVerdicts(Assurance::AsyncService *service,
+                         ServerCompletionQueue *cq, Logger *log)
+      : service_(service), cq_(cq), log_ptr(log), writer_(&context_),
+        step_(Step::CONNECT) {
+    service_->RequestsubscribeVerdicts(&context_, &request_, &writer_, cq_,
+                                       cq_, this);
+  }
+
+  ~AsyncSubscribeVerdicts() {
+    if (queue_ != nullptr) {
+      verdictHub.unsubscribe(queue_);
+    }
+  }
+
+  void Proceed(bool ok) override {
+    if (draining) {
+      delete this;
+      return;
+    }
+    switch (step_) {
+    case Step::CONNECT:
+      if (!ok) {
+        delete this;
+        return;
+      }
+      new AsyncSubscribeVerdicts(service_, cq_, log_ptr);
+      log_ptr->information("Verdict subscription opened by " +
+                           context_.peer());
+      queue_ =
+          verdictHub.subscribe(request_.missionid(), request_.untagged());
+      next();
+      break;
+    case Step::WAIT:
+      next();
+      break;
+    case Step::WRITE:
+      if (ok) {
+        next();
+      } else {
+        finish();
+      }
+      break;
+    case Step::FINISH:
+      delete this;
+      break;
+    }
+  }
+
+private:
+  enum class Step { CONNECT, WAIT, WRITE, FINISH };
+
+  void next() {
+    auto wait = [this] { step_ = Step::WAIT; };
+    auto wake = [this] {
+      alarm_.Set(cq_, std::chrono::system_clock::now(), this);
+    };
+    switch (queue_->tryPop(verdict_, wait, wake)) {
+    case VerdictQueue::Pop::VERDICT:
+      step_ = Step::WRITE;
+      writer_.Write(verdict_, this);
+      break;
+    case VerdictQueue::Pop::WAITING:
+      break;
+    case VerdictQueue::Pop::CLOSED:
+      finish();
+      break;
+    }
+  }
+
+  void finish() {
+    verdictHub.unsubscribe(queue_);
+    queue_ = nullptr;
+    log_ptr->information("Verdict subscription closed by " + context_.peer());
+    step_ = Step::FINISH;
+    writer_.Finish(Status::OK, this);
+  }
+
+  Assurance::AsyncService *service_;
+  ServerCompletionQueue *cq_;
+  Logger *log_ptr;
+  ServerContext context_;
+  Subscription request_;
+  PropertyVerdict verdict_;
+  ServerAsyncWriter<PropertyVerdict> writer_;
+  std::shared_ptr<VerdictQueue> queue_;
+  grpc::Alarm alarm_;
+  Step step_;
+};
+
+// Shuts the queue down from its own thread, so that no call on that thread
+// starts an operation after the shutdown
+class ShutdownQueue final : public AsyncCall {
+public:
+  ShutdownQueue(ServerCompletionQueue *cq) : cq_(cq) {
+    alarm_.Set(cq_, std::chrono::system_clock::now(), this);
+  }
+
+  void Proceed(bool ok) override {
+    draining = true;
+    cq_->Shutdown();
+    delete this;
+  }
+
+private:
+  ServerCompletionQueue *cq_;
+  grpc::Alarm alarm_;
+};
+
+// Runs the calls of one completion queue until it is shut down and drained
+static void ServeCompletionQueue(ServerCompletionQueue *cq) {
+  void *tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) {
+    static_cast<AsyncCall *>(tag)->Proceed(ok);
+  }
+}
+
+// Keeps the thread on one core, so that it keeps the monitors in that core's
+// cache. Only done on Linux.
+static void PinToCore(std::thread &thread, unsigned index) {
+#ifdef __linux__
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(index % cores, &cpus);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+}
+
+// The running server, and whether StopServer() was called before it started
+static std::mutex serverMutex;
+static Server *runningServer = nullptr;
+static bool stopRequested = false;
+
+// Calls still running when the server is stopped are cancelled after this
+static const long SHUTDOWN_GRACE_MS = 1000;
+
+void StopServer() {
+  std::lock_guard<std::mutex> lock(serverMutex);
+  stopRequested = true;
+  // Lets the subscriptions finish before the calls are cancelled
+  verdictHub.close();
+  if (runningServer != nullptr) {
+    runningServer->Shutdown(std::chrono::system_clock::now() +
+                            std::chrono::milliseconds(SHUTDOWN_GRACE_MS));
+  }
+}
+
+static void PublishServer(Server *server) {
+  std::lock_guard<std::mutex> lock(serverMutex);
+  runningServer = server;
+  if (stopRequested) {
+    server->Shutdown(std::chrono::system_clock::now());
+  }
+}
+
+static void UnpublishServer() {
+  std::lock_guard<std::mutex> lock(serverMutex);
+  runningServer = nullptr;
+  stopRequested = false;
+  verdictHub.reopen();
+}
+
+// Serves all RPCs on cq_threads threads, each with its own completion queue.
+// Monitors are stepped on the thread that received the call.
+static void RunAsyncServer(Logger &logger, const std::string &server_address,
+                           unsigned cq_threads) {
+  Assurance::AsyncService service;
+
+  ServerBuilder builder;
+
+  logger.information("RunServer() starting on port: " + server_address +
+                     " with " + std::to_string(cq_threads) +
+                     " completion queue threads");
+  LogProperties(logger);
+  builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+  builder.RegisterService(&service);
+  std::unique_ptr<grpc::Service> telemetry = MakeTelemetryService();
+  if (telemetry != nullptr) {
+    builder.RegisterService(telemetry.get());
+  }
+  std::vector<std::unique_ptr<ServerCompletionQueue>> queues;
+  for (unsigned i = 0; i < cq_threads; ++i) {
+    queues.push_back(builder.AddCompletionQueue());
+  }
+  std::unique_ptr<Server> server(builder.BuildAndStart());
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < cq_threads; ++i) {
+    ServerCompletionQueue *cq = queues[i].get();
+    new AsyncUnaryCall<::google::protobuf::StringValue,
+                       ::google::protobuf::BoolValue>(
+        &service, cq, &Assurance::AsyncService::RequestcheckState,
+        HandleCheckState);
+    new AsyncUnaryCall<Events, Verdicts>(
+        &service, cq, &Assurance::AsyncService::RequestcheckStates,
+        CheckEvents);
+    new AsyncUnaryCall<::google::protobuf::Empty, MonitorTables>(
+        &service, cq, &Assurance::AsyncService::RequestgetMonitorTables,
+        GetMonitorTables);
+    new AsyncUnaryCall<ReplicaReport, ReplicaStatus>(
+        &service, cq, &Assurance::AsyncService::RequestreportReplica,
+        ReportReplica);
+    new AsyncCheckStateStream(&service, cq, &logger);
+    new AsyncSubscribeVerdicts(&service, cq, &logger);
+    threads.emplace_back(ServeCompletionQueue, cq);
+    PinToCore(threads.back(), i);
+  }
+
+  PublishServer(server.get());
+  server->Wait();
+  for (auto &cq : queues) {
+    new ShutdownQueue(cq.get());
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  UnpublishServer();
+}
+
+void RunServer(Logger &logger, std::string server_address,
+               unsigned cq_threads) {
+  if (cq_threads > 0) {
+    RunAsyncServer(logger, server_address, cq_threads);
+    return;
+  }
   AssuranceBrokerServiceImplementation service(&logger);
 
   ServerBuilder builder;
@@ -60,8 +1630,14 @@ void RunServer(Logger &logger, std::string server_address) {
   // Register "service" as the instance through which
   // communication with client takes place
   builder.RegisterService(&service);
+  std::unique_ptr<grpc::Service> telemetry = MakeTelemetryService();
+  if (telemetry != nullptr) {
+    builder.RegisterService(telemetry.get());
+  }
 
   // Assembling the server
   std::unique_ptr<Server> server(builder.BuildAndStart());
+  PublishServer(server.get());
   server->Wait();
+  UnpublishServer();
 }
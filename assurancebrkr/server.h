@@ -27,14 +27,21 @@
 #include <grpcpp/grpcpp.h>
 
 #include <string>
+#include <vector>
 
 #include "Poco/Logger.h"
 
 #include "IAssurance.grpc.pb.h"
 
 using grpc::Server;
+using grpc::ServerAsyncReaderWriter;
+using grpc::ServerAsyncResponseWriter;
+using grpc::ServerAsyncWriter;
 using grpc::ServerBuilder;
+using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
+using grpc::ServerReaderWriter;
+using grpc::ServerWriter;
 using grpc::Status;
 using Poco::Logger;
 
@@ -51,6 +58,75 @@ private:
   virtual Status checkState(ServerContext *context,
                             const ::google::protobuf::StringValue *request,
                             ::google::protobuf::BoolValue *response);
+  virtual Status checkStateStream(
+      ServerContext *context,
+      ServerReaderWriter<::google::protobuf::BoolValue,
+                         ::google::protobuf::StringValue> *stream);
+  virtual Status checkStates(ServerContext *context, const Events *request,
+                             Verdicts *response);
+  virtual Status subscribeVerdicts(ServerContext *context,
+                                   const Subscription *request,
+                                   ServerWriter<PropertyVerdict> *writer);
+  virtual Status getMonitorTables(ServerContext *context,
+                                  const ::google::protobuf::Empty *request,
+                                  MonitorTables *response);
+  virtual Status reportReplica(ServerContext *context,
+                               const ReplicaReport *request,
+                               ReplicaStatus *response);
 };
 
-void RunServer(Logger &logger, std::string server_address);
+// Serves the assurance RPCs, and saveStatus if telemetry predicates are
+// loaded, until StopServer() is called. With cq_threads > 0 the async server
+// is used: each of its threads has its own completion queue, is pinned to a
+// core, and steps the monitors of the calls it receives.
+// Otherwise the sync server is used, with the default gRPC thread pool.
+void RunServer(Logger &logger, std::string server_address,
+               unsigned cq_threads = 0);
+
+// Shuts down the server started by RunServer(), cancelling the calls that
+// don't finish within a second. If no server is running yet, the next one
+// stops as soon as it starts.
+void StopServer();
+
+// Reads the telemetry predicates (see telemetry.h) whose actions are checked
+// on each StatusMessage that guidance sends with saveStatus. Without them, the
+// broker doesn't serve saveStatus. Must be called before RunServer().
+bool LoadPredicates(Logger &logger, const std::string &predicates_path);
+
+// Loads the compiled monitors and those in monitor_paths (.mon or .monb) and,
+// unless fresh is set, resumes their states from the checkpoint file if there
+// is one. Timed monitors are loaded from the .mon files in timed_paths, and
+// their clocks start with their first event. If monitor_dirs is not empty,
+// all monitors in those directories are loaded instead of the compiled ones;
+// .mon files with clock constraints become timed monitors. Must be called
+// before RunServer().
+void LoadMonitors(Logger &logger, const std::string &checkpoint_path,
+                  bool fresh, const std::vector<std::string> &monitor_paths,
+                  const std::vector<std::string> &timed_paths,
+                  const std::vector<std::string> &monitor_dirs = {});
+
+// Rebuilds the monitors if one of their files changed or files were added to
+// or removed from the monitor directories, and swaps them in
+// without blocking checkState. Monitors whose automaton did not change keep
+// their state. Returns true if the monitors were replaced.
+bool ReloadMonitors(Logger &logger);
+
+// Checks the timed monitors whose deadlines passed without an event, so that a
+// mission that goes silent still misses them, and returns how many
+// milliseconds to wait until the next deadline, at most max_wait_ms
+long ExpireDeadlines(long max_wait_ms);
+
+// Counts transitions, unknown actions and time per state of the monitors, to
+// be written to profile_path (CSV, or JSON if it ends in .json) by
+// WriteProfile(). Must be called before LoadMonitors().
+void EnableProfiling(const std::string &profile_path);
+void WriteProfile(Logger &logger);
+
+// Records every check, with the monitors it stepped, in the binary audit log
+// at audit_path (see ltlmon-rt/ltlmonaudit.hpp). The verdicts are then no
+// longer printed, only the violations. Must be called before LoadMonitors().
+bool EnableAudit(Logger &logger, const std::string &audit_path);
+
+// Saves the monitor states to the checkpoint file if they changed since the
+// last call
+void CheckpointMonitors(Logger &logger, const std::string &checkpoint_path);
@@ -0,0 +1,324 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "telemetry.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include "Status.grpc.pb.h"
+
+using namespace uav;
+
+static const char *const FIELD_NAMES[TelemetryPredicates::FIELD_COUNT] = {
+    "altitude",
+    "battery_level",
+    "position.latitude",
+    "position.longitude",
+    "state",
+    "time",
+    "time_to_last_waypoint",
+    "next_waypoint.latitude",
+    "next_waypoint.longitude",
+    "next_waypoint.altitude"};
+
+// Longer operators first, so that "<=" is not read as "<"
+static const struct {
+  const char *text;
+  TelemetryPredicates::Op op;
+} OPERATORS[] = {{"<=", TelemetryPredicates::LE},
+                 {">=", TelemetryPredicates::GE},
+                 {"==", TelemetryPredicates::EQ},
+                 {"!=", TelemetryPredicates::NE},
+                 {"<", TelemetryPredicates::LT},
+                 {">", TelemetryPredicates::GT}};
+
+static double ReadField(const StatusMessage &status,
+                        TelemetryPredicates::Field field) {
+  switch (field) {
+  case TelemetryPredicates::ALTITUDE:
+    return status.altitude();
+  case TelemetryPredicates::BATTERY_LEVEL:
+    return status.battery_level();
+  case TelemetryPredicates::LATITUDE:
+    return status.position().latitude();
+  case TelemetryPredicates::LONGITUDE:
+    return status.position().longitude();
+  case TelemetryPredicates::STATE:
+    return status.state();
+  case TelemetryPredicates::TIME:
+    return status.time().epoch();
+  case TelemetryPredicates::TIME_TO_LAST_WAYPOINT:
+    return status.time_to_last_waypoint().epoch();
+  case TelemetryPredicates::NEXT_LATITUDE:
+    return status.next_waypoint().latlon().latitude();
+  case TelemetryPredicates::NEXT_LONGITUDE:
+    return status.next_waypoint().latlon().longitude();
+  case TelemetryPredicates::NEXT_ALTITUDE:
+    return status.next_waypoint().altitude();
+  default:
+    return 0;
+  }
+}
+
+static std::string Trim(const std::string &text) {
+  size_t first = text.find_first_not_of(" \t\r");
+  if (first == std::string::npos) {
+    return "";
+  }
+  size_t last = text.find_last_not_of(" \t\r");
+  return text.substr(first, last - first + 1);
+}
+
+static bool IsActionName(const std::string &name) {
+  return !name.empty() &&
+         std::all_of(name.begin(), name.end(), [](unsigned char c) {
+           return std::isalnum(c) || c == '_';
+         });
+}
+
+// A number, or the name of a State
+static bool ParseConstant(const std::string &text, double &constant) {
+  char *end = nullptr;
+  constant = std::strtod(text.c_str(), &end);
+  if (!text.empty() && *end == '\0') {
+    return true;
+  }
+  State state;
+  if (State_Parse(text, &state)) {
+    constant = state;
+    return true;
+  }
+  return false;
+}
+
+bool TelemetryPredicates::load(const std::string &path, std::string &message) {
+  std::ifstream file(path);
+  if (!file) {
+    message = "Could not open " + path;
+    return false;
+  }
+  std::vector<Predicate> predicates;
+  std::string line;
+  for (int number = 1; std::getline(file, line); ++number) {
+    line = Trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    std::string where = path + ":" + std::to_string(number) + ": ";
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      message = where + "expected <action>[, <action>]: <predicate>";
+      return false;
+    }
+
+    Predicate predicate;
+    std::string names = line.substr(0, colon);
+    size_t comma = names.find(',');
+    predicate.rising = Trim(names.substr(0, comma));
+    if (comma != std::string::npos) {
+      predicate.falling = Trim(names.substr(comma + 1));
+    }
+    if (!IsActionName(predicate.rising) ||
+        (comma != std::string::npos && !IsActionName(predicate.falling))) {
+      message = where + "bad action name";
+      return false;
+    }
+
+    std::string condition = line.substr(colon + 1);
+    size_t at = std::string::npos;
+    size_t length = 0;
+    for (const auto &op : OPERATORS) {
+      at = condition.find(op.text);
+      if (at != std::string::npos) {
+        predicate.op = op.op;
+        length = std::string(op.text).size();
+        break;
+      }
+    }
+    if (at == std::string::npos) {
+      message = where + "expected one of < <= > >= == !=";
+      return false;
+    }
+    std::string field = Trim(condition.substr(0, at));
+    auto name = std::find(FIELD_NAMES, FIELD_NAMES + FIELD_COUNT, field);
+    if (name == FIELD_NAMES + FIELD_COUNT) {
+      message = where + "unknown field " + field;
+      return false;
+    }
+    predicate.field = static_cast<Field>(name - FIELD_NAMES);
+    if (!ParseConstant(Trim(condition.substr(at + length)),
+                       predicate.constant)) {
+      message = where + "expected a number or a state";
+      return false;
+    }
+    predicates.push_back(std::move(predicate));
+  }
+  compile(std::move(predicates));
+  return true;
+}
+
+void TelemetryPredicates::compile(std::vector<Predicate> predicates) {
+  std::vector<std::uint32_t> order(predicates.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::uint32_t a, std::uint32_t b) {
+                     return predicates[a].op < predicates[b].op;
+                   });
+
+  fields_.clear();
+  constants_.clear();
+  rising_.clear();
+  falling_.clear();
+  start_.assign(OP_COUNT + 1, 0);
+  for (std::uint32_t i : order) {
+    fields_.push_back(predicates[i].field);
+    constants_.push_back(predicates[i].constant);
+    rising_.push_back(std::move(predicates[i].rising));
+    falling_.push_back(std::move(predicates[i].falling));
+    ++start_[predicates[i].op + 1];
+  }
+  for (int op = 0; op < OP_COUNT; ++op) {
+    start_[op + 1] += start_[op];
+  }
+  order_ = std::move(order);
+
+  used_.clear();
+  for (int field = 0; field < FIELD_COUNT; ++field) {
+    if (std::find(fields_.begin(), fields_.end(), field) != fields_.end()) {
+      used_.push_back(field);
+    }
+  }
+  operands_.assign(fields_.size(), 0);
+  values_.assign(fields_.size(), 0);
+  previous_.assign(fields_.size(), 0);
+}
+
+size_t TelemetryPredicates::size() const { return fields_.size(); }
+
+void TelemetryPredicates::evaluate(const StatusMessage &status,
+                                   std::vector<std::string> &actions) {
+  double sample[FIELD_COUNT] = {};
+  for (std::uint8_t field : used_) {
+    sample[field] = ReadField(status, static_cast<Field>(field));
+  }
+  const size_t count = fields_.size();
+  for (size_t i = 0; i < count; ++i) {
+    operands_[i] = sample[fields_[i]];
+  }
+
+  // One loop per operator, over contiguous arrays, which the compiler can
+  // vectorize
+  const double *x = operands_.data();
+  const double *c = constants_.data();
+  std::uint8_t *v = values_.data();
+  for (size_t i = start_[LT]; i < start_[LT + 1]; ++i) {
+    v[i] = x[i] < c[i];
+  }
+  for (size_t i = start_[LE]; i < start_[LE + 1]; ++i) {
+    v[i] = x[i] <= c[i];
+  }
+  for (size_t i = start_[GT]; i < start_[GT + 1]; ++i) {
+    v[i] = x[i] > c[i];
+  }
+  for (size_t i = start_[GE]; i < start_[GE + 1]; ++i) {
+    v[i] = x[i] >= c[i];
+  }
+  for (size_t i = start_[EQ]; i < start_[EQ + 1]; ++i) {
+    v[i] = x[i] == c[i];
+  }
+  for (size_t i = start_[NE]; i < start_[NE + 1]; ++i) {
+    v[i] = x[i] != c[i];
+  }
+
+  // Edges, reported in the order of the file
+  changed_.clear();
+  for (size_t i = 0; i < count; ++i) {
+    if (values_[i] != previous_[i]) {
+      changed_.push_back(i);
+    }
+  }
+  std::sort(changed_.begin(), changed_.end(),
+            [this](std::uint32_t a, std::uint32_t b) {
+              return order_[a] < order_[b];
+            });
+  for (std::uint32_t i : changed_) {
+    const std::string &action = values_[i] ? rising_[i] : falling_[i];
+    if (!action.empty()) {
+      actions.push_back(action);
+    }
+  }
+  previous_.swap(values_);
+}
+
+class TelemetryService final : public MissionManagerStatus::Service {
+public:
+  TelemetryService(const TelemetryPredicates &predicates,
+                   TelemetryChecker check)
+      : predicates_(predicates), check_(std::move(check)) {}
+
+private:
+  grpc::Status saveStatus(grpc::ServerContext *context,
+                          const StatusMessage *request,
+                          ::google::protobuf::Empty *response) override {
+    std::string mission_id;
+    auto metadata = context->client_metadata().find(TELEMETRY_MISSION_KEY);
+    if (metadata != context->client_metadata().end()) {
+      mission_id.assign(metadata->second.data(), metadata->second.size());
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sender = senders_.find(mission_id);
+    if (sender == senders_.end()) {
+      sender = senders_.emplace(mission_id, predicates_).first;
+    }
+    actions_.clear();
+    sender->second.evaluate(*request, actions_);
+    if (!actions_.empty()) {
+      // Guidance sends the time in seconds
+      check_(actions_, request->time().epoch() * 1000, mission_id);
+    }
+    return grpc::Status::OK;
+  }
+
+  std::mutex mutex_;
+  // As loaded, copied for each new mission
+  const TelemetryPredicates predicates_;
+  std::map<std::string, TelemetryPredicates> senders_;
+  TelemetryChecker check_;
+  std::vector<std::string> actions_;
+};
+
+std::unique_ptr<grpc::Service>
+NewTelemetryService(const TelemetryPredicates &predicates,
+                    TelemetryChecker check) {
+  return std::unique_ptr<grpc::Service>(
+      new TelemetryService(predicates, std::move(check)));
+}
@@ -0,0 +1,141 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef TELEMETRY_H_H
+#define TELEMETRY_H_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <grpcpp/impl/service_type.h>
+
+// Declared only, since the State of Status.proto would clash with that of
+// ltlmon-rt in the broker
+namespace uav {
+class StatusMessage;
+}
+
+// Predicates over the telemetry of StatusMessage, which turn its samples into
+// monitor actions. Each line of a predicates file declares one:
+//
+//   high_altitude, low_altitude: altitude > 120
+//   low_battery: battery_level < 0.2
+//   flying: state == FLYING
+//
+// The first action is checked when the predicate becomes true, and the
+// optional second one when it becomes false again. The fields are those of
+// StatusMessage, with position.latitude, position.longitude, next_waypoint.*,
+// and the times in seconds; a state can be compared with its name.
+//
+// The predicates are compiled into a flat program: they are grouped by
+// operator, with their fields and constants in arrays. A sample is evaluated
+// by reading each field once, then comparing all predicates of a group in
+// one loop, and comparing the results with those of the previous sample.
+class TelemetryPredicates {
+public:
+  // Replaces the predicates with those in path. On failure, message tells
+  // which line is wrong and the predicates are left unchanged.
+  bool load(const std::string &path, std::string &message);
+
+  size_t size() const;
+
+  // Evaluates all predicates on a sample and appends the actions of those
+  // that changed since the previous sample, in the order of the file. The
+  // first sample changes all predicates that are true. Not thread-safe, since
+  // each sample depends on the previous one.
+  void evaluate(const uav::StatusMessage &status,
+                std::vector<std::string> &actions);
+
+  enum Field : std::uint8_t {
+    ALTITUDE,
+    BATTERY_LEVEL,
+    LATITUDE,
+    LONGITUDE,
+    STATE,
+    TIME,
+    TIME_TO_LAST_WAYPOINT,
+    NEXT_LATITUDE,
+    NEXT_LONGITUDE,
+    NEXT_ALTITUDE,
+    FIELD_COUNT
+  };
+
+  enum Op : std::uint8_t { LT, LE, GT, GE, EQ, NE, OP_COUNT };
+
+private:
+  struct Predicate {
+    Field field;
+    Op op;
+    double constant;
+    std::string rising;
+    std::string falling;
+  };
+
+  void compile(std::vector<Predicate> predicates);
+
+  // The program, sorted by operator: predicates [start[op], start[op + 1])
+  // compare with op. order gives their positions in the file.
+  std::vector<std::uint8_t> fields_;
+  std::vector<double> constants_;
+  std::vector<std::uint32_t> start_;
+  std::vector<std::uint32_t> order_;
+  std::vector<std::string> rising_;
+  std::vector<std::string> falling_;
+  // Fields read by at least one predicate
+  std::vector<std::uint8_t> used_;
+
+  // Scratch space of evaluate(), and the results of the previous sample
+  std::vector<double> operands_;
+  std::vector<std::uint8_t> values_;
+  std::vector<std::uint8_t> previous_;
+  std::vector<std::uint32_t> changed_;
+};
+
+// Checks the actions of one telemetry sample of a mission, at timestamp
+// milliseconds since the epoch
+using TelemetryChecker = std::function<void(
+    const std::vector<std::string> &actions, std::int64_t timestamp,
+    const std::string &mission_id)>;
+
+// Metadata of saveStatus that names the mission of the vehicle sending it
+static const char TELEMETRY_MISSION_KEY[] = "mission-id";
+
+// Serves saveStatus, which guidance calls with the same telemetry it sends to
+// the mission manager. Each mission, named by the TELEMETRY_MISSION_KEY
+// metadata of the call, has its own copy of predicates, so the samples of
+// different vehicles are never compared with each other. Samples without a
+// mission id share one copy, which is only meant for a single vehicle. The
+// actions of the predicates a sample changed are passed to check with its
+// mission id, one sample at a time, so that they are checked in the order
+// the samples arrive.
+std::unique_ptr<grpc::Service>
+NewTelemetryService(const TelemetryPredicates &predicates,
+                    TelemetryChecker check);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "verdicthub.h"
+#include <algorithm>
+
+VerdictQueue::VerdictQueue(const std::string &mission_id, bool untagged,
+                           size_t capacity)
+    : mission_id_(mission_id), untagged_(untagged),
+      capacity_(std::max<size_t>(1, capacity)), dropped_(0), closed_(false) {}
+
+bool VerdictQueue::wants(const std::string &mission_id) const {
+  if (untagged_) {
+    return mission_id.empty();
+  }
+  return mission_id_.empty() || mission_id == mission_id_;
+}
+
+void VerdictQueue::push(const PropertyVerdict &verdict) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    if (verdicts_.size() == capacity_) {
+      verdicts_.pop_front();
+      ++dropped_;
+    }
+    verdicts_.push_back(verdict);
+    wakeLocked();
+  }
+  ready_.notify_one();
+}
+
+bool VerdictQueue::pop(PropertyVerdict &verdict,
+                       std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ready_.wait_for(lock, timeout,
+                  [this] { return closed_ || !verdicts_.empty(); });
+  if (closed_ || verdicts_.empty()) {
+    return false;
+  }
+  takeLocked(verdict);
+  return true;
+}
+
+VerdictQueue::Pop VerdictQueue::tryPop(PropertyVerdict &verdict,
+                                       const std::function<void()> &wait,
+                                       std::function<void()> wake) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) {
+    return Pop::CLOSED;
+  }
+  if (!verdicts_.empty()) {
+    takeLocked(verdict);
+    return Pop::VERDICT;
+  }
+  wait();
+  wake_ = std::move(wake);
+  return Pop::WAITING;
+}
+
+void VerdictQueue::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    verdicts_.clear();
+    wakeLocked();
+  }
+  ready_.notify_all();
+}
+
+bool VerdictQueue::isClosed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return closed_;
+}
+
+void VerdictQueue::takeLocked(PropertyVerdict &verdict) {
+  verdict = std::move(verdicts_.front());
+  verdicts_.pop_front();
+  verdict.set_dropped(dropped_);
+  dropped_ = 0;
+}
+
+void VerdictQueue::wakeLocked() {
+  if (wake_) {
+    std::function<void()> wake;
+    wake.swap(wake_);
+    wake();
+  }
+}
+
+VerdictHub::VerdictHub() : count_(0), closed_(false) {}
+
+std::shared_ptr<VerdictQueue>
+VerdictHub::subscribe(const std::string &mission_id, bool untagged) {
+  auto queue =
+      std::make_shared<VerdictQueue>(mission_id, untagged, QUEUE_CAPACITY);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) {
+    queue->close();
+    return queue;
+  }
+  queues_.push_back(queue);
+  count_.store(queues_.size(), std::memory_order_release);
+  return queue;
+}
+
+void VerdictHub::unsubscribe(const std::shared_ptr<VerdictQueue> &queue) {
+  queue->close();
+  std::lock_guard<std::mutex> lock(mutex_);
+  queues_.erase(std::remove(queues_.begin(), queues_.end(), queue),
+                queues_.end());
+  count_.store(queues_.size(), std::memory_order_release);
+}
+
+bool VerdictHub::hasSubscribers() const {
+  return count_.load(std::memory_order_acquire) > 0;
+}
+
+void VerdictHub::publish(const PropertyVerdict &verdict) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &queue : queues_) {
+    if (queue->wants(verdict.missionid())) {
+      queue->push(verdict);
+    }
+  }
+}
+
+void VerdictHub::close() {
+  std::vector<std::shared_ptr<VerdictQueue>> queues;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    queues.swap(queues_);
+    count_.store(0, std::memory_order_release);
+  }
+  for (const auto &queue : queues) {
+    queue->close();
+  }
+}
+
+void VerdictHub::reopen() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = false;
+}
@@ -0,0 +1,116 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef VERDICTHUB_H_H
+#define VERDICTHUB_H_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "IAssurance.pb.h"
+
+using namespace uav;
+
+// Verdicts waiting to be sent to one subscriber. The queue is bounded: when it
+// is full, the oldest verdict is dropped and counted in the next one sent, so
+// a subscriber that does not keep up never blocks the checks.
+class VerdictQueue {
+public:
+  VerdictQueue(const std::string &mission_id, bool untagged, size_t capacity);
+
+  // Whether the subscriber asked for the verdicts of this mission. Verdicts
+  // without a mission id only go to subscribers of all missions, and to
+  // those that asked for them only (untagged).
+  bool wants(const std::string &mission_id) const;
+
+  void push(const PropertyVerdict &verdict);
+
+  // Takes the oldest verdict. Returns false if there is none after waiting
+  // up to timeout, or if the queue is closed.
+  bool pop(PropertyVerdict &verdict, std::chrono::milliseconds timeout);
+
+  // Takes the oldest verdict without waiting. If there is none and the queue
+  // is open, calls wait and keeps wake, which the next push() or close()
+  // calls once. Both are called with the queue locked, so wake never runs
+  // before wait has returned, nor after close() has.
+  enum class Pop { VERDICT, WAITING, CLOSED };
+  Pop tryPop(PropertyVerdict &verdict, const std::function<void()> &wait,
+             std::function<void()> wake);
+
+  void close();
+  bool isClosed() const;
+
+private:
+  void takeLocked(PropertyVerdict &verdict);
+  void wakeLocked();
+
+  const std::string mission_id_;
+  const bool untagged_;
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<PropertyVerdict> verdicts_;
+  std::uint64_t dropped_;
+  bool closed_;
+  std::function<void()> wake_;
+};
+
+// Hands the verdicts of the broker to the subscribers of subscribeVerdicts.
+// Publishing is a lock-free check while nobody is subscribed.
+class VerdictHub {
+public:
+  static const size_t QUEUE_CAPACITY = 256;
+
+  VerdictHub();
+
+  std::shared_ptr<VerdictQueue> subscribe(const std::string &mission_id,
+                                          bool untagged);
+  void unsubscribe(const std::shared_ptr<VerdictQueue> &queue);
+
+  bool hasSubscribers() const;
+  void publish(const PropertyVerdict &verdict);
+
+  // Closes the queues of all subscribers, and of those that subscribe until
+  // reopen() is called, so that their calls finish
+  void close();
+  void reopen();
+
+private:
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<VerdictQueue>> queues_;
+  std::atomic<size_t> count_;
+  bool closed_;
+};
+
+#endif
@@ -27,6 +27,7 @@
 #include "client.h"
 #include "guidance.h"
 #include "mavsdkutils.h"
+#include <chrono>
 #include <iostream>
 #include <unistd.h>
 
@@ -35,6 +36,93 @@ void ClientStatus::saveStatus(StatusMessage statusMessage) {
   ::google::protobuf::Empty reply;
   Status status = stub_->saveStatus(&context, statusMessage, &reply);
   // log_ptr->information("Status message sent.");
+  sendToAssurance(statusMessage);
+}
+
+// A call to the broker that outlives saveStatus()
+struct AssuranceCall {
+  ClientContext context;
+  StatusMessage request;
+  ::google::protobuf::Empty reply;
+};
+
+// Sends the status to the broker without waiting for it, so the broker never
+// delays the status of the mission manager. Statuses are sent one at a time,
+// in order, since the broker finds the changes between consecutive ones. Those
+// that arrive while the broker is busy are queued, and the oldest are dropped
+// and counted if it falls too far behind.
+void ClientStatus::sendToAssurance(const StatusMessage &statusMessage) {
+  if (assurance_stub_ == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(assurance_mutex_);
+    if (std::chrono::steady_clock::now() < assurance_retry_) {
+      return;
+    }
+    if (assurance_busy_) {
+      if (assurance_queue_.size() == ASSURANCE_QUEUE) {
+        assurance_queue_.pop_front();
+        ++assurance_dropped_;
+      }
+      assurance_queue_.push_back(statusMessage);
+      return;
+    }
+    assurance_busy_ = true;
+  }
+  startAssurance(statusMessage);
+}
+
+void ClientStatus::startAssurance(StatusMessage statusMessage) {
+  auto call = std::make_shared<AssuranceCall>();
+  call->request = std::move(statusMessage);
+  call->context.set_deadline(std::chrono::system_clock::now() +
+                             std::chrono::milliseconds(ASSURANCE_DEADLINE_MS));
+  if (!mission_id_.empty()) {
+    call->context.AddMetadata("mission-id", mission_id_);
+  }
+  assurance_stub_->async()->saveStatus(
+      &call->context, &call->request, &call->reply,
+      [this, call](Status status) { finishAssurance(status); });
+}
+
+// Called on a gRPC thread when the broker answers; sends the next status
+void ClientStatus::finishAssurance(const Status &status) {
+  bool unimplemented = status.error_code() == grpc::StatusCode::UNIMPLEMENTED;
+  StatusMessage next;
+  bool more = false;
+  std::uint64_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(assurance_mutex_);
+    if (unimplemented) {
+      // Asked again later, in case the broker is restarted with predicates
+      assurance_retry_ = std::chrono::steady_clock::now() +
+                         std::chrono::milliseconds(ASSURANCE_RETRY_MS);
+      assurance_queue_.clear();
+    } else if (!status.ok()) {
+      ++assurance_dropped_;
+    } else {
+      std::swap(dropped, assurance_dropped_);
+    }
+    more = !assurance_queue_.empty();
+    if (more) {
+      next = std::move(assurance_queue_.front());
+      assurance_queue_.pop_front();
+    } else {
+      assurance_busy_ = false;
+    }
+  }
+  if (unimplemented) {
+    log_ptr->information("Assurance broker has no telemetry predicates, not "
+                         "sending it the status for a while");
+  }
+  if (dropped > 0) {
+    log_ptr->warning("Assurance broker missed " + std::to_string(dropped) +
+                     " statuses");
+  }
+  if (more) {
+    startAssurance(std::move(next));
+  }
 }
 
 void ClientStatus::logState(VehicleState vehicleState) {
@@ -63,7 +151,8 @@ void ClientStatus::logState(VehicleState vehicleState) {
 }
 
 // This function is in a run forever thread
-void RunClient(Logger &logger, std::string client_addr_port) {
+void RunClient(Logger &logger, std::string client_addr_port,
+               std::string assurance_addr_port, std::string mission_id) {
   logger.information("RunClient() starting on port: " + client_addr_port);
   MAVSDKUtils *mavsdkUtils = MAVSDKUtils::getInstance(&logger);
   sleep(5); // Wait until things get settled
@@ -73,7 +162,9 @@ void RunClient(Logger &logger, std::string client_addr_port) {
   mavsdkUtils->SubscribeAttitudeEuler();
   mavsdkUtils->SubscribeAngularVelocityBody();
   mavsdkUtils->SubscribeOdometry();
-  ClientStatus &client1 = ClientStatus::getInstance(&logger, client_addr_port);
+  ClientStatus &client1 =
+      ClientStatus::getInstance(&logger, client_addr_port, assurance_addr_port,
+                                mission_id);
 
   // Run forever and periodically send the status back to the mission manager
   while (1) {
@@ -28,6 +28,11 @@
 #ifndef CLIENT_H_H
 #define CLIENT_H_H
 
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include "IStatus.h"
@@ -47,24 +52,64 @@ using namespace uav;
 /*
  *  This class implements the IMissionManagerStatus interface
  *  Calling saveStatus() periodically sends the information
- *  we receive from PX4 back to the mission manager
+ *  we receive from PX4 back to the mission manager, and to the
+ *  assurance broker, which derives monitor actions from it
  */
 class ClientStatus : public IMissionManagerStatus {
 
 private:
   std::unique_ptr<MissionManagerStatus::Stub> stub_;
+  std::unique_ptr<MissionManagerStatus::Stub> assurance_stub_;
   Logger *log_ptr;
+  // Sent to the broker with each status, so that it keeps the telemetry of
+  // each vehicle apart
+  std::string mission_id_;
 
-  ClientStatus(const std::string &client_addr_port)
+  // The broker only reads the status, so it gets little time to answer
+  static const long ASSURANCE_DEADLINE_MS = 200;
+
+  // Statuses waiting for the broker to answer the previous one; the oldest
+  // are dropped beyond this
+  static const size_t ASSURANCE_QUEUE = 64;
+  // How long to wait before sending to a broker that has no saveStatus, i.e.
+  // no telemetry predicates, again
+  static const long ASSURANCE_RETRY_MS = 10000;
+
+  // Guards the fields below, which are also used by the callbacks of gRPC
+  std::mutex assurance_mutex_;
+  std::deque<StatusMessage> assurance_queue_;
+  // Set while a status sent to the broker is unanswered
+  bool assurance_busy_ = false;
+  // Statuses the broker did not get since this was last logged
+  std::uint64_t assurance_dropped_ = 0;
+  // Statuses are not sent to the broker before this
+  std::chrono::steady_clock::time_point assurance_retry_;
+
+  void sendToAssurance(const StatusMessage &statusMessage);
+  void startAssurance(StatusMessage statusMessage);
+  void finishAssurance(const Status &status);
+
+  ClientStatus(const std::string &client_addr_port,
+               const std::string &assurance_addr_port,
+               const std::string &mission_id)
       : stub_(MissionManagerStatus::NewStub(grpc::CreateChannel(
-            client_addr_port, grpc::InsecureChannelCredentials()))) {}
+            client_addr_port, grpc::InsecureChannelCredentials()))),
+        mission_id_(mission_id) {
+    if (!assurance_addr_port.empty()) {
+      assurance_stub_ = MissionManagerStatus::NewStub(grpc::CreateChannel(
+          assurance_addr_port, grpc::InsecureChannelCredentials()));
+    }
+  }
 
 public:
   static ClientStatus &
-  getInstance(Logger *log, const std::string &client_addr_port = "0.0.0.0:0") {
+  getInstance(Logger *log, const std::string &client_addr_port = "0.0.0.0:0",
+              const std::string &assurance_addr_port = "",
+              const std::string &mission_id = "") {
     static ClientStatus *instance = nullptr;
     if (instance == nullptr) {
-      instance = new ClientStatus(client_addr_port);
+      instance =
+          new ClientStatus(client_addr_port, assurance_addr_port, mission_id);
       instance->log_ptr = log;
     }
     return *instance;
@@ -77,6 +122,8 @@ public:
   void logState(VehicleState vehicleState);
 };
 
-void RunClient(Logger &logger, std::string client_addr_port);
+void RunClient(Logger &logger, std::string client_addr_port,
+               std::string assurance_addr_port = "",
+               std::string mission_id = "");
 
 #endif
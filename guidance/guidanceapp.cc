@@ -70,20 +70,26 @@ using Poco::Util::ServerApplication;
 
 class ClientTask : public Task {
 public:
-  ClientTask(std::string clnt_addr_port) : Task("GuidanceAppClientTask") {
+  ClientTask(std::string clnt_addr_port, std::string assur_addr_port,
+             std::string mission)
+      : Task("GuidanceAppClientTask") {
     _logger.information("Client task starting");
     client_addr_port = clnt_addr_port;
+    assurance_addr_port = assur_addr_port;
+    mission_id = mission;
   }
 
   void runTask() {
     Application &app = Application::instance();
-    RunClient(_logger, client_addr_port);
+    RunClient(_logger, client_addr_port, assurance_addr_port, mission_id);
     _logger.information("Exiting client task");
   }
 
 private:
   Logger &_logger = Logger::get("Application");
   std::string client_addr_port;
+  std::string assurance_addr_port;
+  std::string mission_id;
 };
 
 /*
@@ -171,6 +177,19 @@ protected:
             .repeatable(false)
             .callback(
                 OptionCallback<GuidanceApp>(this, &GuidanceApp::handleHelp)));
+
+    options.addOption(
+        Option("mission", "m",
+               "mission id sent with the telemetry to the assurance broker")
+            .required(false)
+            .repeatable(false)
+            .argument("id")
+            .callback(OptionCallback<GuidanceApp>(
+                this, &GuidanceApp::handleMission)));
+  }
+
+  void handleMission(const std::string &name, const std::string &value) {
+    _missionId = value;
   }
 
   void handleHelp(const std::string &name, const std::string &value) {
@@ -203,6 +222,10 @@ protected:
           ports.getAddress("MISSIONMANAGER_STATUS_PORT");
       std::cout << "Guidance client address: " << client_addr_port << std::endl;
 
+      // The assurance broker also receives the status, to check the
+      // telemetry predicates it is given
+      std::string assurance_addr_port = ports.getAddress("ASSURANCEBRKR_PORT");
+
       // ports.displayAllPorts();
 
       Poco::Semaphore server_ready_sem(0, 1);
@@ -211,7 +234,8 @@ protected:
 
       // Wait for the server to be ready before starting the other tasks
       server_ready_sem.wait();
-      tm.start(new ClientTask(client_addr_port));
+      tm.start(
+          new ClientTask(client_addr_port, assurance_addr_port, _missionId));
       tm.start(new GovernorTask());
 
       waitForTerminationRequest();
@@ -223,6 +247,7 @@ protected:
 
 private:
   bool _helpRequested;
+  std::string _missionId;
 };
 
 // This is a substitute for the main program in C++
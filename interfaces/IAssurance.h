@@ -37,6 +37,11 @@ public:
    * Returns the lock status of the release mechanism.
    */
   virtual bool checkState(std::string current_state) = 0;
+
+  /**
+   * Reports the state without waiting for the verdict of the broker.
+   */
+  virtual void postState(std::string current_state) = 0;
 };
 
 #endif
@@ -0,0 +1,134 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+/*
+ * Microbenchmark for LTLMonitorBank: per-event cost of stepping N monitors
+ * through the bank, with step() and with stepConcurrent(), compared with
+ * stepping N separate LTLMonitor instances. Each monitor knows a quarter of
+ * the actions, so the bank only steps the monitors that know each event.
+ */
+
+#include "ltlmonbank.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+static const int STATES = 16;
+static const int LOCAL_ACTIONS = 8;
+static const int GLOBAL_ACTIONS = 32;
+static const int EVENTS = 200000;
+
+// Keeps the results of the steps observable so they are not optimized out
+static volatile uint64_t sink;
+
+/*
+ * Random monitor over a subset of the global alphabet. All states are
+ * inconclusive, so every event is a table lookup.
+ */
+static LTLMonitor randomMonitor(mt19937 &rng) {
+  vector<State> states;
+  for (int s = 0; s < STATES; ++s) {
+    states.push_back(State{"?(" + to_string(s) + ")", State::INCONCLUSIVE});
+  }
+  vector<string> actions;
+  uniform_int_distribution<int> actionDist(0, GLOBAL_ACTIONS - 1);
+  while (actions.size() < LOCAL_ACTIONS) {
+    string name = "e" + to_string(actionDist(rng));
+    if (find(actions.begin(), actions.end(), name) == actions.end()) {
+      actions.push_back(name);
+    }
+  }
+  vector<int32_t> table(STATES * LOCAL_ACTIONS);
+  uniform_int_distribution<int> stateDist(0, STATES - 1);
+  for (auto &next : table) {
+    next = stateDist(rng);
+  }
+  LTLMonitor monitor;
+  monitor.initialize("random", states, actions, table, 0);
+  return monitor;
+}
+
+int main(int, char **) {
+  mt19937 rng(42);
+  vector<string> events;
+  uniform_int_distribution<int> actionDist(0, GLOBAL_ACTIONS - 1);
+  for (int i = 0; i < EVENTS; ++i) {
+    events.push_back("e" + to_string(actionDist(rng)));
+  }
+
+  cout << "monitors\tbank ns/event\tconcurrent ns/event\tseparate ns/event"
+       << endl;
+  for (size_t n = 1; n <= 256; n *= 2) {
+    LTLMonitorBank bank;
+    vector<LTLMonitor> separate;
+    for (size_t i = 0; i < n; ++i) {
+      mt19937 monitorRng(i);
+      bank.add(randomMonitor(monitorRng));
+      monitorRng.seed(i);
+      separate.push_back(randomMonitor(monitorRng));
+    }
+
+    vector<LTLMonitorBank::ActionId> bankEvents;
+    for (const auto &event : events) {
+      bankEvents.push_back(bank.internAction(event));
+    }
+    vector<vector<LTLMonitor::ActionId>> separateEvents(n);
+    for (size_t i = 0; i < n; ++i) {
+      for (const auto &event : events) {
+        separateEvents[i].push_back(separate[i].internAction(event));
+      }
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (auto action : bankEvents) {
+      sink += bank.step(action)[0];
+    }
+    auto bankEnd = chrono::steady_clock::now();
+    LTLMonitorBank::MaskT violated;
+    for (auto action : bankEvents) {
+      bank.stepConcurrent(action, violated);
+      sink += violated[0];
+    }
+    auto concurrentEnd = chrono::steady_clock::now();
+    for (size_t e = 0; e < events.size(); ++e) {
+      for (size_t i = 0; i < n; ++i) {
+        sink += separate[i].step(separateEvents[i][e]);
+      }
+    }
+    auto separateEnd = chrono::steady_clock::now();
+
+    double bankNs = chrono::duration<double, nano>(bankEnd - start).count();
+    double concurrentNs =
+        chrono::duration<double, nano>(concurrentEnd - bankEnd).count();
+    double separateNs =
+        chrono::duration<double, nano>(separateEnd - concurrentEnd).count();
+    cout << n << "\t\t" << bankNs / EVENTS << "\t\t" << concurrentNs / EVENTS
+         << "\t\t\t" << separateNs / EVENTS << endl;
+  }
+  return 0;
+}
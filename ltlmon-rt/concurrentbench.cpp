@@ -0,0 +1,143 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+/*
+ * Thread-scaling benchmark for concurrent stepping: total events per second
+ * when T threads step one shared LTLMonitor (compare-and-swap), one shared
+ * instance behind a mutex, and one LTLMonitorBank with stepConcurrent().
+ */
+
+#include "ltlmonbank.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+static const int STATES = 16;
+static const int ACTIONS = 8;
+static const int BANK_MONITORS = 16;
+static const int EVENTS_PER_THREAD = 200000;
+
+// Keeps the results of the steps observable so they are not optimized out
+static volatile uint64_t sink;
+
+/*
+ * Random monitor where all states are inconclusive and most actions change
+ * the state, so that threads contend on every event
+ */
+static LTLMonitor randomMonitor(mt19937 &rng) {
+  vector<State> states;
+  for (int s = 0; s < STATES; ++s) {
+    states.push_back(State{"?(" + to_string(s) + ")", State::INCONCLUSIVE});
+  }
+  vector<string> actions;
+  for (int a = 0; a < ACTIONS; ++a) {
+    actions.push_back("e" + to_string(a));
+  }
+  vector<int32_t> table(STATES * ACTIONS);
+  uniform_int_distribution<int> stateDist(0, STATES - 1);
+  for (auto &next : table) {
+    next = stateDist(rng);
+  }
+  LTLMonitor monitor;
+  monitor.initialize("random", states, actions, table, 0);
+  return monitor;
+}
+
+/*
+ * Runs body(thread) on the given number of threads and returns the events
+ * per second over all of them
+ */
+static double run(unsigned threads, const function<void(unsigned)> &body) {
+  auto start = chrono::steady_clock::now();
+  vector<thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back(body, t);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return threads * double(EVENTS_PER_THREAD) / seconds;
+}
+
+int main(int, char **) {
+  mt19937 rng(42);
+  LTLMonitor shared = randomMonitor(rng);
+  const MonitorAutomaton &automaton = shared.getAutomaton();
+  LTLMonitorBank bank;
+  for (int i = 0; i < BANK_MONITORS; ++i) {
+    bank.add(randomMonitor(rng));
+  }
+
+  unsigned maxThreads = max(8u, thread::hardware_concurrency());
+  vector<vector<LTLMonitor::ActionId>> events(maxThreads);
+  uniform_int_distribution<int> actionDist(0, ACTIONS - 1);
+  for (auto &threadEvents : events) {
+    for (int i = 0; i < EVENTS_PER_THREAD; ++i) {
+      threadEvents.push_back(actionDist(rng));
+    }
+  }
+
+  MonitorInstance locked = automaton.newInstance();
+  mutex lockedMutex;
+
+  cout << "threads\tCAS Mevents/s\tmutex Mevents/s\tbank Mevents/s ("
+       << BANK_MONITORS << " monitors)" << endl;
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    double cas = run(threads, [&](unsigned t) {
+      uint64_t passed = 0;
+      for (auto action : events[t]) {
+        passed += shared.step(action);
+      }
+      sink += passed;
+    });
+    double withMutex = run(threads, [&](unsigned t) {
+      uint64_t passed = 0;
+      for (auto action : events[t]) {
+        lock_guard<mutex> lock(lockedMutex);
+        passed += automaton.step(locked, action);
+      }
+      sink += passed;
+    });
+    double banked = run(threads, [&](unsigned t) {
+      LTLMonitorBank::MaskT violated;
+      for (auto action : events[t]) {
+        bank.stepConcurrent(action, violated);
+        sink += violated[0];
+      }
+    });
+    cout << threads << "\t" << cas / 1e6 << "\t\t" << withMutex / 1e6
+         << "\t\t" << banked / 1e6 << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "instancetable.hpp"
+
+using namespace std;
+
+InstanceTable::InstanceTable(std::shared_ptr<const MonitorAutomaton> automaton)
+    : automaton(automaton), count(0) {}
+
+InstanceTable::SlotT InstanceTable::find(KeyT key) const {
+  return (key < used.size() && used[key]) ? key : NO_SLOT;
+}
+
+InstanceTable::SlotT InstanceTable::acquire(KeyT key) {
+  while (key >= used.size()) {
+    slabs.emplace_back(new MonitorInstance[SLAB_SIZE]);
+    used.resize(slabs.size() * SLAB_SIZE);
+  }
+  if (!used[key]) {
+    get(key) = automaton->newInstance();
+    used[key] = true;
+    ++count;
+  }
+  return key;
+}
+
+bool InstanceTable::release(KeyT key) {
+  if (find(key) == NO_SLOT) {
+    return false;
+  }
+  used[key] = false;
+  --count;
+  return true;
+}
+
+bool InstanceTable::step(SlotT slot, ActionId action) {
+  return automaton->step(get(slot), action);
+}
+
+MonitorInstance &InstanceTable::get(SlotT slot) {
+  return slabs[slot / SLAB_SIZE][slot % SLAB_SIZE];
+}
+
+const MonitorInstance &InstanceTable::get(SlotT slot) const {
+  return slabs[slot / SLAB_SIZE][slot % SLAB_SIZE];
+}
+
+size_t InstanceTable::size() const { return count; }
+
+size_t InstanceTable::memoryBytes() const {
+  return slabs.size() * SLAB_SIZE * sizeof(MonitorInstance) +
+         used.capacity() / 8;
+}
+
+const MonitorAutomaton &InstanceTable::getAutomaton() const {
+  return *automaton;
+}
@@ -0,0 +1,92 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef INSTANCETABLE_HPP_H
+#define INSTANCETABLE_HPP_H
+
+#include "ltlmonrt.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Monitor instances of one automaton, keyed by a dense mission or vehicle id:
+ * the caller numbers them 0, 1, 2, ... (e.g. in the order it first sees
+ * them) and reuses the ids it releases. The id is the slot, and instances
+ * live in fixed-size slabs indexed by it, so a slot stays valid while the
+ * table grows and stepping a slot is a single table lookup. Each instance
+ * takes 4 bytes and a bit that tells whether it is in use.
+ */
+class InstanceTable {
+public:
+  using KeyT = std::uint32_t;
+  using SlotT = std::uint32_t;
+  using ActionId = MonitorAutomaton::ActionId;
+
+  static constexpr SlotT NO_SLOT = ~SlotT(0);
+
+  explicit InstanceTable(std::shared_ptr<const MonitorAutomaton> automaton);
+  InstanceTable(const InstanceTable &) = delete;
+  InstanceTable &operator=(const InstanceTable &) = delete;
+
+  /*
+   * Returns the slot of the instance for key, creating it in the initial
+   * state of the automaton if there is none. key must be below NO_SLOT.
+   */
+  SlotT acquire(KeyT key);
+
+  /*
+   * Returns the slot of the instance for key, or NO_SLOT
+   */
+  SlotT find(KeyT key) const;
+
+  /*
+   * Removes the instance for key; the key may be acquired again
+   */
+  bool release(KeyT key);
+
+  bool step(SlotT slot, ActionId action);
+  MonitorInstance &get(SlotT slot);
+  const MonitorInstance &get(SlotT slot) const;
+
+  size_t size() const;
+  size_t memoryBytes() const;
+  const MonitorAutomaton &getAutomaton() const;
+
+private:
+  static constexpr size_t SLAB_SIZE = 4096;
+
+  std::shared_ptr<const MonitorAutomaton> automaton;
+  std::vector<std::unique_ptr<MonitorInstance[]>> slabs;
+
+  /*
+   * Whether each key has an instance, for the keys the slabs cover
+   */
+  std::vector<bool> used;
+  size_t count;
+};
+
+#endif
@@ -0,0 +1,387 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "ltlmonaudit.hpp"
+#include "ltlmonimage.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t) &&
+                  atomic<uint32_t>::is_always_lock_free,
+              "record kinds are written in place as atomics");
+
+/*
+ * The kind of a record is written last, with release semantics, so that a
+ * record is complete once its kind is set
+ */
+static atomic<uint32_t> &kindOf(AuditRecord *record) {
+  return *reinterpret_cast<atomic<uint32_t> *>(&record->kind);
+}
+
+static uint64_t recordsPerPage() {
+  long page = sysconf(_SC_PAGESIZE);
+  return max<uint64_t>(1, (page > 0 ? page : 4096) / sizeof(AuditRecord));
+}
+
+AuditLog::AuditLog()
+    : fd(-1), chunkRecords(0), next(1), sequence(1), durable(1),
+      failed(false), stopping(false) {}
+
+AuditLog::~AuditLog() { close(); }
+
+bool AuditLog::open(const string &path, uint64_t records,
+                    long flushIntervalMs) {
+  close();
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) != 0) {
+    cerr << "AuditLog: couldn't open " << path << endl;
+    close();
+    return false;
+  }
+
+  const uint64_t perPage = recordsPerPage();
+  AuditHeader header = {};
+  if (fileStat.st_size == 0) {
+    chunkRecords =
+        (max<uint64_t>(records, 1) + perPage - 1) / perPage * perPage;
+    memcpy(header.magic, AUDIT_MAGIC, sizeof(AUDIT_MAGIC));
+    header.version = AUDIT_VERSION;
+    header.byteOrder = IMAGE_BYTE_ORDER;
+    header.recordSize = sizeof(AuditRecord);
+    header.chunkRecords = chunkRecords;
+    if (pwrite(fd, &header, sizeof(header), 0) !=
+        static_cast<ssize_t>(sizeof(header))) {
+      cerr << "AuditLog: couldn't write " << path << endl;
+      close();
+      return false;
+    }
+  } else {
+    if (pread(fd, &header, sizeof(header), 0) !=
+            static_cast<ssize_t>(sizeof(header)) ||
+        memcmp(header.magic, AUDIT_MAGIC, sizeof(AUDIT_MAGIC)) != 0 ||
+        header.version != AUDIT_VERSION ||
+        header.byteOrder != IMAGE_BYTE_ORDER ||
+        header.recordSize != sizeof(AuditRecord) ||
+        header.chunkRecords == 0 || header.chunkRecords % perPage != 0) {
+      cerr << "AuditLog: missing/wrong header in " << path << endl;
+      close();
+      return false;
+    }
+    chunkRecords = header.chunkRecords;
+  }
+
+  chunks.reset(new atomic<AuditRecord *>[MAX_CHUNKS]);
+  for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+    chunks[c].store(nullptr, memory_order_relaxed);
+  }
+  const uint64_t chunkBytes = chunkRecords * sizeof(AuditRecord);
+  const size_t existing =
+      min<size_t>(MAX_CHUNKS, (fileStat.st_size + chunkBytes - 1) / chunkBytes);
+  for (size_t c = 0; c < existing; ++c) {
+    if (mapChunk(c) == nullptr) {
+      close();
+      return false;
+    }
+  }
+
+  // Appends after the last complete record. Sequences continue after the
+  // highest one near the end; records of concurrent checks are never more
+  // than a chunk apart.
+  uint64_t end = max<uint64_t>(1, existing * chunkRecords);
+  while (end > 1 && kindAt(end - 1) == AUDIT_FREE) {
+    --end;
+  }
+  uint64_t lastSequence = 0;
+  for (uint64_t i = max<uint64_t>(1, end - min(end, chunkRecords)); i < end;
+       ++i) {
+    AuditRecord *record = slot(i);
+    if (record->kind != AUDIT_FREE) {
+      lastSequence = max(lastSequence, record->sequence);
+    }
+  }
+  next.store(end);
+  durable.store(end);
+  sequence.store(lastSequence + 1);
+  failed.store(false);
+  stopping = false;
+  flusher = thread(&AuditLog::flushLoop, this, flushIntervalMs);
+  return true;
+}
+
+void AuditLog::close() {
+  if (flusher.joinable()) {
+    {
+      lock_guard<mutex> lock(flushMutex);
+      stopping = true;
+    }
+    flushWake.notify_one();
+    flusher.join();
+    flush();
+  }
+  if (chunks) {
+    const uint64_t chunkBytes = chunkRecords * sizeof(AuditRecord);
+    for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+      AuditRecord *base = chunks[c].load(memory_order_acquire);
+      if (base != nullptr) {
+        munmap(base, chunkBytes);
+      }
+    }
+    chunks.reset();
+  }
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+uint64_t AuditLog::nextSequence(uint64_t count) {
+  return sequence.fetch_add(count, memory_order_relaxed);
+}
+
+void AuditLog::append(const AuditRecord &record) {
+  if (failed.load(memory_order_relaxed)) {
+    return;
+  }
+  write(next.fetch_add(1, memory_order_relaxed), record);
+}
+
+void AuditLog::append(const AuditRecord &record, string_view text) {
+  if (failed.load(memory_order_relaxed)) {
+    return;
+  }
+  const size_t rest = text.size() - min(text.size(), AUDIT_TEXT_SIZE);
+  const uint64_t parts = (rest + AUDIT_TEXT_SIZE - 1) / AUDIT_TEXT_SIZE;
+  uint64_t index = next.fetch_add(parts + 1, memory_order_relaxed);
+  AuditRecord part = {};
+  part.sequence = record.sequence;
+  part.timestamp = record.timestamp;
+  part.kind = AUDIT_TEXT;
+  part.action = -1;
+  part.monitor = -1;
+  part.from = -1;
+  part.to = -1;
+  for (uint64_t p = 0; p < parts; ++p) {
+    setText(part, text.substr((p + 1) * AUDIT_TEXT_SIZE));
+    write(index++, part);
+  }
+  AuditRecord first = record;
+  setText(first, text);
+  write(index, first);
+}
+
+void AuditLog::write(uint64_t index, const AuditRecord &record) {
+  AuditRecord *target = slot(index);
+  if (target == nullptr) {
+    if (!failed.exchange(true)) {
+      cerr << "AuditLog: couldn't grow the log, records are lost" << endl;
+    }
+    return;
+  }
+  // Everything but the kind, which completes the record
+  const size_t kindOffset = offsetof(AuditRecord, kind);
+  const size_t restOffset = kindOffset + sizeof(record.kind);
+  memcpy(target, &record, kindOffset);
+  memcpy(reinterpret_cast<char *>(target) + restOffset,
+         reinterpret_cast<const char *>(&record) + restOffset,
+         sizeof(AuditRecord) - restOffset);
+  kindOf(target).store(record.kind, memory_order_release);
+}
+
+void AuditLog::flush() {
+  lock_guard<mutex> lock(syncMutex);
+  if (fd < 0 || !chunks) {
+    return;
+  }
+  // Only the complete records at the start of what was appended since the
+  // last flush; the rest waits for the next one
+  const uint64_t from = durable.load(memory_order_relaxed);
+  const uint64_t end = next.load(memory_order_acquire);
+  uint64_t to = from;
+  while (to < end && kindAt(to) != AUDIT_FREE) {
+    ++to;
+  }
+  if (to == from) {
+    return;
+  }
+
+  const uint64_t pageBytes = recordsPerPage() * sizeof(AuditRecord);
+  for (uint64_t i = from; i < to;) {
+    const size_t chunk = i / chunkRecords;
+    const uint64_t chunkEnd = min(to, (chunk + 1) * chunkRecords);
+    char *base =
+        reinterpret_cast<char *>(chunks[chunk].load(memory_order_acquire));
+    uint64_t first = (i - chunk * chunkRecords) * sizeof(AuditRecord);
+    first -= first % pageBytes;
+    const uint64_t last =
+        (chunkEnd - chunk * chunkRecords) * sizeof(AuditRecord);
+    msync(base + first, last - first, MS_SYNC);
+    i = chunkEnd;
+  }
+  // Makes the size of new chunks durable as well
+  fdatasync(fd);
+  durable.store(to, memory_order_release);
+}
+
+uint64_t AuditLog::getCount() const {
+  return next.load(memory_order_acquire) - 1;
+}
+
+uint64_t AuditLog::getDurableCount() const {
+  return durable.load(memory_order_acquire) - 1;
+}
+
+void AuditLog::setText(AuditRecord &record, string_view text) {
+  memset(record.text, 0, AUDIT_TEXT_SIZE);
+  memcpy(record.text, text.data(), min(text.size(), AUDIT_TEXT_SIZE));
+}
+
+string AuditLog::getText(const AuditRecord &record) {
+  return string(record.text, strnlen(record.text, AUDIT_TEXT_SIZE));
+}
+
+AuditRecord *AuditLog::slot(uint64_t index) {
+  const size_t chunk = index / chunkRecords;
+  if (chunk >= MAX_CHUNKS) {
+    return nullptr;
+  }
+  AuditRecord *base = chunks[chunk].load(memory_order_acquire);
+  if (base == nullptr) {
+    base = mapChunk(chunk);
+  }
+  return (base == nullptr) ? nullptr : base + index % chunkRecords;
+}
+
+AuditRecord *AuditLog::mapChunk(size_t chunk) {
+  lock_guard<mutex> lock(mapMutex);
+  AuditRecord *base = chunks[chunk].load(memory_order_acquire);
+  if (base != nullptr) {
+    return base;
+  }
+  // Allocated up front, so that a full disk fails here instead of with a
+  // SIGBUS when a record is written
+  const off_t bytes = chunkRecords * sizeof(AuditRecord);
+  const off_t offset = chunk * bytes;
+  struct stat fileStat;
+  if (posix_fallocate(fd, offset, bytes) != 0 &&
+      (fstat(fd, &fileStat) != 0 ||
+       (fileStat.st_size < offset + bytes &&
+        ftruncate(fd, offset + bytes) != 0))) {
+    cerr << "AuditLog: couldn't allocate chunk " << chunk << endl;
+    return nullptr;
+  }
+  void *data =
+      mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+  if (data == MAP_FAILED) {
+    cerr << "AuditLog: couldn't map chunk " << chunk << endl;
+    return nullptr;
+  }
+  base = static_cast<AuditRecord *>(data);
+  chunks[chunk].store(base, memory_order_release);
+  return base;
+}
+
+uint32_t AuditLog::kindAt(uint64_t index) {
+  const size_t chunk = index / chunkRecords;
+  AuditRecord *base = (chunk < MAX_CHUNKS)
+                          ? chunks[chunk].load(memory_order_acquire)
+                          : nullptr;
+  if (base == nullptr) {
+    return AUDIT_FREE;
+  }
+  return kindOf(base + index % chunkRecords).load(memory_order_acquire);
+}
+
+void AuditLog::flushLoop(long intervalMs) {
+  unique_lock<mutex> lock(flushMutex);
+  while (!stopping) {
+    flushWake.wait_for(lock, chrono::milliseconds(intervalMs),
+                       [this] { return stopping; });
+    lock.unlock();
+    flush();
+    // Maps the next chunk ahead of the writers once half of this one is used
+    const uint64_t used = next.load(memory_order_relaxed);
+    const size_t ahead = used / chunkRecords + 1;
+    if (used % chunkRecords > chunkRecords / 2 && ahead < MAX_CHUNKS) {
+      slot(ahead * chunkRecords);
+    }
+    lock.lock();
+  }
+}
+
+bool readAuditLog(
+    const string &path,
+    const function<void(const AuditRecord &, const string &)> &visit) {
+  ifstream input(path, ios::binary);
+  if (!input.is_open()) {
+    cerr << "AuditLog: couldn't open " << path << endl;
+    return false;
+  }
+  AuditHeader header;
+  if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      memcmp(header.magic, AUDIT_MAGIC, sizeof(AUDIT_MAGIC)) != 0 ||
+      header.version != AUDIT_VERSION ||
+      header.byteOrder != IMAGE_BYTE_ORDER ||
+      header.recordSize != sizeof(AuditRecord)) {
+    cerr << "AuditLog: missing/wrong header in " << path << endl;
+    return false;
+  }
+  // Continuations by sequence, until the record they belong to. Those of a
+  // record whose writer stopped before appending it are never visited.
+  map<uint64_t, string> continued;
+  vector<AuditRecord> block(4096);
+  while (input) {
+    input.read(reinterpret_cast<char *>(block.data()),
+               block.size() * sizeof(AuditRecord));
+    size_t count = input.gcount() / sizeof(AuditRecord);
+    for (size_t i = 0; i < count; ++i) {
+      const AuditRecord &record = block[i];
+      if (record.kind == AUDIT_TEXT) {
+        continued[record.sequence] += AuditLog::getText(record);
+      } else if (record.kind != AUDIT_FREE) {
+        string text = AuditLog::getText(record);
+        auto rest = continued.find(record.sequence);
+        if (rest != continued.end()) {
+          text += rest->second;
+          continued.erase(rest);
+        }
+        visit(record, text);
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,206 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef LTLMONAUDIT_HPP_H
+#define LTLMONAUDIT_HPP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/*
+ * Append-only audit log of monitor checks, made of fixed-size records:
+ *
+ *   AuditHeader
+ *   AuditRecord[...]
+ *
+ * The header takes the place of the first record. The file grows in chunks
+ * of chunkRecords records that are preallocated and mapped once, so appending
+ * is a copy into shared memory. A record is complete once its kind is set;
+ * records of kind AUDIT_FREE were never written, or were being written when
+ * the writer stopped, and readers skip them. Like checkpoints, audit logs use
+ * the byte order of the machine that wrote them.
+ */
+enum AuditKind : std::uint32_t {
+  AUDIT_FREE = 0,
+  // An action was checked: action, verdict, and the mission id as text
+  AUDIT_CHECK = 1,
+  // A monitor was stepped by the check with the same sequence: monitor,
+  // from, to, verdict, and the mission id as text
+  AUDIT_STEP = 2,
+  // Name of the check with the same sequence, whose action is not known
+  AUDIT_UNKNOWN = 3,
+  // Dictionary written whenever the monitors are loaded: the name of an
+  // action, or the property of a monitor, as text
+  AUDIT_ACTION = 4,
+  AUDIT_MONITOR = 5,
+  // Continuation of the text of the next record with the same sequence:
+  // texts longer than AUDIT_TEXT_SIZE are split into records of this kind,
+  // appended in order just before the record that holds their first bytes
+  AUDIT_TEXT = 6
+};
+
+static constexpr size_t AUDIT_TEXT_SIZE = 24;
+
+struct AuditRecord {
+  std::uint64_t sequence;
+  std::int64_t timestamp;
+  std::uint32_t kind;
+  std::int32_t action;
+  std::int32_t monitor;
+  std::int32_t from;
+  std::int32_t to;
+  std::uint32_t verdict;
+  // First bytes of the text, NUL-terminated only if shorter than
+  // AUDIT_TEXT_SIZE; the rest is in the AUDIT_TEXT records before this one
+  char text[AUDIT_TEXT_SIZE];
+};
+
+struct AuditHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint32_t recordSize;
+  std::uint32_t reserved;
+  std::uint64_t chunkRecords;
+  char padding[32];
+};
+
+static_assert(sizeof(AuditRecord) == 64, "audit records are 64 bytes");
+static_assert(sizeof(AuditHeader) == sizeof(AuditRecord),
+              "the audit header takes one record");
+
+static constexpr char AUDIT_MAGIC[8] = {'L', 'T', 'L', 'M', 'O', 'N', 'A', 0};
+static constexpr std::uint32_t AUDIT_VERSION = 1;
+
+class AuditLog {
+public:
+  static constexpr std::uint64_t DEFAULT_CHUNK_RECORDS = 65536;
+  static constexpr long DEFAULT_FLUSH_INTERVAL_MS = 50;
+
+  AuditLog();
+  AuditLog(const AuditLog &) = delete;
+  AuditLog &operator=(const AuditLog &) = delete;
+  ~AuditLog();
+
+  /*
+   * Opens the log, appending to it if it exists, and starts the flusher.
+   * chunkRecords is rounded up to a whole number of pages; an existing log
+   * keeps the chunk size it was created with.
+   */
+  bool open(const std::string &path,
+            std::uint64_t chunkRecords = DEFAULT_CHUNK_RECORDS,
+            long flushIntervalMs = DEFAULT_FLUSH_INTERVAL_MS);
+
+  /*
+   * Flushes the log and closes it
+   */
+  void close();
+
+  /*
+   * Reserves count consecutive sequence numbers and returns the first. Each
+   * check has its own, shared by all of its records.
+   */
+  std::uint64_t nextSequence(std::uint64_t count = 1);
+
+  /*
+   * Appends the record; can be called from several threads at once. The
+   * record is on disk after the next flush, which happens every
+   * flushIntervalMs for all records appended since the previous one.
+   */
+  void append(const AuditRecord &record);
+
+  /*
+   * Same, with text as the text of the record whatever its length. The bytes
+   * past AUDIT_TEXT_SIZE go into AUDIT_TEXT records that take slots right
+   * before the record.
+   */
+  void append(const AuditRecord &record, std::string_view text);
+
+  /*
+   * Writes all records completed so far to disk
+   */
+  void flush();
+
+  /*
+   * Records appended, and records known to be on disk
+   */
+  std::uint64_t getCount() const;
+  std::uint64_t getDurableCount() const;
+
+  /*
+   * Sets the text of a record, truncated to AUDIT_TEXT_SIZE, and gets it
+   * back without its continuation
+   */
+  static void setText(AuditRecord &record, std::string_view text);
+  static std::string getText(const AuditRecord &record);
+
+private:
+  static constexpr size_t MAX_CHUNKS = 1 << 16;
+
+  AuditRecord *slot(std::uint64_t index);
+  void write(std::uint64_t index, const AuditRecord &record);
+  AuditRecord *mapChunk(size_t chunk);
+  std::uint32_t kindAt(std::uint64_t index);
+  void flushLoop(long intervalMs);
+
+  int fd;
+  std::uint64_t chunkRecords;
+  std::unique_ptr<std::atomic<AuditRecord *>[]> chunks;
+  std::mutex mapMutex;
+
+  // Slot of the next record (slot 0 is the header), next check sequence,
+  // and first slot that may not be on disk yet
+  std::atomic<std::uint64_t> next;
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<std::uint64_t> durable;
+  std::atomic<bool> failed;
+
+  // Held by flush(); flushMutex guards stopping
+  std::mutex syncMutex;
+  std::mutex flushMutex;
+  std::condition_variable flushWake;
+  bool stopping;
+  std::thread flusher;
+};
+
+/*
+ * Calls visit with each complete record of the log, in file order, and its
+ * whole text. AUDIT_TEXT records are only joined to the text of the record
+ * they continue. Fails if the file is not an audit log.
+ */
+bool readAuditLog(
+    const std::string &path,
+    const std::function<void(const AuditRecord &, const std::string &)>
+        &visit);
+
+#endif
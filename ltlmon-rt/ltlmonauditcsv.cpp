@@ -0,0 +1,138 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+/*
+ * Converts an audit log written by AuditLog into CSV.
+ *
+ * Usage: ltlmon-audit-csv <audit log> [<output.csv>]
+ *
+ * Prints one line per record, in file order, to the output file or stdout:
+ *
+ *   sequence,timestamp,kind,mission,action,name,monitor,from,to,verdict
+ *
+ * Records of one check share its sequence. name is the action of check and
+ * step records, looked up in the dictionary written when the monitors were
+ * last loaded, the action of action records, and the property of monitor
+ * records. Texts are whole, with their continuation records joined.
+ */
+
+#include "ltlmonaudit.hpp"
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+static const char *kindName(uint32_t kind) {
+  switch (kind) {
+  case AUDIT_CHECK:
+    return "check";
+  case AUDIT_STEP:
+    return "step";
+  case AUDIT_UNKNOWN:
+    return "unknown";
+  case AUDIT_ACTION:
+    return "action";
+  case AUDIT_MONITOR:
+    return "monitor";
+  }
+  return "invalid";
+}
+
+static string quoted(const string &text) {
+  string result = "\"";
+  for (char c : text) {
+    result += c;
+    if (c == '"') {
+      result += '"';
+    }
+  }
+  return result + "\"";
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2 && argc != 3) {
+    cerr << "usage: " << argv[0] << " <audit log> [<output.csv>]" << endl;
+    return 1;
+  }
+  ofstream file;
+  if (argc == 3) {
+    file.open(argv[2]);
+    if (!file.is_open()) {
+      cerr << "ltlmon-audit-csv: could not create " << argv[2] << endl;
+      return 1;
+    }
+  }
+  ostream &out = (argc == 3) ? file : cout;
+
+  // Action names by id, and names of unknown actions by sequence until their
+  // check record is seen
+  vector<string> actions;
+  map<uint64_t, string> unknown;
+  out << "sequence,timestamp,kind,mission,action,name,monitor,from,to,verdict"
+      << "\n";
+  bool read = readAuditLog(argv[1], [&](const AuditRecord &record,
+                                        const string &text) {
+    string mission;
+    string name;
+    switch (record.kind) {
+    case AUDIT_CHECK:
+    case AUDIT_STEP:
+      mission = text;
+      if (record.action >= 0 &&
+          static_cast<size_t>(record.action) < actions.size()) {
+        name = actions[record.action];
+      } else if (unknown.count(record.sequence) > 0) {
+        name = unknown[record.sequence];
+        if (record.kind == AUDIT_CHECK) {
+          unknown.erase(record.sequence);
+        }
+      }
+      break;
+    case AUDIT_UNKNOWN:
+      name = unknown[record.sequence] = text;
+      break;
+    case AUDIT_ACTION:
+      name = text;
+      if (record.action >= 0) {
+        actions.resize(max<size_t>(actions.size(), record.action + 1));
+        actions[record.action] = name;
+      }
+      break;
+    case AUDIT_MONITOR:
+      name = text;
+      break;
+    }
+    out << record.sequence << "," << record.timestamp << ","
+        << kindName(record.kind) << "," << quoted(mission) << ","
+        << record.action << "," << quoted(name) << "," << record.monitor
+        << "," << record.from << "," << record.to << "," << record.verdict
+        << "\n";
+  });
+  out.flush();
+  return (read && out) ? 0 : 1;
+}
@@ -0,0 +1,570 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "ltlmonbank.hpp"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(atomic<int32_t>) == sizeof(int32_t) &&
+                  atomic<int32_t>::is_always_lock_free,
+              "monitor states must be stepped as plain int32_t lanes");
+
+LTLMonitorBank::LTLMonitorBank()
+    : profiling(false), actionWords(0), stateCapacity(0), dirty(false) {}
+
+bool LTLMonitorBank::add(LTLMonitor &&monitor) {
+  const MonitorAutomaton &automaton = monitor.getAutomaton();
+  size_t totalStates = 1;
+  for (const auto &m : monitors) {
+    totalStates += m.getAutomaton().getStateCount();
+  }
+  IndexT base = totalStates;
+  totalStates += automaton.getStateCount();
+
+  size_t newActions = 0;
+  for (ActionId a = 0; a < automaton.getActionCount(); ++a) {
+    if (actionMap.find(automaton.getActionName(a)) == actionMap.end()) {
+      ++newActions;
+    }
+  }
+  size_t totalActions = actionNames.size() + newActions;
+  if (totalStates * max<size_t>(totalActions, 1) >
+      static_cast<size_t>(numeric_limits<int32_t>::max())) {
+    cerr << "LTLMonitorBank: too many states to add monitor for "
+         << monitor.getProperty() << endl;
+    return false;
+  }
+
+  for (ActionId a = 0; a < automaton.getActionCount(); ++a) {
+    const string &name = automaton.getActionName(a);
+    if (actionMap.find(name) == actionMap.end()) {
+      actionMap[name] = actionNames.size();
+      actionNames.push_back(name);
+    }
+  }
+
+  stateBase.push_back(base);
+  size_t count = monitors.size() + 1;
+  size_t padded = (count + LANES - 1) / LANES * LANES;
+  if (padded > stateCapacity) {
+    size_t capacity = max(padded, 2 * stateCapacity);
+    auto grown = make_unique<atomic<int32_t>[]>(capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+      grown[i].store((i < stateCapacity) ? states[i].load() : 0);
+    }
+    states = std::move(grown);
+    stateCapacity = capacity;
+  }
+  states[count - 1].store(base + automaton.getInitialState());
+  violated.assign((count + 63) / 64, 0);
+  stuck.resize(violated.size(), 0);
+  monitors.push_back(std::move(monitor));
+  setStuck(count - 1, monitors.back().getAutomaton().getInitialState());
+  if (profiling) {
+    monitors.back().enableProfiling();
+  }
+  dirty.store(true);
+  return true;
+}
+
+bool LTLMonitorBank::load(std::string path) {
+  const string IMAGE_SUFFIX(".monb");
+  LTLMonitor monitor;
+  bool isImage = path.size() >= IMAGE_SUFFIX.size() &&
+                 path.compare(path.size() - IMAGE_SUFFIX.size(),
+                              IMAGE_SUFFIX.size(), IMAGE_SUFFIX) == 0;
+  bool loaded = (isImage) ? monitor.mapImage(path) : monitor.initialize(path);
+  return loaded && add(std::move(monitor));
+}
+
+/*
+ * Rebuilds the combined table. Appending monitors does not change the global
+ * indices of existing states, so the current states remain valid.
+ */
+void LTLMonitorBank::build() {
+  const size_t actionCount = actionNames.size();
+  size_t totalStates = 1;
+  for (const auto &m : monitors) {
+    totalStates += m.getAutomaton().getStateCount();
+  }
+  table.assign(totalStates * actionCount, 0);
+  localActions.clear();
+  actionWords = (actionCount + 63) / 64;
+  knownActions.assign(monitors.size() * actionWords, 0);
+  vector<vector<uint32_t>> knownBy(actionCount);
+
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    const MonitorAutomaton &monitor = monitors[i].getAutomaton();
+    const IndexT base = stateBase[i];
+
+    vector<ActionId> localAction(actionCount);
+    for (size_t a = 0; a < actionCount; ++a) {
+      localAction[a] = monitor.internAction(actionNames[a]);
+    }
+    if (profiling) {
+      localActions.insert(localActions.end(), localAction.begin(),
+                          localAction.end());
+    }
+    for (size_t a = 0; a < actionCount; ++a) {
+      if (localAction[a] != MonitorAutomaton::UNKNOWN_ACTION) {
+        knownBy[a].push_back(i);
+        knownActions[i * actionWords + a / 64] |= uint64_t(1) << (a % 64);
+      }
+    }
+
+    for (IndexT s = 0; s < monitor.getStateCount(); ++s) {
+      int32_t *row = &table[static_cast<size_t>(base + s) * actionCount];
+      State::StateType type = monitor.getStateType(s);
+      for (size_t a = 0; a < actionCount; ++a) {
+        if (type == State::VIOLATION) {
+          row[a] = VIOLATED;
+        } else if (type == State::ACCEPT ||
+                   localAction[a] == MonitorAutomaton::UNKNOWN_ACTION) {
+          row[a] = base + s;
+        } else {
+          IndexT next = monitor.getTransition(s, localAction[a]);
+          bool violates = next == MonitorAutomaton::INVALID ||
+                          monitor.getStateType(next) == State::VIOLATION;
+          row[a] = (violates) ? VIOLATED : base + next;
+        }
+      }
+    }
+  }
+
+  actionOffsets.assign(1, 0);
+  actionMonitors.clear();
+  for (const auto &list : knownBy) {
+    actionMonitors.insert(actionMonitors.end(), list.begin(), list.end());
+    actionOffsets.push_back(actionMonitors.size());
+  }
+  dirty.store(false, memory_order_release);
+}
+
+void LTLMonitorBank::ensureBuilt() {
+  if (dirty.load(memory_order_acquire)) {
+    lock_guard<mutex> lock(buildMutex);
+    if (dirty.load(memory_order_relaxed)) {
+      build();
+    }
+  }
+}
+
+LTLMonitorBank::ActionId
+LTLMonitorBank::internAction(std::string_view action) const {
+  auto action_it = actionMap.find(action);
+  if (action_it == actionMap.end()) {
+    return LTLMonitor::UNKNOWN_ACTION;
+  }
+  return action_it->second;
+}
+
+size_t LTLMonitorBank::getActionCount() const { return actionNames.size(); }
+
+const string &LTLMonitorBank::getActionName(ActionId action) const {
+  return actionNames[action];
+}
+
+const LTLMonitorBank::MaskT &LTLMonitorBank::step(ActionId action) {
+  ensureBuilt();
+  copy(stuck.begin(), stuck.end(), violated.begin());
+  const int32_t actionCount = actionNames.size();
+  if (action < 0 || action >= actionCount) {
+    recordUnknown("");
+    return violated;
+  }
+
+  const int32_t *transitions = table.data();
+  if (profiling) {
+    for (size_t i = 0; i < monitors.size(); ++i) {
+      int32_t current = states[i].load(memory_order_relaxed);
+      int32_t next =
+          transitions[static_cast<size_t>(current) * actionCount + action];
+      record(i, current, next, action);
+      if (next == VIOLATED) {
+        violated[i / 64] |= uint64_t(1) << (i % 64);
+      } else {
+        states[i].store(next, memory_order_relaxed);
+      }
+    }
+    return violated;
+  }
+  const uint32_t *first = actionMonitors.data() + actionOffsets[action];
+  const uint32_t *last = actionMonitors.data() + actionOffsets[action + 1];
+  if (static_cast<size_t>(last - first) * 2 < monitors.size()) {
+    for (const uint32_t *it = first; it != last; ++it) {
+      int32_t current = states[*it].load(memory_order_relaxed);
+      int32_t next =
+          transitions[static_cast<size_t>(current) * actionCount + action];
+      if (next == VIOLATED) {
+        violated[*it / 64] |= uint64_t(1) << (*it % 64);
+      } else {
+        states[*it].store(next, memory_order_relaxed);
+      }
+    }
+    return violated;
+  }
+#ifdef __AVX2__
+  const __m256i actionVec = _mm256_set1_epi32(action);
+  const __m256i countVec = _mm256_set1_epi32(actionCount);
+  const size_t padded = (monitors.size() + LANES - 1) / LANES * LANES;
+  for (size_t i = 0; i < padded; i += LANES) {
+    auto lane = reinterpret_cast<__m256i *>(&states[i]);
+    __m256i current = _mm256_loadu_si256(lane);
+    __m256i index =
+        _mm256_add_epi32(_mm256_mullo_epi32(current, countVec), actionVec);
+    __m256 next = _mm256_castsi256_ps(
+        _mm256_i32gather_epi32(transitions, index, sizeof(int32_t)));
+    // VIOLATED entries have the sign bit set: keep the current state there
+    __m256 updated = _mm256_blendv_ps(next, _mm256_castsi256_ps(current), next);
+    _mm256_storeu_si256(lane, _mm256_castps_si256(updated));
+    uint64_t bits = static_cast<unsigned>(_mm256_movemask_ps(next));
+    violated[i / 64] |= bits << (i % 64);
+  }
+#else
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    int32_t current = states[i].load(memory_order_relaxed);
+    int32_t next =
+        transitions[static_cast<size_t>(current) * actionCount + action];
+    if (next == VIOLATED) {
+      violated[i / 64] |= uint64_t(1) << (i % 64);
+    } else {
+      states[i].store(next, memory_order_relaxed);
+    }
+  }
+#endif
+  return violated;
+}
+
+void LTLMonitorBank::stepConcurrent(ActionId action, MaskT &violated,
+                                    vector<Transition> *transitions) {
+  ensureBuilt();
+  violated = stuck;
+  const int32_t actionCount = actionNames.size();
+  if (action < 0 || action >= actionCount) {
+    recordUnknown("");
+    return;
+  }
+
+  const int32_t *entries = table.data();
+  auto stepMonitor = [&](size_t i) {
+    int32_t current = states[i].load(memory_order_acquire);
+    while (true) {
+      int32_t next =
+          entries[static_cast<size_t>(current) * actionCount + action];
+      if (next == VIOLATED) {
+        violated[i / 64] |= uint64_t(1) << (i % 64);
+      }
+      if (next == VIOLATED || next == current ||
+          states[i].compare_exchange_weak(current, next, memory_order_acq_rel,
+                                          memory_order_acquire)) {
+        if (profiling) {
+          record(i, current, next, action);
+        }
+        if (transitions != nullptr && (!profiling || knows(i, action))) {
+          bool violation = (next == VIOLATED);
+          transitions->push_back(Transition{
+              0, static_cast<uint32_t>(i), current - stateBase[i],
+              (violation ? current : next) - stateBase[i], violation});
+        }
+        return;
+      }
+    }
+  };
+  if (profiling) {
+    // Every monitor is stepped, so that the others count the action as
+    // unknown
+    for (size_t i = 0; i < monitors.size(); ++i) {
+      stepMonitor(i);
+    }
+    return;
+  }
+  for (uint32_t i = actionOffsets[action]; i < actionOffsets[action + 1];
+       ++i) {
+    stepMonitor(actionMonitors[i]);
+  }
+}
+
+void LTLMonitorBank::stepConcurrent(std::string_view action,
+                                    MaskT &violated,
+                                    vector<Transition> *transitions) {
+  ActionId id = internAction(action);
+  if (id == LTLMonitor::UNKNOWN_ACTION) {
+    violated = stuck;
+    recordUnknown(action);
+    return;
+  }
+  stepConcurrent(id, violated, transitions);
+}
+
+void LTLMonitorBank::stepBatchConcurrent(const ActionId *actions,
+                                         size_t count, MaskT &violated,
+                                         vector<Transition> *transitions) {
+  ensureBuilt();
+  const size_t words = maskWords();
+  violated.assign(count * words, 0);
+  if (profiling) {
+    MaskT single;
+    for (size_t e = 0; e < count; ++e) {
+      size_t first = transitions ? transitions->size() : 0;
+      stepConcurrent(actions[e], single, transitions);
+      copy(single.begin(), single.end(), violated.begin() + e * words);
+      for (size_t t = first; transitions && t < transitions->size(); ++t) {
+        (*transitions)[t].event = e;
+      }
+    }
+    return;
+  }
+
+  const int32_t actionCount = actionNames.size();
+  const int32_t *entries = table.data();
+  vector<uint64_t> batchActions(actionWords, 0);
+  for (size_t e = 0; e < count; ++e) {
+    if (actions[e] >= 0 && actions[e] < actionCount) {
+      batchActions[actions[e] / 64] |= uint64_t(1) << (actions[e] % 64);
+    }
+  }
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    const size_t word = i / 64;
+    const uint64_t bit = uint64_t(1) << (i % 64);
+    const uint64_t *known = &knownActions[i * actionWords];
+    bool relevant = false;
+    for (size_t w = 0; w < actionWords && !relevant; ++w) {
+      relevant = (known[w] & batchActions[w]) != 0;
+    }
+    if (!relevant) {
+      for (size_t e = 0; e < count; ++e) {
+        violated[e * words + word] |= stuck[word] & bit;
+      }
+      continue;
+    }
+    const size_t recorded = transitions ? transitions->size() : 0;
+    int32_t start = states[i].load(memory_order_acquire);
+    while (true) {
+      int32_t current = start;
+      for (size_t e = 0; e < count; ++e) {
+        ActionId action = actions[e];
+        if (action < 0 || action >= actionCount) {
+          violated[e * words + word] |= stuck[word] & bit;
+          continue;
+        }
+        int32_t next =
+            entries[static_cast<size_t>(current) * actionCount + action];
+        if (transitions != nullptr && knows(i, action)) {
+          IndexT from = current - stateBase[i];
+          IndexT to = (next == VIOLATED ? current : next) - stateBase[i];
+          transitions->push_back(Transition{static_cast<uint32_t>(e),
+                                            static_cast<uint32_t>(i), from,
+                                            to, next == VIOLATED});
+        }
+        if (next == VIOLATED) {
+          violated[e * words + word] |= bit;
+        } else {
+          current = next;
+        }
+      }
+      if (current == start ||
+          states[i].compare_exchange_weak(start, current, memory_order_acq_rel,
+                                          memory_order_acquire)) {
+        break;
+      }
+      // Another thread moved the monitor: step the batch again from there
+      for (size_t e = 0; e < count; ++e) {
+        violated[e * words + word] &= ~bit;
+      }
+      if (transitions != nullptr) {
+        transitions->resize(recorded);
+      }
+    }
+  }
+}
+
+void LTLMonitorBank::stepBatchConcurrent(const vector<string_view> &actions,
+                                         MaskT &violated,
+                                         vector<Transition> *transitions) {
+  if (profiling) {
+    // Steps by name, so that unknown actions are counted with their names
+    const size_t words = maskWords();
+    violated.assign(actions.size() * words, 0);
+    MaskT single;
+    for (size_t e = 0; e < actions.size(); ++e) {
+      size_t first = transitions ? transitions->size() : 0;
+      stepConcurrent(actions[e], single, transitions);
+      copy(single.begin(), single.end(), violated.begin() + e * words);
+      for (size_t t = first; transitions && t < transitions->size(); ++t) {
+        (*transitions)[t].event = e;
+      }
+    }
+    return;
+  }
+  vector<ActionId> ids;
+  ids.reserve(actions.size());
+  for (auto action : actions) {
+    ids.push_back(internAction(action));
+  }
+  stepBatchConcurrent(ids.data(), ids.size(), violated, transitions);
+}
+
+size_t LTLMonitorBank::maskWords() const { return (monitors.size() + 63) / 64; }
+
+void LTLMonitorBank::record(size_t index, int32_t from, int32_t to,
+                            ActionId action) {
+  MonitorProfile *profile = monitors[index].getProfile();
+  ActionId local = localActions[index * actionNames.size() + action];
+  if (local == LTLMonitor::UNKNOWN_ACTION) {
+    profile->recordUnknown(actionNames[action]);
+    return;
+  }
+  IndexT localFrom = from - stateBase[index];
+  profile->recordTransition(localFrom, local);
+  if (to != VIOLATED && to != from) {
+    profile->recordStateChange(localFrom, to - stateBase[index]);
+  }
+}
+
+/*
+ * Counts an action that is not in the shared alphabet for every monitor
+ */
+void LTLMonitorBank::recordUnknown(std::string_view action) {
+  if (!profiling) {
+    return;
+  }
+  for (auto &monitor : monitors) {
+    monitor.getProfile()->recordUnknown(action);
+  }
+}
+
+const LTLMonitorBank::MaskT &LTLMonitorBank::step(std::string_view action) {
+  ActionId id = internAction(action);
+  if (id == LTLMonitor::UNKNOWN_ACTION) {
+    copy(stuck.begin(), stuck.end(), violated.begin());
+    recordUnknown(action);
+    return violated;
+  }
+  return step(id);
+}
+
+void LTLMonitorBank::enableProfiling() {
+  for (auto &monitor : monitors) {
+    monitor.enableProfiling();
+  }
+  profiling = true;
+  dirty.store(true);
+}
+
+bool LTLMonitorBank::writeProfile(const std::string &path) const {
+  if (!profiling) {
+    cerr << "LTLMonitorBank: profiling is not enabled" << endl;
+    return false;
+  }
+  vector<const MonitorProfile *> profiles;
+  for (const auto &monitor : monitors) {
+    profiles.push_back(monitor.getProfile());
+  }
+  return writeProfiles(path, profiles);
+}
+
+bool LTLMonitorBank::anyViolated(const MaskT &mask) {
+  return any_of(mask.begin(), mask.end(), [](uint64_t bits) { return bits; });
+}
+
+bool LTLMonitorBank::isViolated(const MaskT &mask, size_t index) {
+  return (mask[index / 64] >> (index % 64)) & 1;
+}
+
+void LTLMonitorBank::reset() {
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    moveTo(i, monitors[i].getAutomaton().getInitialState());
+  }
+}
+
+void LTLMonitorBank::moveTo(size_t index, IndexT state) {
+  int32_t previous = states[index].exchange(stateBase[index] + state);
+  setStuck(index, state);
+  if (profiling) {
+    monitors[index].getProfile()->recordStateChange(
+        previous - stateBase[index], state);
+  }
+}
+
+void LTLMonitorBank::setStuck(size_t index, IndexT state) {
+  const uint64_t bit = uint64_t(1) << (index % 64);
+  if (monitors[index].getAutomaton().getStateType(state) == State::VIOLATION) {
+    stuck[index / 64] |= bit;
+  } else {
+    stuck[index / 64] &= ~bit;
+  }
+}
+
+bool LTLMonitorBank::knows(size_t index, ActionId action) const {
+  return (knownActions[index * actionWords + action / 64] >> (action % 64)) &
+         1;
+}
+
+std::vector<MonitorSnapshot> LTLMonitorBank::snapshot() const {
+  vector<MonitorSnapshot> snapshots;
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    snapshots.push_back(MonitorSnapshot{
+        monitors[i].getAutomaton().getFingerprint(), getState(i)});
+  }
+  return snapshots;
+}
+
+size_t
+LTLMonitorBank::restore(const std::vector<MonitorSnapshot> &snapshots) {
+  vector<bool> used(snapshots.size(), false);
+  size_t restored = 0;
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    const MonitorAutomaton &automaton = monitors[i].getAutomaton();
+    for (size_t s = 0; s < snapshots.size(); ++s) {
+      if (!used[s] && snapshots[s].fingerprint == automaton.getFingerprint() &&
+          snapshots[s].state >= 0 &&
+          snapshots[s].state < automaton.getStateCount()) {
+        used[s] = true;
+        moveTo(i, snapshots[s].state);
+        ++restored;
+        break;
+      }
+    }
+  }
+  return restored;
+}
+
+size_t LTLMonitorBank::size() const { return monitors.size(); }
+
+const LTLMonitor &LTLMonitorBank::getMonitor(size_t index) const {
+  return monitors[index];
+}
+
+LTLMonitorBank::IndexT LTLMonitorBank::getState(size_t index) const {
+  return states[index].load(memory_order_acquire) - stateBase[index];
+}
@@ -0,0 +1,234 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef LTLMONBANK_HPP_H
+#define LTLMONBANK_HPP_H
+
+#include "ltlmonrt.hpp"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Set of monitors that are stepped together with the same events. The
+ * monitors share one interned action alphabet, their current states are kept
+ * in one contiguous array, and an event advances them in a single pass over
+ * a combined transition table. An inverted index from each action to the
+ * monitors whose alphabet has it limits that pass to the monitors that know
+ * the action, unless most of them do (then all monitors are stepped, using
+ * AVX2 gathers when built with LTLMONRT_AVX2).
+ *
+ * Each monitor behaves as if LTLMonitor::step() was called on it: actions
+ * that are not in its alphabet are ignored, and a violating or invalid action
+ * is reported without changing its state.
+ */
+class LTLMonitorBank {
+public:
+  using IndexT = LTLMonitor::IndexT;
+  using ActionId = LTLMonitor::ActionId;
+
+  /*
+   * One bit per monitor, in the order they were added
+   */
+  using MaskT = std::vector<std::uint64_t>;
+
+  /*
+   * A monitor stepped by event number event of a concurrent step, with its
+   * states before and after it. A violating event leaves to equal to from.
+   */
+  struct Transition {
+    std::uint32_t event;
+    std::uint32_t monitor;
+    IndexT from;
+    IndexT to;
+    bool violated;
+  };
+
+  LTLMonitorBank();
+  LTLMonitorBank(const LTLMonitorBank &) = delete;
+  LTLMonitorBank &operator=(const LTLMonitorBank &) = delete;
+
+  /*
+   * Adds a monitor, which starts at its initial state. Its index in the
+   * violation mask is size() - 1 after this call. Fails if the combined table
+   * would not be addressable with 32-bit indices.
+   */
+  bool add(LTLMonitor &&monitor);
+
+  /*
+   * Loads a monitor from a .mon file, or maps it if the path ends in .monb
+   */
+  bool load(std::string path);
+
+  ActionId internAction(std::string_view action) const;
+  size_t getActionCount() const;
+  const std::string &getActionName(ActionId action) const;
+
+  /*
+   * Advances all monitors and returns the mask of those that the action
+   * violates
+   */
+  const MaskT &step(ActionId action);
+  const MaskT &step(std::string_view action);
+
+  /*
+   * Same as step(), but can be called from several threads at once (though
+   * not concurrently with add() or reset()). Each monitor's state advances by
+   * compare-and-swap, and the violations are written to the caller's mask.
+   * Every monitor sees concurrent actions in some order, but not necessarily
+   * the same order as the other monitors. If transitions is given, the
+   * monitors that know the action are appended to it.
+   */
+  void stepConcurrent(ActionId action, MaskT &violated,
+                      std::vector<Transition> *transitions = nullptr);
+  void stepConcurrent(std::string_view action, MaskT &violated,
+                      std::vector<Transition> *transitions = nullptr);
+
+  /*
+   * Same as calling stepConcurrent() for each action in turn, but each
+   * monitor goes through the whole batch in one pass and its state is
+   * updated with a single compare-and-swap, so other threads see either none
+   * or all of the batch. violated receives one mask of maskWords() words per
+   * action, one after the other. Actions are stepped one at a time while
+   * profiling. transitions receives those of each action, in order for each
+   * monitor.
+   */
+  void stepBatchConcurrent(const ActionId *actions, size_t count,
+                           MaskT &violated,
+                           std::vector<Transition> *transitions = nullptr);
+  void stepBatchConcurrent(const std::vector<std::string_view> &actions,
+                           MaskT &violated,
+                           std::vector<Transition> *transitions = nullptr);
+
+  size_t maskWords() const;
+
+  static bool anyViolated(const MaskT &mask);
+  static bool isViolated(const MaskT &mask, size_t index);
+
+  void reset();
+
+  /*
+   * Snapshots of all monitors, in the order they were added
+   */
+  std::vector<MonitorSnapshot> snapshot() const;
+
+  /*
+   * Restores each monitor from the first unused snapshot of the same
+   * automaton, so the set of monitors may differ from when the snapshots were
+   * taken. Returns the number of monitors restored.
+   */
+  size_t restore(const std::vector<MonitorSnapshot> &snapshots);
+
+  /*
+   * Profiles every monitor of the bank, as LTLMonitor::enableProfiling()
+   * does. Actions that a monitor does not know are counted as unknown for
+   * it. Stepping is no longer vectorized while profiling. Must not be called
+   * while the bank is being stepped.
+   */
+  void enableProfiling();
+
+  /*
+   * Writes the profiles of all monitors with writeProfiles()
+   */
+  bool writeProfile(const std::string &path) const;
+
+  size_t size() const;
+  const LTLMonitor &getMonitor(size_t index) const;
+  IndexT getState(size_t index) const;
+
+private:
+  /*
+   * Marks a transition of the combined table that violates the property;
+   * the monitor stays in its current state.
+   */
+  static constexpr std::int32_t VIOLATED = -1;
+  static constexpr size_t LANES = 8;
+
+  using IndexMapT = std::map<std::string, ActionId, std::less<>>;
+
+  std::vector<LTLMonitor> monitors;
+  IndexMapT actionMap;
+  std::vector<std::string> actionNames;
+
+  /*
+   * Combined table, row-major by global state with one column per action in
+   * the shared alphabet. Global state 0 is a sink used for padding lanes;
+   * stateBase holds the global index of state 0 of each monitor.
+   */
+  std::vector<IndexT> stateBase;
+  std::vector<std::int32_t> table;
+
+  /*
+   * Local id of each action of the shared alphabet in each monitor, row-major
+   * by monitor; only kept while profiling
+   */
+  std::vector<ActionId> localActions;
+  bool profiling;
+
+  /*
+   * Inverted index of the shared alphabet: the monitors whose alphabet has
+   * action a are actionMonitors[actionOffsets[a]] up to
+   * actionMonitors[actionOffsets[a + 1]]. knownActions holds the same
+   * relation as a bitset of actionWords words per monitor, for batches.
+   */
+  std::vector<std::uint32_t> actionOffsets;
+  std::vector<std::uint32_t> actionMonitors;
+  std::vector<std::uint64_t> knownActions;
+  size_t actionWords;
+
+  /*
+   * Monitors whose current state is a violation, which only restore() or a
+   * violating initial state can cause. As with LTLMonitor::step(), they
+   * report every action as a violation, even one they don't know.
+   */
+  MaskT stuck;
+
+  /*
+   * Global current state of each monitor, padded with the sink state to a
+   * multiple of LANES
+   */
+  std::unique_ptr<std::atomic<std::int32_t>[]> states;
+  size_t stateCapacity;
+  MaskT violated;
+  std::atomic<bool> dirty;
+  std::mutex buildMutex;
+
+  void build();
+  void ensureBuilt();
+  void record(size_t index, std::int32_t from, std::int32_t to,
+              ActionId action);
+  void recordUnknown(std::string_view action);
+  void moveTo(size_t index, IndexT state);
+  void setStuck(size_t index, IndexT state);
+  bool knows(size_t index, ActionId action) const;
+};
+
+#endif
@@ -0,0 +1,494 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+/*
+ * Checks recorded event traces against one or more monitors, in parallel.
+ *
+ * Usage: ltlmon-check [-j <threads>] -p <monitor> [-p <monitor>...] <trace>...
+ *
+ * Monitors are .mon files, which are minimized after loading, or binary
+ * images if they end in .monb. Each line of a trace file is
+ * "<mission>,<action>"; further fields are ignored, as are empty lines and
+ * lines starting with '#'. The events of each mission, in the order of the
+ * trace files and lines, form one trace that is checked against every
+ * monitor. The verdicts are printed as CSV, one line per trace and monitor.
+ * The throughput of the checks alone and end to end, including parsing, is
+ * printed to stderr. The exit status is 2 if any trace violates a property.
+ */
+
+#include "ltlmonimage.hpp"
+#include "ltlmonrt.hpp"
+#include "workpool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+using ActionId = MonitorAutomaton::ActionId;
+
+/*
+ * A trace file mapped read-only; mission and action names are views into it
+ */
+struct TraceFile {
+  string path;
+  shared_ptr<const void> mapping;
+  const char *data = nullptr;
+  size_t size = 0;
+};
+
+/*
+ * Interns names with open addressing; ids are assigned in order of first use
+ */
+class NameTable {
+public:
+  NameTable() : slots(64, EMPTY) {}
+
+  uint32_t intern(string_view name) {
+    size_t mask = slots.size() - 1;
+    auto bytes = reinterpret_cast<const unsigned char *>(name.data());
+    size_t i = fnv1a(FNV1A_BASIS, bytes, name.size()) & mask;
+    for (; slots[i] != EMPTY; i = (i + 1) & mask) {
+      if (names[slots[i]] == name) {
+        return slots[i];
+      }
+    }
+    uint32_t id = names.size();
+    slots[i] = id;
+    names.push_back(name);
+    if (names.size() * 2 > slots.size()) {
+      rehash();
+    }
+    return id;
+  }
+
+  const vector<string_view> &getNames() const { return names; }
+
+private:
+  static constexpr uint32_t EMPTY = ~uint32_t(0);
+  vector<uint32_t> slots;
+  vector<string_view> names;
+
+  void rehash() {
+    vector<string_view> old;
+    old.swap(names);
+    slots.assign(slots.size() * 2, EMPTY);
+    for (auto name : old) {
+      intern(name);
+    }
+  }
+};
+
+/*
+ * A range of lines of a trace file, parsed into (mission, action) pairs with
+ * names interned locally, so chunks can be parsed independently
+ */
+struct Chunk {
+  const char *begin;
+  const char *end;
+  NameTable missions;
+  NameTable actions;
+  vector<uint32_t> eventMissions;
+  vector<uint32_t> eventActions;
+  vector<size_t> missionEvents;
+  size_t malformed = 0;
+
+  // Set by mergeChunks(): global ids and where each mission's events go
+  vector<uint32_t> traceIds;
+  vector<uint32_t> actionIds;
+  vector<size_t> traceOffsets;
+};
+
+struct Trace {
+  string_view mission;
+  vector<uint32_t> events;
+};
+
+struct Property {
+  string path;
+  shared_ptr<const MonitorAutomaton> automaton;
+  vector<ActionId> actionIds;
+};
+
+struct Verdict {
+  size_t violation = MonitorAutomaton::NO_VIOLATION;
+  State::StateType type = State::INCONCLUSIVE;
+};
+
+static const size_t MIN_CHUNK_BYTES = 1 << 20;
+static const size_t BLOCK_EVENTS = 4096;
+
+static bool mapTrace(TraceFile &file) {
+  int fd = open(file.path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cerr << "ltlmon-check: couldn't open " << file.path << endl;
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    cerr << "ltlmon-check: couldn't stat " << file.path << endl;
+    ::close(fd);
+    return false;
+  }
+  file.size = fileStat.st_size;
+  if (file.size == 0) {
+    ::close(fd);
+    return true;
+  }
+  void *data = mmap(nullptr, file.size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    cerr << "ltlmon-check: couldn't map " << file.path << endl;
+    return false;
+  }
+  size_t size = file.size;
+  madvise(data, size, MADV_SEQUENTIAL);
+  file.mapping = shared_ptr<const void>(data, [size](const void *p) {
+    munmap(const_cast<void *>(p), size);
+  });
+  file.data = static_cast<const char *>(data);
+  return true;
+}
+
+/*
+ * Splits a trace file into chunks of about chunkBytes, ending at line breaks
+ */
+static void splitTrace(const TraceFile &file, size_t chunkBytes,
+                       vector<Chunk> &chunks) {
+  const char *begin = file.data;
+  const char *end = file.data + file.size;
+  while (begin < end) {
+    const char *cut = begin + min(chunkBytes, size_t(end - begin));
+    if (cut < end) {
+      auto eol = static_cast<const char *>(memchr(cut, '\n', end - cut));
+      cut = (eol == nullptr) ? end : eol + 1;
+    }
+    chunks.emplace_back();
+    chunks.back().begin = begin;
+    chunks.back().end = cut;
+    begin = cut;
+  }
+}
+
+static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static string_view trim(string_view text) {
+  while (!text.empty() && isSpace(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && isSpace(text.back())) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+static void parseChunk(Chunk &chunk) {
+  string_view lastMission;
+  uint32_t lastMissionId = 0;
+  const char *line = chunk.begin;
+  while (line < chunk.end) {
+    auto eol = static_cast<const char *>(memchr(line, '\n', chunk.end - line));
+    if (eol == nullptr) {
+      eol = chunk.end;
+    }
+    string_view text(line, eol - line);
+    line = eol + 1;
+
+    text = trim(text);
+    if (text.empty() || text[0] == '#') {
+      continue;
+    }
+    size_t comma = text.find(',');
+    if (comma == string_view::npos) {
+      ++chunk.malformed;
+      continue;
+    }
+    string_view mission = trim(text.substr(0, comma));
+    string_view action = text.substr(comma + 1);
+    action = trim(action.substr(0, action.find(',')));
+    if (mission.empty() || action.empty()) {
+      ++chunk.malformed;
+      continue;
+    }
+
+    // Recorders usually write runs of events of the same mission
+    if (mission != lastMission) {
+      lastMission = mission;
+      lastMissionId = chunk.missions.intern(mission);
+      if (lastMissionId == chunk.missionEvents.size()) {
+        chunk.missionEvents.push_back(0);
+      }
+    }
+    ++chunk.missionEvents[lastMissionId];
+    chunk.eventMissions.push_back(lastMissionId);
+    chunk.eventActions.push_back(chunk.actions.intern(action));
+  }
+}
+
+/*
+ * Interns the mission and action names of the chunks globally, sizes the
+ * trace of each mission, and assigns each chunk its range in those traces so
+ * that events stay in file order
+ */
+static void mergeChunks(vector<Chunk> &chunks, vector<Trace> &traces,
+                        NameTable &actions) {
+  NameTable missions;
+  vector<size_t> traceSizes;
+  for (auto &chunk : chunks) {
+    for (auto action : chunk.actions.getNames()) {
+      chunk.actionIds.push_back(actions.intern(action));
+    }
+    const auto &names = chunk.missions.getNames();
+    for (size_t m = 0; m < names.size(); ++m) {
+      uint32_t traceId = missions.intern(names[m]);
+      if (traceId == traceSizes.size()) {
+        traceSizes.push_back(0);
+      }
+      chunk.traceIds.push_back(traceId);
+      chunk.traceOffsets.push_back(traceSizes[traceId]);
+      traceSizes[traceId] += chunk.missionEvents[m];
+    }
+  }
+  const auto &names = missions.getNames();
+  traces.resize(names.size());
+  for (size_t t = 0; t < traces.size(); ++t) {
+    traces[t].mission = names[t];
+    traces[t].events.resize(traceSizes[t]);
+  }
+}
+
+/*
+ * Copies the events of a merged chunk into its range of each trace
+ */
+static void scatterChunk(Chunk &chunk, vector<Trace> &traces) {
+  for (size_t e = 0; e < chunk.eventMissions.size(); ++e) {
+    uint32_t m = chunk.eventMissions[e];
+    traces[chunk.traceIds[m]].events[chunk.traceOffsets[m]++] =
+        chunk.actionIds[chunk.eventActions[e]];
+  }
+}
+
+/*
+ * Steps a new instance through the trace in blocks, so that translation to
+ * the monitor's actions stops with the first violation or absorbing state
+ */
+static Verdict checkTrace(const Trace &trace, const Property &property) {
+  thread_local vector<ActionId> block;
+  const MonitorAutomaton &automaton = *property.automaton;
+  MonitorInstance instance = automaton.newInstance();
+  Verdict verdict;
+  for (size_t first = 0; first < trace.events.size(); first += BLOCK_EVENTS) {
+    size_t count = min(BLOCK_EVENTS, trace.events.size() - first);
+    block.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      block[i] = property.actionIds[trace.events[first + i]];
+    }
+    size_t violation = automaton.stepBatch(instance, block.data(), count);
+    if (violation != MonitorAutomaton::NO_VIOLATION) {
+      verdict.violation = first + violation;
+      verdict.type = State::VIOLATION;
+      return verdict;
+    }
+    if (automaton.getStateType(instance.state) == State::ACCEPT) {
+      break;
+    }
+  }
+  verdict.type = automaton.getStateType(instance.state);
+  return verdict;
+}
+
+static bool loadProperty(Property &property) {
+  const string IMAGE_SUFFIX(".monb");
+  const string &path = property.path;
+  auto automaton = make_shared<MonitorAutomaton>();
+  property.automaton = automaton;
+  bool isImage = path.size() >= IMAGE_SUFFIX.size() &&
+                 path.compare(path.size() - IMAGE_SUFFIX.size(),
+                              IMAGE_SUFFIX.size(), IMAGE_SUFFIX) == 0;
+  if (isImage ? !automaton->mapImage(path) : !automaton->initialize(path)) {
+    return false;
+  }
+  // Trace lines have no timestamps to check time bounds with
+  if (!automaton->getClockConstraints().empty()) {
+    cerr << "ltlmon-check: " << path
+         << " has time bounds, which can't be checked on traces" << endl;
+    return false;
+  }
+  if (isImage) {
+    return true;
+  }
+  auto stats = automaton->minimize();
+  cerr << "ltlmon-check: " << path << ": " << stats.statesBefore << " -> "
+       << stats.statesAfter << " states, " << stats.tableBytesBefore << " -> "
+       << stats.tableBytesAfter << " table bytes after minimization" << endl;
+  return true;
+}
+
+static void usage(const char *program) {
+  cerr << "usage: " << program
+       << " [-j <threads>] -p <monitor> [-p <monitor>...] <trace>..." << endl;
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = 0;
+  vector<Property> properties;
+  vector<TraceFile> files;
+  for (int i = 1; i < argc; ++i) {
+    string arg(argv[i]);
+    if ((arg == "-j" || arg == "-p") && i + 1 == argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (arg == "-j") {
+      threads = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "-p") {
+      properties.emplace_back();
+      properties.back().path = argv[++i];
+    } else {
+      files.emplace_back();
+      files.back().path = arg;
+    }
+  }
+  if (properties.empty() || files.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  for (auto &property : properties) {
+    if (!loadProperty(property)) {
+      cerr << "ltlmon-check: could not load monitor from " << property.path
+           << endl;
+      return 1;
+    }
+  }
+
+  auto start = chrono::steady_clock::now();
+  WorkStealingPool pool(threads);
+  size_t totalBytes = 0;
+  for (auto &file : files) {
+    if (!mapTrace(file)) {
+      return 1;
+    }
+    totalBytes += file.size;
+  }
+
+  // Parse chunks of all files in parallel, then group events by mission
+  size_t chunkBytes = max(MIN_CHUNK_BYTES, totalBytes / (pool.size() * 4));
+  vector<Chunk> chunks;
+  for (const auto &file : files) {
+    splitTrace(file, chunkBytes, chunks);
+  }
+  for (auto &chunk : chunks) {
+    pool.submit([&chunk] { parseChunk(chunk); });
+  }
+  pool.wait();
+
+  vector<Trace> traces;
+  NameTable actionTable;
+  mergeChunks(chunks, traces, actionTable);
+  for (auto &chunk : chunks) {
+    pool.submit([&chunk, &traces] { scatterChunk(chunk, traces); });
+  }
+  pool.wait();
+  const auto &actions = actionTable.getNames();
+  size_t malformed = 0;
+  for (const auto &chunk : chunks) {
+    malformed += chunk.malformed;
+  }
+  chunks.clear();
+  chunks.shrink_to_fit();
+
+  for (auto &property : properties) {
+    for (auto action : actions) {
+      property.actionIds.push_back(property.automaton->internAction(action));
+    }
+  }
+  auto parsed = chrono::steady_clock::now();
+
+  // Check each trace against every property, longest traces first
+  vector<uint32_t> order(traces.size());
+  for (size_t t = 0; t < order.size(); ++t) {
+    order[t] = t;
+  }
+  sort(order.begin(), order.end(), [&traces](uint32_t a, uint32_t b) {
+    return traces[a].events.size() > traces[b].events.size();
+  });
+  vector<Verdict> verdicts(traces.size() * properties.size());
+  for (auto t : order) {
+    pool.submit([&, t] {
+      for (size_t p = 0; p < properties.size(); ++p) {
+        verdicts[t * properties.size() + p] =
+            checkTrace(traces[t], properties[p]);
+      }
+    });
+  }
+  pool.wait();
+  auto checked = chrono::steady_clock::now();
+
+  size_t events = 0;
+  bool violated = false;
+  cout << "mission,monitor,verdict,event,action" << endl;
+  for (size_t t = 0; t < traces.size(); ++t) {
+    events += traces[t].events.size();
+    for (size_t p = 0; p < properties.size(); ++p) {
+      const Verdict &verdict = verdicts[t * properties.size() + p];
+      cout << traces[t].mission << "," << properties[p].path << ",";
+      if (verdict.violation != MonitorAutomaton::NO_VIOLATION) {
+        violated = true;
+        cout << "violated," << verdict.violation << ","
+             << actions[traces[t].events[verdict.violation]] << endl;
+      } else if (verdict.type == State::ACCEPT) {
+        cout << "satisfied,," << endl;
+      } else {
+        cout << "inconclusive,," << endl;
+      }
+    }
+  }
+
+  using seconds = chrono::duration<double>;
+  double parseTime = seconds(parsed - start).count();
+  double checkTime = seconds(checked - parsed).count();
+  double totalTime = seconds(checked - start).count();
+  cerr << "ltlmon-check: " << events << " events in " << traces.size()
+       << " traces, " << properties.size() << " monitors, " << pool.size()
+       << " threads" << endl
+       << "parse " << totalBytes << " bytes: " << parseTime << " s" << endl
+       << "check: " << checkTime << " s" << endl
+       << "check throughput: " << ((checkTime > 0) ? events / checkTime : 0)
+       << " events/s" << endl
+       << "end-to-end throughput: "
+       << ((totalTime > 0) ? events / totalTime : 0) << " events/s" << endl;
+  if (malformed > 0) {
+    cerr << "ltlmon-check: skipped " << malformed << " malformed lines" << endl;
+  }
+  return (violated) ? 2 : 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "ltlmoncheckpoint.hpp"
+#include "ltlmonimage.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+static void appendBytes(vector<unsigned char> &body, const void *data,
+                        size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  body.insert(body.end(), bytes, bytes + size);
+}
+
+static void appendKey(vector<unsigned char> &body, const string &key) {
+  uint32_t length = key.size();
+  appendBytes(body, &length, sizeof(length));
+  appendBytes(body, key.data(), length);
+}
+
+static void appendTimed(vector<unsigned char> &body, const string &key,
+                        const TimedSnapshot &snapshot) {
+  appendKey(body, key);
+  appendBytes(body, &snapshot.monitor.fingerprint,
+              sizeof(snapshot.monitor.fingerprint));
+  appendBytes(body, &snapshot.monitor.state, sizeof(snapshot.monitor.state));
+  uint32_t started = snapshot.started;
+  appendBytes(body, &started, sizeof(started));
+  appendBytes(body, &snapshot.lastTime, sizeof(snapshot.lastTime));
+  uint32_t clockCount = snapshot.pending.size();
+  appendBytes(body, &clockCount, sizeof(clockCount));
+  for (const auto &times : snapshot.pending) {
+    uint32_t n = times.size();
+    appendBytes(body, &n, sizeof(n));
+    appendBytes(body, times.data(), n * sizeof(int64_t));
+  }
+}
+
+bool writeCheckpoint(const std::string &path,
+                     const std::vector<MonitorSnapshot> &snapshots,
+                     const InstanceSnapshots &instances,
+                     const TimedSnapshots &timed) {
+  vector<CheckpointEntry> entries;
+  for (const auto &snapshot : snapshots) {
+    entries.push_back(CheckpointEntry{snapshot.fingerprint, snapshot.state, 0});
+  }
+  uint32_t instance = 0;
+  for (const auto &key : instances) {
+    ++instance;
+    for (const auto &snapshot : key.second) {
+      entries.push_back(
+          CheckpointEntry{snapshot.fingerprint, snapshot.state, instance});
+    }
+  }
+
+  vector<unsigned char> body;
+  appendBytes(body, entries.data(), entries.size() * sizeof(CheckpointEntry));
+  uint64_t keyCount = instances.size();
+  appendBytes(body, &keyCount, sizeof(keyCount));
+  for (const auto &key : instances) {
+    appendKey(body, key.first);
+  }
+  uint64_t timedCount = 0;
+  for (const auto &key : timed) {
+    timedCount += key.second.size();
+  }
+  appendBytes(body, &timedCount, sizeof(timedCount));
+  for (const auto &key : timed) {
+    for (const auto &snapshot : key.second) {
+      appendTimed(body, key.first, snapshot);
+    }
+  }
+
+  CheckpointHeader header = {};
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  header.version = CHECKPOINT_VERSION;
+  header.byteOrder = IMAGE_BYTE_ORDER;
+  header.count = entries.size();
+  header.checksum = fnv1a(FNV1A_BASIS, body.data(), body.size());
+
+  string tempPath = path + ".tmp";
+  int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    cerr << "LTLMonitor: couldn't create " << tempPath << endl;
+    return false;
+  }
+  bool written = ::write(fd, &header, sizeof(header)) ==
+                     static_cast<ssize_t>(sizeof(header)) &&
+                 ::write(fd, body.data(), body.size()) ==
+                     static_cast<ssize_t>(body.size()) &&
+                 fsync(fd) == 0;
+  ::close(fd);
+  if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+    cerr << "LTLMonitor: couldn't write " << path << endl;
+    unlink(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool readCheckpoint(const std::string &path,
+                    std::vector<MonitorSnapshot> &snapshots) {
+  InstanceSnapshots instances;
+  return readCheckpoint(path, snapshots, instances);
+}
+
+bool readCheckpoint(const std::string &path,
+                    std::vector<MonitorSnapshot> &snapshots,
+                    InstanceSnapshots &instances) {
+  TimedSnapshots timed;
+  return readCheckpoint(path, snapshots, instances, timed);
+}
+
+bool readCheckpoint(const std::string &path,
+                    std::vector<MonitorSnapshot> &snapshots,
+                    InstanceSnapshots &instances, TimedSnapshots &timed) {
+  ifstream input(path, ios::binary);
+  if (!input.is_open()) {
+    cerr << "LTLMonitor: couldn't open " << path << endl;
+    return false;
+  }
+
+  CheckpointHeader header;
+  if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 ||
+      header.version != CHECKPOINT_VERSION ||
+      header.byteOrder != IMAGE_BYTE_ORDER) {
+    cerr << "LTLMonitor: missing/wrong header in " << path << endl;
+    return false;
+  }
+
+  // Each entry needs at least one byte of the file, which bounds count
+  input.seekg(0, ios::end);
+  uint64_t fileSize = input.tellg();
+  const uint64_t entryBytes = header.count * sizeof(CheckpointEntry);
+  if (header.count > fileSize || fileSize < sizeof(header) + entryBytes) {
+    cerr << "LTLMonitor: invalid checkpoint size in " << path << endl;
+    return false;
+  }
+  vector<unsigned char> body(fileSize - sizeof(header));
+  input.seekg(sizeof(header));
+  if (!input.read(reinterpret_cast<char *>(body.data()), body.size()) ||
+      fnv1a(FNV1A_BASIS, body.data(), body.size()) != header.checksum) {
+    cerr << "LTLMonitor: checkpoint checksum mismatch in " << path << endl;
+    return false;
+  }
+
+  vector<string> keys;
+  size_t offset = entryBytes;
+  auto readBytes = [&body, &offset](void *data, size_t size) {
+    if (size > body.size() - offset) {
+      return false;
+    }
+    memcpy(data, body.data() + offset, size);
+    offset += size;
+    return true;
+  };
+  auto readKey = [&body, &readBytes](string &key) {
+    uint32_t length = 0;
+    if (!readBytes(&length, sizeof(length)) || length > body.size()) {
+      return false;
+    }
+    key.assign(length, '\0');
+    return readBytes(&key[0], length);
+  };
+  uint64_t keyCount = 0;
+  bool valid = readBytes(&keyCount, sizeof(keyCount));
+  for (uint64_t k = 0; valid && k < keyCount; ++k) {
+    keys.emplace_back();
+    valid = readKey(keys.back());
+  }
+
+  timed.clear();
+  uint64_t timedCount = 0;
+  valid = valid && readBytes(&timedCount, sizeof(timedCount));
+  for (uint64_t t = 0; valid && t < timedCount; ++t) {
+    string key;
+    TimedSnapshot snapshot = {};
+    uint32_t started = 0;
+    uint32_t clockCount = 0;
+    valid = readKey(key) &&
+            readBytes(&snapshot.monitor.fingerprint,
+                      sizeof(snapshot.monitor.fingerprint)) &&
+            readBytes(&snapshot.monitor.state,
+                      sizeof(snapshot.monitor.state)) &&
+            readBytes(&started, sizeof(started)) &&
+            readBytes(&snapshot.lastTime, sizeof(snapshot.lastTime)) &&
+            readBytes(&clockCount, sizeof(clockCount)) &&
+            clockCount <= body.size();
+    snapshot.started = started != 0;
+    for (uint32_t c = 0; valid && c < clockCount; ++c) {
+      uint32_t n = 0;
+      valid = readBytes(&n, sizeof(n)) && n <= body.size();
+      if (valid) {
+        snapshot.pending.emplace_back(n);
+        valid = readBytes(snapshot.pending.back().data(), n * sizeof(int64_t));
+      }
+    }
+    if (valid) {
+      timed[key].push_back(std::move(snapshot));
+    }
+  }
+  if (!valid || offset != body.size()) {
+    cerr << "LTLMonitor: invalid keys or timed monitors in " << path << endl;
+    return false;
+  }
+
+  snapshots.clear();
+  instances.clear();
+  vector<CheckpointEntry> entries(header.count);
+  memcpy(entries.data(), body.data(), entryBytes);
+  for (const auto &entry : entries) {
+    MonitorSnapshot snapshot{entry.fingerprint, entry.state};
+    if (entry.instance == 0) {
+      snapshots.push_back(snapshot);
+    } else if (entry.instance <= keys.size()) {
+      instances[keys[entry.instance - 1]].push_back(snapshot);
+    } else {
+      cerr << "LTLMonitor: invalid checkpoint instance in " << path << endl;
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,106 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef LTLMONCHECKPOINT_HPP_H
+#define LTLMONCHECKPOINT_HPP_H
+
+#include "ltlmonrt.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Checkpoint file with the states of a set of monitors, and of the instances
+ * of them kept per key, e.g. per mission:
+ *
+ *   CheckpointHeader
+ *   CheckpointEntry[count]
+ *   std::uint64_t keyCount
+ *   keyCount times: std::uint32_t length, char[length]
+ *   std::uint64_t timedCount
+ *   timedCount timed monitors, each with:
+ *     std::uint32_t length, char[length]     key, empty if shared
+ *     std::uint64_t fingerprint
+ *     std::int32_t state
+ *     std::uint32_t started
+ *     std::int64_t lastTime
+ *     std::uint32_t clockCount
+ *     clockCount times: std::uint32_t n, std::int64_t pending[n]
+ *
+ * An entry with instance 0 is one of the shared monitors, and an entry with
+ * instance k belongs to key number k - 1. The checksum is FNV-1a over
+ * everything after the header. Like monitor images, checkpoints use the byte
+ * order of the machine that wrote them.
+ */
+struct CheckpointHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t count;
+  std::uint64_t checksum;
+};
+
+struct CheckpointEntry {
+  std::uint64_t fingerprint;
+  std::int32_t state;
+  std::uint32_t instance;
+};
+
+static constexpr char CHECKPOINT_MAGIC[8] = {'L', 'T', 'L', 'M',
+                                             'O', 'N', 'C', 0};
+static constexpr std::uint32_t CHECKPOINT_VERSION = 1;
+
+/*
+ * Snapshots of the monitor instances of each key
+ */
+using InstanceSnapshots = std::map<std::string, std::vector<MonitorSnapshot>>;
+
+/*
+ * Snapshots of timed monitors by key; the empty key holds those that are
+ * not kept per key
+ */
+using TimedSnapshots = std::map<std::string, std::vector<TimedSnapshot>>;
+
+/*
+ * Writes the snapshots to a temporary file that is synced and then renamed
+ * over path, so a crash leaves either the old or the new checkpoint
+ */
+bool writeCheckpoint(const std::string &path,
+                     const std::vector<MonitorSnapshot> &snapshots,
+                     const InstanceSnapshots &instances = {},
+                     const TimedSnapshots &timed = {});
+
+bool readCheckpoint(const std::string &path,
+                    std::vector<MonitorSnapshot> &snapshots);
+bool readCheckpoint(const std::string &path,
+                    std::vector<MonitorSnapshot> &snapshots,
+                    InstanceSnapshots &instances);
+bool readCheckpoint(const std::string &path,
+                    std::vector<MonitorSnapshot> &snapshots,
+                    InstanceSnapshots &instances, TimedSnapshots &timed);
+
+#endif
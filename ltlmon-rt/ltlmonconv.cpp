@@ -0,0 +1,91 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+/*
+ * Converts a monitor generated with ltlmon (.mon) into a binary monitor image
+ * (.monb) that can be loaded with LTLMonitor::mapImage().
+ *
+ * Usage: ltlmonconv [-m] <monitor.mon> <monitor.monb>
+ *
+ * With -m the monitor is minimized before it is written.
+ */
+
+#include "ltlmonrt.hpp"
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+  bool minimize = (argc == 4 && string(argv[1]) == "-m");
+  if (argc != 3 && !minimize) {
+    cerr << "usage: " << argv[0] << " [-m] <monitor.mon> <monitor.monb>"
+         << endl;
+    return 1;
+  }
+  string monFile(argv[argc - 2]);
+  string imageFile(argv[argc - 1]);
+
+  MonitorAutomaton automaton;
+  auto start = chrono::steady_clock::now();
+  if (!automaton.initialize(monFile)) {
+    cerr << "ltlmonconv: could not load monitor from " << monFile << endl;
+    return 1;
+  }
+  auto parsed = chrono::steady_clock::now();
+  if (minimize) {
+    auto stats = automaton.minimize();
+    auto minimized = chrono::steady_clock::now();
+    cout << "minimize: " << stats.statesBefore << " -> " << stats.statesAfter
+         << " states, " << stats.tableBytesBefore << " -> "
+         << stats.tableBytesAfter << " table bytes, "
+         << chrono::duration_cast<chrono::microseconds>(minimized - parsed)
+                .count()
+         << " us" << endl;
+  }
+  if (!automaton.writeImage(imageFile)) {
+    cerr << "ltlmonconv: could not write image to " << imageFile << endl;
+    return 1;
+  }
+
+  LTLMonitor mapped;
+  auto mapStart = chrono::steady_clock::now();
+  if (!mapped.mapImage(imageFile, false)) {
+    cerr << "ltlmonconv: could not map image " << imageFile << endl;
+    return 1;
+  }
+  auto mapEnd = chrono::steady_clock::now();
+
+  using us = chrono::microseconds;
+  cout << automaton.getStateCount() << " states, "
+       << automaton.getActionCount() << " actions" << endl
+       << "parse " << monFile << ": "
+       << chrono::duration_cast<us>(parsed - start).count() << " us" << endl
+       << "map " << imageFile << ": "
+       << chrono::duration_cast<us>(mapEnd - mapStart).count() << " us"
+       << endl;
+  return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+/*
+ * Compiles a monitor generated with ltlmon into a C++ header. The header
+ * defines a struct with constexpr tables (transitions, state types, action
+ * names) and an Action enum, to be used with StaticLTLMonitor or
+ * MonitorAutomaton::initialize<Table>() so that no .mon file has to be read at
+ * runtime.
+ *
+ * Usage: ltlmongen <monitor.mon> <output.hpp> <TableName>
+ */
+
+#include "ltlmonrt.hpp"
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <set>
+
+using namespace std;
+
+static const set<string> KEYWORDS = {
+    "alignas", "alignof", "and", "asm", "auto", "bool", "break", "case",
+    "catch", "char", "class", "const", "continue", "default", "delete", "do",
+    "double", "else", "enum", "explicit", "export", "extern", "false", "float",
+    "for", "friend", "goto", "if", "inline", "int", "long", "mutable",
+    "namespace", "new", "not", "nullptr", "operator", "or", "private",
+    "protected", "public", "register", "return", "short", "signed", "sizeof",
+    "static", "struct", "switch", "template", "this", "throw", "true", "try",
+    "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual",
+    "void", "volatile", "while", "xor"};
+
+static string quote(const string &text) {
+  string quoted("\"");
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+/*
+ * Turns an action name into a valid, unique enumerator name
+ */
+static string identifier(const string &name, set<string> &used) {
+  string id;
+  for (char c : name) {
+    id += (isalnum(static_cast<unsigned char>(c))) ? c : '_';
+  }
+  if (id.empty() || isdigit(static_cast<unsigned char>(id[0]))) {
+    id = "_" + id;
+  }
+  if (KEYWORDS.count(id) != 0) {
+    id += "_";
+  }
+  string unique = id;
+  for (int suffix = 1; used.count(unique) != 0; ++suffix) {
+    unique = id + "_" + to_string(suffix);
+  }
+  used.insert(unique);
+  return unique;
+}
+
+static const char *stateTypeName(State::StateType type) {
+  switch (type) {
+  case State::ACCEPT:
+    return "State::ACCEPT";
+  case State::VIOLATION:
+    return "State::VIOLATION";
+  default:
+    return "State::INCONCLUSIVE";
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    cerr << "usage: " << argv[0] << " <monitor.mon> <output.hpp> <TableName>"
+         << endl;
+    return 1;
+  }
+  string monFile(argv[1]);
+  string outFile(argv[2]);
+  string tableName(argv[3]);
+
+  MonitorAutomaton monitor;
+  if (!monitor.initialize(monFile)) {
+    cerr << "ltlmongen: could not load monitor from " << monFile << endl;
+    return 1;
+  }
+  if (!monitor.getClockConstraints().empty()) {
+    cerr << "ltlmongen: timed monitors can't be compiled, " << monFile
+         << " has clock constraints" << endl;
+    return 1;
+  }
+
+  const MonitorAutomaton::IndexT stateCount = monitor.getStateCount();
+  const MonitorAutomaton::ActionId actionCount = monitor.getActionCount();
+
+  string indexType;
+  string invalidState;
+  if (stateCount < numeric_limits<uint8_t>::max()) {
+    indexType = "std::uint8_t";
+    invalidState = to_string(numeric_limits<uint8_t>::max());
+  } else if (stateCount < numeric_limits<uint16_t>::max()) {
+    indexType = "std::uint16_t";
+    invalidState = to_string(numeric_limits<uint16_t>::max());
+  } else {
+    indexType = "std::int32_t";
+    invalidState = "-1";
+  }
+
+  string guard;
+  for (char c : tableName) {
+    guard += toupper(static_cast<unsigned char>(c));
+  }
+  guard += "_HPP_H";
+
+  ofstream out(outFile);
+  if (!out.is_open()) {
+    cerr << "ltlmongen: couldn't open " << outFile << endl;
+    return 1;
+  }
+
+  out << "// Generated by ltlmongen from " << monFile << ". Do not edit.\n\n"
+      << "#ifndef " << guard << "\n"
+      << "#define " << guard << "\n\n"
+      << "#include \"ltlmonrt.hpp\"\n"
+      << "#include <cstdint>\n\n"
+      << "struct " << tableName << " {\n"
+      << "  using IndexT = " << indexType << ";\n"
+      << "  static constexpr IndexT INVALID_STATE = " << invalidState << ";\n"
+      << "  static constexpr const char *property = "
+      << quote(monitor.getProperty()) << ";\n"
+      << "  static constexpr int stateCount = " << stateCount << ";\n"
+      << "  static constexpr int actionCount = " << actionCount << ";\n"
+      << "  static constexpr IndexT initialState = "
+      << monitor.getInitialState() << ";\n\n";
+
+  set<string> used;
+  out << "  enum class Action : int {\n";
+  for (MonitorAutomaton::ActionId a = 0; a < actionCount; ++a) {
+    out << "    " << identifier(monitor.getActionName(a), used) << " = " << a
+        << ",\n";
+  }
+  out << "  };\n\n";
+
+  out << "  static constexpr const char *stateNames[stateCount] = {\n";
+  for (MonitorAutomaton::IndexT s = 0; s < stateCount; ++s) {
+    out << "      " << quote(monitor.getState(s).name) << ",\n";
+  }
+  out << "  };\n\n";
+
+  out << "  static constexpr State::StateType stateTypes[stateCount] = {\n";
+  for (MonitorAutomaton::IndexT s = 0; s < stateCount; ++s) {
+    out << "      " << stateTypeName(monitor.getState(s).type) << ",\n";
+  }
+  out << "  };\n\n";
+
+  out << "  static constexpr const char *actionNames[actionCount] = {\n";
+  for (MonitorAutomaton::ActionId a = 0; a < actionCount; ++a) {
+    out << "      " << quote(monitor.getActionName(a)) << ",\n";
+  }
+  out << "  };\n\n";
+
+  out << "  static constexpr IndexT transitions[stateCount * actionCount] = {\n";
+  for (MonitorAutomaton::IndexT s = 0; s < stateCount; ++s) {
+    out << "     ";
+    for (MonitorAutomaton::ActionId a = 0; a < actionCount; ++a) {
+      MonitorAutomaton::IndexT next = monitor.getTransition(s, a);
+      out << " " << ((next == MonitorAutomaton::INVALID) ? invalidState
+                                                   : to_string(next))
+          << ",";
+    }
+    out << "\n";
+  }
+  out << "  };\n"
+      << "};\n\n"
+      << "#endif\n";
+
+  return out.good() ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef LTLMONIMAGE_HPP_H
+#define LTLMONIMAGE_HPP_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Layout of a binary monitor image (.monb). The file starts with this header,
+ * followed by sections whose offsets are given in it, each aligned to
+ * IMAGE_ALIGNMENT bytes:
+ *   - transitions: stateCount * actionCount entries of tableWidth bytes,
+ *     row-major by state, with all bits set meaning an invalid transition
+ *   - types: one State::StateType byte per state
+ *   - names: (2 + stateCount + actionCount) uint32_t offsets into the string
+ *     data that follows them; the property comes first, then the state names,
+ *     then the action names, and the last offset marks the end of the data.
+ *     Every string is NUL-terminated.
+ *
+ * All values are in the byte order of the machine that wrote the image.
+ * checksum is the FNV-1a hash of the whole file with the checksum field set
+ * to zero.
+ */
+struct MonitorImageHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint32_t tableWidth;
+  std::uint32_t stateCount;
+  std::uint32_t actionCount;
+  std::uint32_t initialState;
+  std::uint64_t checksum;
+  std::uint64_t fileSize;
+  std::uint64_t transitionsOffset;
+  std::uint64_t typesOffset;
+  std::uint64_t namesOffset;
+};
+
+static constexpr char IMAGE_MAGIC[8] = {'L', 'T', 'L', 'M', 'O', 'N', 'B', 0};
+static constexpr std::uint32_t IMAGE_VERSION = 1;
+static constexpr std::uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+static constexpr std::uint64_t IMAGE_ALIGNMENT = 8;
+
+inline std::uint64_t imageAlign(std::uint64_t offset) {
+  return (offset + IMAGE_ALIGNMENT - 1) & ~(IMAGE_ALIGNMENT - 1);
+}
+
+static constexpr std::uint64_t FNV1A_BASIS = 14695981039346656037ULL;
+
+inline std::uint64_t fnv1a(std::uint64_t hash, const unsigned char *data,
+                           std::uint64_t size) {
+  for (std::uint64_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/*
+ * FNV-1a over the image, with the checksum field of the header read as zero
+ */
+inline std::uint64_t imageChecksum(const unsigned char *data,
+                                   std::uint64_t size) {
+  const std::uint64_t skipBegin = offsetof(MonitorImageHeader, checksum);
+  const std::uint64_t skipEnd = skipBegin + sizeof(std::uint64_t);
+  const unsigned char zero[sizeof(std::uint64_t)] = {};
+  std::uint64_t hash = FNV1A_BASIS;
+  hash = fnv1a(hash, data, skipBegin);
+  hash = fnv1a(hash, zero, sizeof(zero));
+  return fnv1a(hash, data + skipEnd, size - skipEnd);
+}
+
+#endif
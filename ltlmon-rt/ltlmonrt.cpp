@@ -25,21 +25,90 @@
  */
 
 #include "ltlmonrt.hpp"
+#include "ltlmonimage.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
-const LTLMonitor::IndexT LTLMonitor::INVALID = -1;
+MonitorAutomaton::MonitorAutomaton()
+    : initialState(0), stateCount(0), tableWidth(TableWidth::I32),
+      actionCount(0), transitions(nullptr), stateTypes(nullptr),
+      imageNameOffsets(nullptr), imageStrings(nullptr), fingerprint(0) {}
 
-LTLMonitor::LTLMonitor() {}
+bool MonitorAutomaton::initialize(std::string path) { return readFile(path); }
 
-bool LTLMonitor::initialize(std::string path) { return readFile(path); }
+bool MonitorAutomaton::initialize(std::string property, std::vector<State> states,
+                            std::vector<std::string> actions,
+                            const std::vector<std::int32_t> &table,
+                            IndexT initial) {
+  clear();
+  IndexT numStates = states.size();
+  IndexT numActions = actions.size();
+  if (numStates == 0 || numActions == 0 || initial < 0 ||
+      initial >= numStates ||
+      table.size() != static_cast<size_t>(numStates) * numActions) {
+    cerr << "LTLMonitor: invalid monitor tables" << endl;
+    return false;
+  }
+  for (auto next : table) {
+    if (next != INVALID && (next < 0 || next >= numStates)) {
+      cerr << "LTLMonitor: transition out of range" << endl;
+      return false;
+    }
+  }
+
+  ltlproperty = std::move(property);
+  this->states = std::move(states);
+  for (IndexT i = 0; i < numStates; ++i) {
+    stateMap[this->states[i].name] = i;
+  }
+  actionNames = std::move(actions);
+  for (ActionId a = 0; a < numActions; ++a) {
+    actionMap[actionNames[a]] = a;
+  }
+  stateCount = numStates;
+  actionCount = numActions;
+  initialState = initial;
+  buildTable(table);
+  return true;
+}
+
+void MonitorAutomaton::clear() {
+  ltlproperty.clear();
+  initialState = stateCount = actionCount = 0;
+  actionMap.clear();
+  states.clear();
+  stateMap.clear();
+  actionNames.clear();
+  clocks.clear();
+  transitions = nullptr;
+  stateTypes = nullptr;
+  transitions8.clear();
+  transitions16.clear();
+  transitions32.clear();
+  stateTypeStorage.clear();
+  image.reset();
+  imageNameOffsets = nullptr;
+  imageStrings = nullptr;
+  std::atomic_store(&selfLoops, {});
+  fingerprint = 0;
+}
 
-bool LTLMonitor::readFile(std::string path) {
+bool MonitorAutomaton::readFile(std::string path) {
   const string HEADER_TAG("TLTMON:");
   const string INITIAL_STATE("(0, 0)");
+  const string TIMED_TAG("TIMED:");
+  const string ORIGIN_ACTION("*");
   enum ReadPhase {
     HEADER,
     PROPERTY,
@@ -47,19 +116,21 @@ bool LTLMonitor::readFile(std::string path) {
     STATES,
     ACTION_COUNT,
     ACTIONS,
-    TRANSITIONS
+    TRANSITIONS,
+    TIMED
   };
   ReadPhase phase = HEADER;
 
+  clear();
   ifstream inputFile(path);
   if (!inputFile.is_open()) {
     cerr << "LTLMonitor: couldn't open " << path << endl;
     return false;
   }
 
-  int stateCount = 0;
-  int actionCount = 0;
+  int statesLeft = 0;
   bool initialStateFound = false;
+  vector<int32_t> table;
 
   string line;
   while (inputFile) {
@@ -81,8 +152,8 @@ bool LTLMonitor::readFile(std::string path) {
       phase = STATE_COUNT;
       break;
     case STATE_COUNT:
-      stateCount = atoi(line.c_str());
-      if (stateCount <= 0) {
+      statesLeft = atoi(line.c_str());
+      if (statesLeft <= 0) {
         cerr << "LTLMonitor: invalid state count in " << path << endl;
         return false;
       }
@@ -107,10 +178,10 @@ bool LTLMonitor::readFile(std::string path) {
       stateMap[line] = states.size();
       states.push_back(State{line, type});
       if (line.substr(1) == INITIAL_STATE) {
-        state = states.size() - 1;
+        initialState = states.size() - 1;
         initialStateFound = true;
       }
-      if (--stateCount == 0) {
+      if (--statesLeft == 0) {
         phase = ACTION_COUNT;
       }
       break;
@@ -123,16 +194,20 @@ bool LTLMonitor::readFile(std::string path) {
       phase = ACTIONS;
       break;
     case ACTIONS: {
-      IndexT actionId = actionMap.size();
+      IndexT actionId = actionNames.size();
       actionMap[line] = actionId;
+      actionNames.push_back(line);
     }
-      if (--actionCount == 0) {
-        transitions.resize(states.size(),
-                           vector<IndexT>(actionMap.size(), INVALID));
+      if (actionNames.size() == static_cast<size_t>(actionCount)) {
+        table.assign(states.size() * actionCount, INVALID);
         phase = TRANSITIONS;
       }
       break;
     case TRANSITIONS: {
+      if (line.compare(0, TIMED_TAG.length(), TIMED_TAG) == 0) {
+        phase = TIMED;
+        break;
+      }
       vector<IndexT> components;
       // cout << "transition line: " << line << endl;
       stringstream transition(line);
@@ -147,7 +222,53 @@ bool LTLMonitor::readFile(std::string path) {
         }
         components.push_back(atoi(component.c_str()));
       }
-      transitions[components[0]][components[1]] = components[2];
+      IndexT numStates = states.size();
+      if (components.size() != 3 || components[0] < 0 ||
+          components[0] >= numStates || components[1] < 0 ||
+          components[1] >= actionCount || components[2] < 0 ||
+          components[2] >= numStates) {
+        cerr << "LTLMonitor: transition out of range in " << path << endl;
+        return false;
+      }
+      table[static_cast<size_t>(components[0]) * actionCount + components[1]] = components[2];
+    } break;
+    case TIMED: {
+      // name,trigger,response,lower,upper[,pending] with action names, and *
+      // as the trigger for bounds that start with the trace
+      vector<string> components;
+      stringstream constraint(line);
+      string component;
+      while (getline(constraint, component, ',')) {
+        components.push_back(component);
+      }
+      if (components.size() != 5 && components.size() != 6) {
+        cerr << "LTLMonitor: invalid clock constraint in " << path << endl;
+        return false;
+      }
+      ClockConstraint clock;
+      clock.name = components[0];
+      auto trigger = actionMap.find(components[1]);
+      auto response = actionMap.find(components[2]);
+      bool fromOrigin = (components[1] == ORIGIN_ACTION);
+      clock.lower = atoll(components[3].c_str());
+      clock.upper = atoll(components[4].c_str());
+      long long pending =
+          components.size() == 6 ? atoll(components[5].c_str()) : 0;
+      clock.pending = components.size() == 6 ? static_cast<uint32_t>(pending)
+                                             : ClockConstraint::UNBOUNDED;
+      if ((!fromOrigin && trigger == actionMap.end()) ||
+          response == actionMap.end() ||
+          (!fromOrigin && trigger->second == response->second) ||
+          clock.lower < 0 || clock.upper < clock.lower ||
+          (components.size() == 6 &&
+           (pending < 1 || pending > numeric_limits<int32_t>::max()))) {
+        cerr << "LTLMonitor: invalid clock constraint " << clock.name << " in "
+             << path << endl;
+        return false;
+      }
+      clock.trigger = fromOrigin ? ClockConstraint::ORIGIN : trigger->second;
+      clock.response = response->second;
+      clocks.push_back(std::move(clock));
     } break;
     }
   }
@@ -157,42 +278,1107 @@ bool LTLMonitor::readFile(std::string path) {
          << endl;
     return false;
   }
+  if (phase != TRANSITIONS && phase != TIMED) {
+    cerr << "LTLMonitor: incomplete monitor in " << path << endl;
+    return false;
+  }
+
+  stateCount = states.size();
+  buildTable(table);
   return true;
 }
 
-bool LTLMonitor::step(std::string action) {
+/*
+ * Stores the transition table using the narrowest entry type that can
+ * represent all the state indices, keeping all-ones as the INVALID marker.
+ */
+void MonitorAutomaton::buildTable(const std::vector<std::int32_t> &table) {
+  transitions8.clear();
+  transitions16.clear();
+  transitions32.clear();
+
+  if (stateCount < numeric_limits<uint8_t>::max()) {
+    tableWidth = TableWidth::U8;
+    transitions8.assign(table.begin(), table.end());
+    transitions = transitions8.data();
+  } else if (stateCount < numeric_limits<uint16_t>::max()) {
+    tableWidth = TableWidth::U16;
+    transitions16.assign(table.begin(), table.end());
+    transitions = transitions16.data();
+  } else {
+    tableWidth = TableWidth::I32;
+    transitions32 = table;
+    transitions = transitions32.data();
+  }
+
+  stateTypeStorage.resize(stateCount);
+  for (IndexT i = 0; i < stateCount; ++i) {
+    stateTypeStorage[i] = states[i].type;
+  }
+  stateTypes = stateTypeStorage.data();
+  computeFingerprint();
+}
+
+void MonitorAutomaton::computeFingerprint() {
+  auto add = [this](const void *data, size_t size) {
+    fingerprint =
+        fnv1a(fingerprint, static_cast<const unsigned char *>(data), size);
+  };
+  fingerprint = FNV1A_BASIS;
+  add(ltlproperty.c_str(), ltlproperty.size() + 1);
+  add(&stateCount, sizeof(stateCount));
+  add(&actionCount, sizeof(actionCount));
+  add(&initialState, sizeof(initialState));
+  add(stateTypes, stateCount);
+  add(transitions, getTableBytes());
+  for (IndexT s = 0; s < stateCount; ++s) {
+    string_view name = stateName(s);
+    add(name.data(), name.size());
+    add("", 1);
+  }
+  for (const auto &name : actionNames) {
+    add(name.c_str(), name.size() + 1);
+  }
+  for (const auto &clock : clocks) {
+    add(clock.name.c_str(), clock.name.size() + 1);
+    add(&clock.trigger, sizeof(clock.trigger));
+    add(&clock.response, sizeof(clock.response));
+    add(&clock.lower, sizeof(clock.lower));
+    add(&clock.upper, sizeof(clock.upper));
+    add(&clock.pending, sizeof(clock.pending));
+  }
+}
+
+MonitorAutomaton::MinimizeStats MonitorAutomaton::minimize() {
+  MinimizeStats stats;
+  stats.statesBefore = stateCount;
+  stats.tableBytesBefore = getTableBytes();
+
+  // Complete the automaton with a sink state for invalid transitions. The
+  // transitions of accepting and violating states are never taken, so they
+  // are treated as self-loops.
+  const IndexT sink = stateCount;
+  const IndexT n = stateCount + 1;
+  auto target = [this, sink](IndexT s, ActionId a) {
+    if (s == sink || stateTypes[s] != State::INCONCLUSIVE) {
+      return s;
+    }
+    IndexT next = nextState(s, a);
+    return (next == INVALID) ? sink : next;
+  };
+
+  // Predecessors of each state for each action, as one offset range per
+  // (action, state) into a list of n entries per action
+  const size_t rowSize = static_cast<size_t>(n) + 1;
+  vector<uint32_t> predOffsets(static_cast<size_t>(actionCount) * rowSize, 0);
+  vector<IndexT> preds(static_cast<size_t>(actionCount) * n);
+  for (ActionId a = 0; a < actionCount; ++a) {
+    uint32_t *offsets = &predOffsets[a * rowSize];
+    for (IndexT s = 0; s < n; ++s) {
+      ++offsets[target(s, a) + 1];
+    }
+    for (IndexT t = 0; t < n; ++t) {
+      offsets[t + 1] += offsets[t];
+    }
+    vector<uint32_t> cursor(offsets, offsets + n);
+    for (IndexT s = 0; s < n; ++s) {
+      preds[a * static_cast<size_t>(n) + cursor[target(s, a)]++] = s;
+    }
+  }
+
+  // Partition the states into blocks of elements [first, end); states of a
+  // block that are predecessors of the current splitter are moved to its
+  // front, [first, first + marked)
+  struct Block {
+    IndexT first;
+    IndexT end;
+    IndexT marked;
+  };
+  vector<Block> blocks;
+  vector<IndexT> elements;
+  vector<IndexT> location(n);
+  vector<IndexT> blockOf(n);
+  vector<IndexT> worklist;
+  vector<bool> inWorklist;
+
+  const int SINK_CLASS = 3;
+  for (int stateClass = 0; stateClass <= SINK_CLASS; ++stateClass) {
+    IndexT first = elements.size();
+    for (IndexT s = 0; s < n; ++s) {
+      int sClass = (s == sink) ? SINK_CLASS : stateTypes[s];
+      if (sClass == stateClass) {
+        location[s] = elements.size();
+        blockOf[s] = blocks.size();
+        elements.push_back(s);
+      }
+    }
+    if (static_cast<IndexT>(elements.size()) > first) {
+      worklist.push_back(blocks.size());
+      inWorklist.push_back(true);
+      blocks.push_back(Block{first, static_cast<IndexT>(elements.size()), 0});
+    }
+  }
+
+  vector<IndexT> splitter;
+  vector<IndexT> touched;
+  while (!worklist.empty()) {
+    IndexT splitterBlock = worklist.back();
+    worklist.pop_back();
+    inWorklist[splitterBlock] = false;
+    const Block &sb = blocks[splitterBlock];
+    splitter.assign(elements.begin() + sb.first, elements.begin() + sb.end);
+
+    for (ActionId a = 0; a < actionCount; ++a) {
+      const uint32_t *offsets = &predOffsets[a * rowSize];
+      const IndexT *actionPreds = &preds[a * static_cast<size_t>(n)];
+      for (IndexT t : splitter) {
+        for (uint32_t p = offsets[t]; p < offsets[t + 1]; ++p) {
+          IndexT s = actionPreds[p];
+          IndexT b = blockOf[s];
+          Block &block = blocks[b];
+          IndexT front = block.first + block.marked;
+          if (location[s] < front) {
+            continue;
+          }
+          if (block.marked == 0) {
+            touched.push_back(b);
+          }
+          IndexT other = elements[front];
+          elements[front] = s;
+          elements[location[s]] = other;
+          location[other] = location[s];
+          location[s] = front;
+          ++block.marked;
+        }
+      }
+
+      for (IndexT b : touched) {
+        IndexT first = blocks[b].first;
+        IndexT marked = blocks[b].marked;
+        blocks[b].marked = 0;
+        if (marked == blocks[b].end - first) {
+          continue;
+        }
+        IndexT split = blocks.size();
+        blocks.push_back(Block{first, first + marked, 0});
+        blocks[b].first = first + marked;
+        for (IndexT i = first; i < first + marked; ++i) {
+          blockOf[elements[i]] = split;
+        }
+        IndexT rest = blocks[b].end - blocks[b].first;
+        if (inWorklist[b] || marked <= rest) {
+          worklist.push_back(split);
+          inWorklist.push_back(true);
+        } else {
+          inWorklist.push_back(false);
+          worklist.push_back(b);
+          inWorklist[b] = true;
+        }
+      }
+      touched.clear();
+    }
+  }
+
+  // Each block is represented by its lowest state, except that the initial
+  // state represents its own block so that it keeps its name
+  vector<IndexT> representative(blocks.size(), INVALID);
+  for (IndexT s = stateCount - 1; s >= 0; --s) {
+    representative[blockOf[s]] = s;
+  }
+  const IndexT initialBlock = blockOf[initialState];
+  const IndexT sinkBlock = blockOf[sink];
+  representative[initialBlock] = initialState;
+
+  // Number the blocks reachable from the initial state breadth-first
+  vector<IndexT> newIndex(blocks.size(), INVALID);
+  vector<IndexT> order{initialBlock};
+  newIndex[initialBlock] = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    IndexT from = representative[order[i]];
+    for (ActionId a = 0; a < actionCount; ++a) {
+      IndexT b = blockOf[target(from, a)];
+      if (b != sinkBlock && newIndex[b] == INVALID) {
+        newIndex[b] = order.size();
+        order.push_back(b);
+      }
+    }
+  }
+
+  vector<State> newStates;
+  vector<int32_t> table;
+  table.reserve(order.size() * actionCount);
+  for (IndexT b : order) {
+    IndexT from = representative[b];
+    newStates.push_back(getState(from));
+    for (ActionId a = 0; a < actionCount; ++a) {
+      table.push_back(newIndex[blockOf[target(from, a)]]);
+    }
+  }
+  vector<string> actions;
+  for (ActionId a = 0; a < actionCount; ++a) {
+    actions.push_back(getActionName(a));
+  }
+  // Clock constraints refer to actions only, so they survive renumbering
+  vector<ClockConstraint> keptClocks = std::move(clocks);
+  initialize(ltlproperty, std::move(newStates), std::move(actions), table, 0);
+  clocks = std::move(keptClocks);
+  computeFingerprint();
+
+  stats.statesAfter = stateCount;
+  stats.tableBytesAfter = getTableBytes();
+  return stats;
+}
+
+bool MonitorAutomaton::mapImage(std::string path, bool verifyChecksum) {
+  clear();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cerr << "LTLMonitor: couldn't open " << path << endl;
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 ||
+      static_cast<size_t>(fileStat.st_size) < sizeof(MonitorImageHeader)) {
+    cerr << "LTLMonitor: invalid image size in " << path << endl;
+    ::close(fd);
+    return false;
+  }
+  size_t size = fileStat.st_size;
+  void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    cerr << "LTLMonitor: couldn't map " << path << endl;
+    return false;
+  }
+  shared_ptr<const void> mapping(data, [size](const void *p) {
+    munmap(const_cast<void *>(p), size);
+  });
+  return attachImage(mapping, size, path, verifyChecksum);
+}
+
+bool MonitorAutomaton::readImage(const void *data, size_t size,
+                                 bool verifyChecksum) {
+  clear();
+  if (size < sizeof(MonitorImageHeader)) {
+    cerr << "LTLMonitor: invalid image size in memory" << endl;
+    return false;
+  }
+  // Copied to 8-byte aligned storage, as the sections of a mapping are
+  uint64_t *copy = new uint64_t[(size + 7) / 8];
+  memcpy(copy, data, size);
+  shared_ptr<const void> owned(copy, [](const void *p) {
+    delete[] static_cast<const uint64_t *>(p);
+  });
+  return attachImage(owned, size, "memory", verifyChecksum);
+}
+
+/*
+ * Whether every entry of a transition table read from an image is a state
+ * index below stateCount or the INVALID marker of its width
+ */
+template <typename EntryT>
+static bool validTransitions(const unsigned char *table, uint64_t entries,
+                             int64_t stateCount, int64_t invalid) {
+  auto typed = reinterpret_cast<const EntryT *>(table);
+  for (uint64_t i = 0; i < entries; ++i) {
+    int64_t next = typed[i];
+    if (next != invalid && (next < 0 || next >= stateCount)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MonitorAutomaton::attachImage(shared_ptr<const void> data, size_t size,
+                                   const string &path, bool verifyChecksum) {
+  auto bytes = static_cast<const unsigned char *>(data.get());
+  auto header = static_cast<const MonitorImageHeader *>(data.get());
+  if (memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+      header->byteOrder != IMAGE_BYTE_ORDER) {
+    cerr << "LTLMonitor: missing/wrong header in " << path << endl;
+    return false;
+  }
+  if (header->version != IMAGE_VERSION) {
+    cerr << "LTLMonitor: unsupported image version " << header->version
+         << " in " << path << endl;
+    return false;
+  }
+
+  uint64_t entries =
+      static_cast<uint64_t>(header->stateCount) * header->actionCount;
+  uint64_t nameCount = 2 + static_cast<uint64_t>(header->stateCount) +
+                       header->actionCount;
+  const uint64_t maxIndex = numeric_limits<IndexT>::max();
+  // Sections are compared with the space left after their offset, as the sum
+  // of an offset and a size can overflow
+  bool valid =
+      header->fileSize == size && header->stateCount > 0 &&
+      header->stateCount <= maxIndex && header->actionCount > 0 &&
+      header->actionCount <= maxIndex &&
+      header->initialState < header->stateCount &&
+      (header->tableWidth == 1 || header->tableWidth == 2 ||
+       header->tableWidth == 4) &&
+      header->transitionsOffset % IMAGE_ALIGNMENT == 0 &&
+      header->transitionsOffset >= sizeof(MonitorImageHeader) &&
+      header->transitionsOffset <= size &&
+      entries <= (size - header->transitionsOffset) / header->tableWidth &&
+      header->typesOffset <= size &&
+      header->stateCount <= size - header->typesOffset &&
+      header->namesOffset % IMAGE_ALIGNMENT == 0 &&
+      header->namesOffset <= size &&
+      nameCount <= (size - header->namesOffset) / sizeof(uint32_t);
+  if (!valid) {
+    cerr << "LTLMonitor: invalid image layout in " << path << endl;
+    return false;
+  }
+  if (verifyChecksum && imageChecksum(bytes, size) != header->checksum) {
+    cerr << "LTLMonitor: checksum mismatch in " << path << endl;
+    return false;
+  }
+
+  // Steps index the table and the state types without bounds checks, so
+  // they are checked here even if the checksum is not
+  const unsigned char *table = bytes + header->transitionsOffset;
+  switch (header->tableWidth) {
+  case 1:
+    valid = validTransitions<uint8_t>(table, entries, header->stateCount,
+                                      numeric_limits<uint8_t>::max());
+    break;
+  case 2:
+    valid = validTransitions<uint16_t>(table, entries, header->stateCount,
+                                       numeric_limits<uint16_t>::max());
+    break;
+  default:
+    valid = validTransitions<int32_t>(table, entries, header->stateCount,
+                                      INVALID);
+  }
+  for (uint64_t s = 0; valid && s < header->stateCount; ++s) {
+    valid = bytes[header->typesOffset + s] <= State::INCONCLUSIVE;
+  }
+  if (!valid) {
+    cerr << "LTLMonitor: invalid transitions in " << path << endl;
+    return false;
+  }
+
+  uint64_t namesEnd = header->namesOffset + nameCount * sizeof(uint32_t);
+  auto nameOffsets =
+      reinterpret_cast<const uint32_t *>(bytes + header->namesOffset);
+  const char *strings = reinterpret_cast<const char *>(bytes + namesEnd);
+  uint64_t stringsEnd = nameOffsets[nameCount - 1];
+  if (stringsEnd == 0 || stringsEnd > size - namesEnd ||
+      strings[stringsEnd - 1] != 0) {
+    cerr << "LTLMonitor: invalid names in " << path << endl;
+    return false;
+  }
+  for (uint64_t i = 0; i + 1 < nameCount; ++i) {
+    if (nameOffsets[i] > nameOffsets[i + 1]) {
+      cerr << "LTLMonitor: invalid names in " << path << endl;
+      return false;
+    }
+  }
+
+  image = data;
+  imageNameOffsets = nameOffsets;
+  imageStrings = strings;
+  stateCount = header->stateCount;
+  actionCount = header->actionCount;
+  tableWidth = static_cast<TableWidth>(header->tableWidth);
+  transitions = bytes + header->transitionsOffset;
+  stateTypes = bytes + header->typesOffset;
+  initialState = header->initialState;
+
+  ltlproperty = strings + nameOffsets[0];
+  for (ActionId a = 0; a < actionCount; ++a) {
+    string name(strings + nameOffsets[1 + stateCount + a]);
+    actionMap[name] = a;
+    actionNames.push_back(name);
+  }
+  computeFingerprint();
+  return true;
+}
+
+bool MonitorAutomaton::writeImage(std::string path) const {
+  vector<unsigned char> buffer;
+  if (!writeImage(buffer)) {
+    return false;
+  }
+  // Processes step straight out of mappings of the image, and truncating a
+  // mapped file makes them fault, so it is replaced instead of rewritten
+  string tempPath = path + ".tmp";
+  int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    cerr << "LTLMonitor: couldn't create " << tempPath << endl;
+    return false;
+  }
+  bool written = ::write(fd, buffer.data(), buffer.size()) ==
+                     static_cast<ssize_t>(buffer.size()) &&
+                 fsync(fd) == 0;
+  ::close(fd);
+  if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+    cerr << "LTLMonitor: couldn't write " << path << endl;
+    unlink(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool MonitorAutomaton::writeImage(vector<unsigned char> &buffer) const {
+  if (!clocks.empty()) {
+    cerr << "LTLMonitor: images of timed monitors are not supported" << endl;
+    return false;
+  }
+  MonitorImageHeader header = {};
+  memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  header.version = IMAGE_VERSION;
+  header.byteOrder = IMAGE_BYTE_ORDER;
+  header.tableWidth = static_cast<uint32_t>(tableWidth);
+  header.stateCount = stateCount;
+  header.actionCount = actionCount;
+  header.initialState = initialState;
+
+  uint64_t tableSize = static_cast<uint64_t>(stateCount) * actionCount *
+                       header.tableWidth;
+  header.transitionsOffset = imageAlign(sizeof(MonitorImageHeader));
+  header.typesOffset = imageAlign(header.transitionsOffset + tableSize);
+  header.namesOffset = imageAlign(header.typesOffset + stateCount);
+
+  vector<uint32_t> nameOffsets;
+  string strings;
+  auto addName = [&](string_view name) {
+    nameOffsets.push_back(strings.size());
+    strings.append(name);
+    strings.push_back('\0');
+  };
+  addName(ltlproperty);
+  for (IndexT s = 0; s < stateCount; ++s) {
+    addName(stateName(s));
+  }
+  for (const auto &name : actionNames) {
+    addName(name);
+  }
+  nameOffsets.push_back(strings.size());
+
+  header.fileSize = header.namesOffset +
+                    nameOffsets.size() * sizeof(uint32_t) + strings.size();
+
+  buffer.assign(header.fileSize, 0);
+  memcpy(buffer.data() + header.transitionsOffset, transitions, tableSize);
+  memcpy(buffer.data() + header.typesOffset, stateTypes, stateCount);
+  memcpy(buffer.data() + header.namesOffset, nameOffsets.data(),
+         nameOffsets.size() * sizeof(uint32_t));
+  memcpy(buffer.data() + header.namesOffset +
+             nameOffsets.size() * sizeof(uint32_t),
+         strings.data(), strings.size());
+  memcpy(buffer.data(), &header, sizeof(header));
+  header.checksum = imageChecksum(buffer.data(), buffer.size());
+  memcpy(buffer.data(), &header, sizeof(header));
+  return true;
+}
+
+MonitorAutomaton::IndexT MonitorAutomaton::nextState(IndexT from, ActionId action) const {
+  size_t offset = static_cast<size_t>(from) * actionCount + action;
+  switch (tableWidth) {
+  case TableWidth::U8: {
+    uint8_t next = static_cast<const uint8_t *>(transitions)[offset];
+    return (next == numeric_limits<uint8_t>::max()) ? INVALID : next;
+  }
+  case TableWidth::U16: {
+    uint16_t next = static_cast<const uint16_t *>(transitions)[offset];
+    return (next == numeric_limits<uint16_t>::max()) ? INVALID : next;
+  }
+  default:
+    return static_cast<const int32_t *>(transitions)[offset];
+  }
+}
+
+std::string_view MonitorAutomaton::stateName(IndexT index) const {
+  if (image) {
+    return string_view(imageStrings + imageNameOffsets[1 + index]);
+  }
+  return states[index].name;
+}
+
+MonitorAutomaton::ActionId MonitorAutomaton::internAction(std::string_view action) const {
+  auto action_it = actionMap.find(action);
+  if (action_it == actionMap.end()) {
+    return UNKNOWN_ACTION;
+  }
+  return action_it->second;
+}
+
+bool MonitorAutomaton::step(MonitorInstance &instance, ActionId action) const {
+  IndexT state = instance.state;
 
   /*
    * If we already reached an accepting or violating state, stay there
    */
-  if (states[state].type != State::INCONCLUSIVE) {
-    return states[state].type == State::ACCEPT;
+  auto type = static_cast<State::StateType>(stateTypes[state]);
+  if (type != State::INCONCLUSIVE) {
+    return type == State::ACCEPT;
   }
 
-  auto action_it = actionMap.find(action);
-  if (action_it == actionMap.end()) {
+  if (action < 0 || action >= actionCount) {
     // cout << "Action " << action << " is unknown. Ignoring" << endl;
     return true;
   }
 
-  auto action_idx = action_it->second;
-  IndexT newState = transitions[state][action_idx];
+  IndexT newState = nextState(state, action);
 
-  if (newState == INVALID) {
-    cout << "Action " << action << " at state " << states[state].name
-         << " is not valid" << endl;
+  if (newState == INVALID || stateTypes[newState] == State::VIOLATION) {
     return false;
   }
 
-  if (states[newState].type == State::VIOLATION) {
-    cout << "Action " << action << " at state " << states[state].name
-         << " violates property " << ltlproperty << endl;
-    return false;
+  instance.state = newState;
+
+  return true;
+}
+
+bool MonitorAutomaton::step(AtomicMonitorInstance &instance, ActionId action,
+                            IndexT &previous) const {
+  IndexT current = instance.state.load(memory_order_acquire);
+  while (true) {
+    previous = current;
+    MonitorInstance local{current};
+    if (!step(local, action)) {
+      return false;
+    }
+    if (local.state == current ||
+        instance.state.compare_exchange_weak(current, local.state,
+                                             memory_order_acq_rel,
+                                             memory_order_acquire)) {
+      return true;
+    }
+  }
+}
+
+size_t MonitorAutomaton::selfLoopWords() const {
+  return (actionCount + 63) / 64;
+}
+
+shared_ptr<const vector<uint64_t>> MonitorAutomaton::buildSelfLoops() const {
+  const size_t words = selfLoopWords();
+  auto loops = make_shared<vector<uint64_t>>(
+      static_cast<size_t>(stateCount) * words, 0);
+  for (IndexT s = 0; s < stateCount; ++s) {
+    if (stateTypes[s] != State::INCONCLUSIVE) {
+      continue;
+    }
+    uint64_t *row = &(*loops)[static_cast<size_t>(s) * words];
+    for (ActionId a = 0; a < actionCount; ++a) {
+      if (nextState(s, a) == s) {
+        row[a / 64] |= uint64_t(1) << (a % 64);
+      }
+    }
+  }
+  return loops;
+}
+
+size_t MonitorAutomaton::stepBatch(MonitorInstance &instance,
+                                   const ActionId *actions,
+                                   size_t count) const {
+  // Concurrent first calls may both build the masks; either copy is correct
+  auto loopMasks = std::atomic_load(&selfLoops);
+  if (!loopMasks) {
+    loopMasks = buildSelfLoops();
+    std::atomic_store(&selfLoops, loopMasks);
+  }
+  const size_t words = selfLoopWords();
+
+  IndexT state = instance.state;
+  size_t i = 0;
+  while (i < count) {
+    auto type = static_cast<State::StateType>(stateTypes[state]);
+    if (type != State::INCONCLUSIVE) {
+      instance.state = state;
+      return (type == State::ACCEPT) ? NO_VIOLATION : i;
+    }
+
+    // Skip unknown actions and actions that loop on this state
+    const uint64_t *loops = &(*loopMasks)[static_cast<size_t>(state) * words];
+    ActionId action = 0;
+    for (; i < count; ++i) {
+      action = actions[i];
+      if (static_cast<uint32_t>(action) < static_cast<uint32_t>(actionCount) &&
+          ((loops[action / 64] >> (action % 64)) & 1) == 0) {
+        break;
+      }
+    }
+    if (i == count) {
+      break;
+    }
+
+    IndexT newState = nextState(state, action);
+    if (newState == INVALID || stateTypes[newState] == State::VIOLATION) {
+      instance.state = state;
+      return i;
+    }
+    state = newState;
+    ++i;
+  }
+
+  instance.state = state;
+  return NO_VIOLATION;
+}
+
+size_t MonitorAutomaton::getTableBytes() const {
+  return static_cast<size_t>(stateCount) * actionCount *
+         static_cast<size_t>(tableWidth);
+}
+
+const std::vector<ClockConstraint> &
+MonitorAutomaton::getClockConstraints() const {
+  return clocks;
+}
+
+uint64_t MonitorAutomaton::getFingerprint() const { return fingerprint; }
+
+MonitorInstance MonitorAutomaton::newInstance() const {
+  return MonitorInstance{initialState};
+}
+
+std::string MonitorAutomaton::getProperty() const { return ltlproperty; }
+
+MonitorAutomaton::IndexT MonitorAutomaton::getStateCount() const { return stateCount; }
+
+MonitorAutomaton::IndexT MonitorAutomaton::getActionCount() const { return actionCount; }
+
+State MonitorAutomaton::getState(IndexT index) const {
+  return State{string(stateName(index)), getStateType(index)};
+}
+
+State::StateType MonitorAutomaton::getStateType(IndexT index) const {
+  return static_cast<State::StateType>(stateTypes[index]);
+}
+
+const std::string &MonitorAutomaton::getActionName(ActionId action) const {
+  return actionNames[action];
+}
+
+MonitorAutomaton::IndexT MonitorAutomaton::getInitialState() const { return initialState; }
+
+MonitorAutomaton::IndexT MonitorAutomaton::getTransition(IndexT from,
+                                             ActionId action) const {
+  return nextState(from, action);
+}
+
+LTLMonitor::LTLMonitor() : instance{0} {}
+
+LTLMonitor::LTLMonitor(std::shared_ptr<const MonitorAutomaton> automaton)
+    : automaton(automaton), instance{automaton->getInitialState()} {}
+
+LTLMonitor::LTLMonitor(const LTLMonitor &other)
+    : automaton(other.automaton), instance{other.getCurrentState()},
+      profile(other.profile) {}
+
+LTLMonitor &LTLMonitor::operator=(const LTLMonitor &other) {
+  automaton = other.automaton;
+  instance.state.store(other.getCurrentState(), memory_order_release);
+  profile = other.profile;
+  return *this;
+}
+
+bool LTLMonitor::attach(std::shared_ptr<MonitorAutomaton> loaded,
+                        bool success) {
+  if (success) {
+    automaton = loaded;
+    instance.state.store(automaton->getInitialState(), memory_order_release);
+    profile.reset();
+  }
+  return success;
+}
+
+bool LTLMonitor::initialize(std::string path, bool minimize) {
+  auto loaded = make_shared<MonitorAutomaton>();
+  bool success = loaded->initialize(path);
+  if (success && minimize) {
+    loaded->minimize();
   }
+  return attach(loaded, success);
+}
+
+bool LTLMonitor::initialize(std::string property, std::vector<State> states,
+                            std::vector<std::string> actions,
+                            const std::vector<std::int32_t> &table,
+                            IndexT initial) {
+  auto loaded = make_shared<MonitorAutomaton>();
+  return attach(loaded, loaded->initialize(std::move(property),
+                                           std::move(states),
+                                           std::move(actions), table, initial));
+}
+
+bool LTLMonitor::mapImage(std::string path, bool verifyChecksum) {
+  auto loaded = make_shared<MonitorAutomaton>();
+  return attach(loaded, loaded->mapImage(path, verifyChecksum));
+}
 
-  state = newState;
+bool LTLMonitor::writeImage(std::string path) const {
+  return automaton->writeImage(path);
+}
+
+bool LTLMonitor::readImage(const void *data, size_t size,
+                           bool verifyChecksum) {
+  auto loaded = make_shared<MonitorAutomaton>();
+  return attach(loaded, loaded->readImage(data, size, verifyChecksum));
+}
 
+bool LTLMonitor::writeImage(vector<unsigned char> &image) const {
+  return automaton->writeImage(image);
+}
+
+LTLMonitor::ActionId LTLMonitor::internAction(std::string_view action) const {
+  return automaton->internAction(action);
+}
+
+void LTLMonitor::reportViolation(IndexT state, ActionId action) const {
+  if (automaton->getStateType(state) != State::INCONCLUSIVE) {
+    return;
+  }
+  const string &name = automaton->getActionName(action);
+  string stateName = automaton->getState(state).name;
+  if (automaton->getTransition(state, action) == INVALID) {
+    cout << "Action " << name << " at state " << stateName << " is not valid"
+         << endl;
+  } else {
+    cout << "Action " << name << " at state " << stateName
+         << " violates property " << automaton->getProperty() << endl;
+  }
+}
+
+bool LTLMonitor::step(ActionId action) {
+  IndexT previous;
+  bool result = automaton->step(instance, action, previous);
+  if (profile) {
+    if (action < 0 || action >= automaton->getActionCount()) {
+      profile->recordUnknown("");
+    } else {
+      profile->recordTransition(previous, action);
+      IndexT next = previous;
+      if (result &&
+          automaton->getStateType(previous) == State::INCONCLUSIVE) {
+        next = automaton->getTransition(previous, action);
+      }
+      if (next != previous) {
+        profile->recordStateChange(previous, next);
+      }
+    }
+  }
+  if (result) {
+    return true;
+  }
+  reportViolation(previous, action);
+  return false;
+}
+
+size_t LTLMonitor::stepBatch(const ActionId *actions, size_t count) {
+  if (profile) {
+    for (size_t i = 0; i < count; ++i) {
+      if (!step(actions[i])) {
+        return i;
+      }
+    }
+    return NO_VIOLATION;
+  }
+  IndexT current = instance.state.load(memory_order_acquire);
+  MonitorInstance local{current};
+  size_t violation = automaton->stepBatch(local, actions, count);
+  while (local.state != current &&
+         !instance.state.compare_exchange_weak(current, local.state,
+                                               memory_order_acq_rel,
+                                               memory_order_acquire)) {
+    local.state = current;
+    violation = automaton->stepBatch(local, actions, count);
+  }
+  if (violation != NO_VIOLATION) {
+    reportViolation(local.state, actions[violation]);
+  }
+  return violation;
+}
+
+size_t LTLMonitor::stepBatch(const std::vector<ActionId> &actions) {
+  return stepBatch(actions.data(), actions.size());
+}
+
+bool LTLMonitor::step(std::string_view action) {
+  ActionId id = automaton->internAction(action);
+  if (id == UNKNOWN_ACTION && profile) {
+    profile->recordUnknown(action);
+    return true;
+  }
+  return step(id);
+}
+
+std::string LTLMonitor::getProperty() const {
+  return automaton->getProperty();
+}
+
+const MonitorAutomaton &LTLMonitor::getAutomaton() const { return *automaton; }
+
+std::shared_ptr<const MonitorAutomaton> LTLMonitor::shareAutomaton() const {
+  return automaton;
+}
+
+LTLMonitor::IndexT LTLMonitor::getCurrentState() const {
+  return instance.state.load(memory_order_acquire);
+}
+
+MonitorSnapshot LTLMonitor::snapshot() const {
+  return MonitorSnapshot{automaton->getFingerprint(), getCurrentState()};
+}
+
+bool LTLMonitor::restore(const MonitorSnapshot &snapshot) {
+  if (snapshot.fingerprint != automaton->getFingerprint() ||
+      snapshot.state < 0 || snapshot.state >= automaton->getStateCount()) {
+    cerr << "LTLMonitor: snapshot does not match monitor for "
+         << automaton->getProperty() << endl;
+    return false;
+  }
+  IndexT previous = instance.state.exchange(snapshot.state);
+  if (profile) {
+    profile->recordStateChange(previous, snapshot.state);
+  }
   return true;
 }
 
-std::string LTLMonitor::getProperty() const { return ltlproperty; }
+void LTLMonitor::enableProfiling() {
+  if (!profile) {
+    profile = make_shared<MonitorProfile>(automaton);
+    profile->recordStateChange(getCurrentState(), getCurrentState());
+  }
+}
+
+MonitorProfile *LTLMonitor::getProfile() const { return profile.get(); }
+
+bool LTLMonitor::writeProfile(const std::string &path) const {
+  if (!profile) {
+    cerr << "LTLMonitor: profiling is not enabled for "
+         << automaton->getProperty() << endl;
+    return false;
+  }
+  return writeProfiles(path, {profile.get()});
+}
+
+static int64_t profileClock() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+MonitorProfile::MonitorProfile(
+    std::shared_ptr<const MonitorAutomaton> automaton)
+    : automaton(automaton),
+      hits(make_unique<atomic<uint64_t>[]>(
+          static_cast<size_t>(automaton->getStateCount()) *
+          automaton->getActionCount())),
+      settled(make_unique<atomic<uint64_t>[]>(automaton->getStateCount())),
+      stateTime(make_unique<atomic<uint64_t>[]>(automaton->getStateCount())),
+      enteredAt(profileClock()), currentState(automaton->getInitialState()),
+      unknownCount(0) {
+  size_t entries =
+      static_cast<size_t>(automaton->getStateCount()) * automaton->getActionCount();
+  for (size_t i = 0; i < entries; ++i) {
+    hits[i].store(0, memory_order_relaxed);
+  }
+  for (IndexT s = 0; s < automaton->getStateCount(); ++s) {
+    settled[s].store(0, memory_order_relaxed);
+    stateTime[s].store(0, memory_order_relaxed);
+  }
+}
+
+void MonitorProfile::recordTransition(IndexT from, ActionId action) {
+  if (automaton->getStateType(from) != State::INCONCLUSIVE) {
+    settled[from].fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  hits[static_cast<size_t>(from) * automaton->getActionCount() + action]
+      .fetch_add(1, memory_order_relaxed);
+}
+
+void MonitorProfile::recordUnknown(std::string_view action) {
+  unknownCount.fetch_add(1, memory_order_relaxed);
+  if (!action.empty()) {
+    lock_guard<mutex> lock(unknownMutex);
+    auto known = unknownActions.find(action);
+    if (known == unknownActions.end()) {
+      unknownActions.emplace(string(action), 1);
+    } else {
+      ++known->second;
+    }
+  }
+}
+
+void MonitorProfile::recordStateChange(IndexT from, IndexT to) {
+  int64_t now = profileClock();
+  int64_t entered = enteredAt.exchange(now, memory_order_relaxed);
+  stateTime[from].fetch_add(now - entered, memory_order_relaxed);
+  currentState.store(to, memory_order_relaxed);
+}
+
+std::uint64_t MonitorProfile::getHits(IndexT from, ActionId action) const {
+  return hits[static_cast<size_t>(from) * automaton->getActionCount() + action]
+      .load(memory_order_relaxed);
+}
+
+std::uint64_t MonitorProfile::getSettled(IndexT state) const {
+  return settled[state].load(memory_order_relaxed);
+}
+
+std::uint64_t MonitorProfile::getUnknownCount() const {
+  return unknownCount.load(memory_order_relaxed);
+}
+
+std::map<std::string, std::uint64_t>
+MonitorProfile::getUnknownActions() const {
+  lock_guard<mutex> lock(unknownMutex);
+  return map<string, uint64_t>(unknownActions.begin(), unknownActions.end());
+}
+
+std::uint64_t MonitorProfile::getStateTime(IndexT state) const {
+  uint64_t time = stateTime[state].load(memory_order_relaxed);
+  if (state == currentState.load(memory_order_relaxed)) {
+    time += profileClock() - enteredAt.load(memory_order_relaxed);
+  }
+  return time;
+}
+
+/*
+ * Quotes a field for CSV output, doubling its quotes (RFC 4180); state names
+ * contain commas
+ */
+static string csvQuoted(std::string_view text) {
+  string result("\"");
+  for (char c : text) {
+    result += c;
+    if (c == '"') {
+      result += '"';
+    }
+  }
+  return result + "\"";
+}
+
+/*
+ * Quotes a string for JSON output
+ */
+static string jsonQuoted(std::string_view text) {
+  string result("\"");
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result + "\"";
+}
+
+void MonitorProfile::writeCSVHeader(std::ostream &out) {
+  out << "monitor,kind,state,action,next,count" << endl;
+}
+
+void MonitorProfile::writeCSV(std::ostream &out, size_t monitor) const {
+  const IndexT stateCount = automaton->getStateCount();
+  const ActionId actionCount = automaton->getActionCount();
+  for (IndexT s = 0; s < stateCount; ++s) {
+    string state = csvQuoted(automaton->getState(s).name);
+    for (ActionId a = 0; a < actionCount; ++a) {
+      uint64_t count = getHits(s, a);
+      if (count != 0) {
+        IndexT next = automaton->getTransition(s, a);
+        out << monitor << ",transition," << state << ","
+            << csvQuoted(automaton->getActionName(a)) << ","
+            << ((next == MonitorAutomaton::INVALID)
+                    ? string("invalid")
+                    : csvQuoted(automaton->getState(next).name))
+            << "," << count << "\n";
+      }
+    }
+    uint64_t time = getStateTime(s);
+    if (time != 0) {
+      out << monitor << ",time_ns," << state << ",,," << time << "\n";
+    }
+    if (getSettled(s) != 0) {
+      out << monitor << ",settled," << state << ",,," << getSettled(s)
+          << "\n";
+    }
+  }
+  for (const auto &unknown : getUnknownActions()) {
+    out << monitor << ",unknown,," << csvQuoted(unknown.first) << ",,"
+        << unknown.second << "\n";
+  }
+  out << monitor << ",unknown_total,,,," << getUnknownCount() << "\n";
+}
+
+void MonitorProfile::writeJSON(std::ostream &out) const {
+  const IndexT stateCount = automaton->getStateCount();
+  const ActionId actionCount = automaton->getActionCount();
+  out << "{\"property\": " << jsonQuoted(automaton->getProperty())
+      << ",\n \"states\": [";
+  for (IndexT s = 0; s < stateCount; ++s) {
+    out << ((s == 0) ? "\n" : ",\n") << "  {\"name\": "
+        << jsonQuoted(automaton->getState(s).name)
+        << ", \"time_ns\": " << getStateTime(s)
+        << ", \"settled\": " << getSettled(s) << ", \"transitions\": [";
+    bool first = true;
+    for (ActionId a = 0; a < actionCount; ++a) {
+      uint64_t count = getHits(s, a);
+      if (count == 0) {
+        continue;
+      }
+      IndexT next = automaton->getTransition(s, a);
+      out << ((first) ? "" : ", ") << "{\"action\": "
+          << jsonQuoted(automaton->getActionName(a)) << ", \"next\": "
+          << ((next == MonitorAutomaton::INVALID)
+                  ? string("null")
+                  : jsonQuoted(automaton->getState(next).name))
+          << ", \"count\": " << count << "}";
+      first = false;
+    }
+    out << "]}";
+  }
+  out << "],\n \"unknown\": {\"count\": " << getUnknownCount()
+      << ", \"actions\": {";
+  bool first = true;
+  for (const auto &unknown : getUnknownActions()) {
+    out << ((first) ? "" : ", ") << jsonQuoted(unknown.first) << ": "
+        << unknown.second;
+    first = false;
+  }
+  out << "}}}";
+}
+
+bool writeProfiles(const std::string &path,
+                   const std::vector<const MonitorProfile *> &profiles) {
+  const string JSON_SUFFIX(".json");
+  bool json = path.size() >= JSON_SUFFIX.size() &&
+              path.compare(path.size() - JSON_SUFFIX.size(),
+                           JSON_SUFFIX.size(), JSON_SUFFIX) == 0;
+  string tmpPath = path + ".tmp";
+  {
+    ofstream out(tmpPath, ios::trunc);
+    if (!out.is_open()) {
+      cerr << "LTLMonitor: couldn't open " << tmpPath << endl;
+      return false;
+    }
+    if (json) {
+      out << "[";
+      for (size_t i = 0; i < profiles.size(); ++i) {
+        out << ((i == 0) ? "" : ",\n");
+        profiles[i]->writeJSON(out);
+      }
+      out << "]" << endl;
+    } else {
+      MonitorProfile::writeCSVHeader(out);
+      for (size_t i = 0; i < profiles.size(); ++i) {
+        profiles[i]->writeCSV(out, i);
+      }
+    }
+    if (!out.good()) {
+      cerr << "LTLMonitor: couldn't write " << tmpPath << endl;
+      return false;
+    }
+  }
+  if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+    cerr << "LTLMonitor: couldn't replace " << path << endl;
+    return false;
+  }
+  return true;
+}
@@ -24,8 +24,18 @@
  * DM24-0251
  */
 
+#ifndef LTLMONRT_HPP_H
+#define LTLMONRT_HPP_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class State {
@@ -35,23 +45,436 @@ public:
   StateType type;
 };
 
-class LTLMonitor {
-  using IndexT = int;
-  using IndexMapT = std::map<std::string, IndexT>;
-  static const IndexT INVALID;
+/*
+ * Mutable part of a monitor: its current state in a MonitorAutomaton. Many
+ * instances can share one automaton, e.g. one per mission or vehicle.
+ */
+struct MonitorInstance {
+  std::int32_t state;
+};
+
+/*
+ * Instance that can be stepped from several threads at once
+ */
+struct AtomicMonitorInstance {
+  std::atomic<std::int32_t> state;
+};
+
+/*
+ * Saved state of a monitor, e.g. to resume after a restart. The fingerprint
+ * identifies the automaton that the state belongs to.
+ */
+struct MonitorSnapshot {
+  std::uint64_t fingerprint;
+  std::int32_t state;
+};
+
+/*
+ * Time bound read from the TIMED section of a .mon file: every occurrence of
+ * the trigger action must be followed by the response action after at least
+ * lower and at most upper time units. A trigger of ORIGIN stands for the start
+ * of the trace, e.g. the start time of the mission. If pending is not
+ * UNBOUNDED, at most that many triggers may wait for a response at once.
+ */
+struct ClockConstraint {
+  static constexpr std::int32_t ORIGIN = -1;
+  static constexpr std::uint32_t UNBOUNDED = 0;
+
+  std::string name;
+  std::int32_t trigger;
+  std::int32_t response;
+  std::int64_t lower;
+  std::int64_t upper;
+  std::uint32_t pending;
+};
+
+/*
+ * Saved state of a TimedLTLMonitor: the snapshot of its untimed monitor, the
+ * time of its last step, and the times of the pending triggers of each clock
+ * constraint, oldest first
+ */
+struct TimedSnapshot {
+  MonitorSnapshot monitor;
+  bool started;
+  std::int64_t lastTime;
+  std::vector<std::vector<std::int64_t>> pending;
+};
+
+/*
+ * Immutable part of a monitor: property, states, alphabet and transition
+ * table. It can be shared by any number of MonitorInstance objects.
+ */
+class MonitorAutomaton {
+public:
+  using IndexT = std::int32_t;
+  using ActionId = IndexT;
+
+  /*
+   * Returned by internAction() for actions that are not in the alphabet of
+   * the monitor. Stepping with it has the same effect as stepping with an
+   * unknown action name.
+   */
+  static constexpr ActionId UNKNOWN_ACTION = -1;
+
+  /*
+   * Target of a transition that is not defined in the monitor
+   */
+  static constexpr IndexT INVALID = -1;
+
+  /*
+   * Returned by stepBatch() when no action in the batch violates the property
+   */
+  static constexpr size_t NO_VIOLATION = ~size_t(0);
+
+private:
+  using IndexMapT = std::map<std::string, IndexT, std::less<>>;
+
+  /*
+   * Width in bytes of the entries of the transition table. The narrowest
+   * type that can hold every state index plus the INVALID sentinel is used.
+   */
+  enum class TableWidth : std::uint8_t { U8 = 1, U16 = 2, I32 = 4 };
 
   std::string ltlproperty;
-  IndexT state;
+  IndexT initialState;
+  IndexT stateCount;
   IndexMapT actionMap;
   std::vector<State> states;
   IndexMapT stateMap;
-  std::vector<std::vector<IndexT>> transitions;
+  std::vector<std::string> actionNames;
+  std::vector<ClockConstraint> clocks;
+
+  /*
+   * Flat transition table, row-major by state. Entry (s, a) is stored at
+   * s * actionCount + a, with all bits set meaning INVALID. transitions and
+   * stateTypes point either to the vectors below or into a mapped image.
+   */
+  TableWidth tableWidth;
+  IndexT actionCount;
+  const void *transitions;
+  const std::uint8_t *stateTypes;
+  std::vector<std::uint8_t> transitions8;
+  std::vector<std::uint16_t> transitions16;
+  std::vector<std::int32_t> transitions32;
+  std::vector<std::uint8_t> stateTypeStorage;
+
+  /*
+   * Mapping of the .monb image loaded with mapImage(), or copy of the one
+   * loaded with readImage(). The states vector is left empty in that case,
+   * and state names are read from the image.
+   */
+  std::shared_ptr<const void> image;
+  const std::uint32_t *imageNameOffsets;
+  const char *imageStrings;
 
+  /*
+   * Bitmask of the actions that loop on each inconclusive state, with
+   * selfLoopWords() words per state. It is built on the first call to
+   * stepBatch(), so that monitors that never step batches do not pay for it.
+   */
+  mutable std::shared_ptr<const std::vector<std::uint64_t>> selfLoops;
+  std::uint64_t fingerprint;
+
+  void clear();
+  void computeFingerprint();
+  size_t selfLoopWords() const;
+  std::shared_ptr<const std::vector<std::uint64_t>> buildSelfLoops() const;
   bool readFile(std::string path);
+  bool attachImage(std::shared_ptr<const void> data, size_t size,
+                   const std::string &source, bool verifyChecksum);
+  void buildTable(const std::vector<std::int32_t> &table);
+  IndexT nextState(IndexT from, ActionId action) const;
+  std::string_view stateName(IndexT index) const;
 
 public:
-  LTLMonitor();
+  /*
+   * Sizes of the automaton before and after minimize()
+   */
+  struct MinimizeStats {
+    IndexT statesBefore;
+    IndexT statesAfter;
+    size_t tableBytesBefore;
+    size_t tableBytesAfter;
+  };
+
+  MonitorAutomaton();
+  MonitorAutomaton(const MonitorAutomaton &) = delete;
+  MonitorAutomaton &operator=(const MonitorAutomaton &) = delete;
+
   bool initialize(std::string path);
-  bool step(std::string action);
+
+  /*
+   * Builds an automaton from in-memory tables. table has states.size() *
+   * actions.size() entries, row-major by state, with INVALID for undefined
+   * transitions.
+   */
+  bool initialize(std::string property, std::vector<State> states,
+                  std::vector<std::string> actions,
+                  const std::vector<std::int32_t> &table, IndexT initial);
+
+  /*
+   * Loads a monitor compiled into a header by ltlmongen, without any file
+   * I/O or parsing.
+   */
+  template <typename Table> bool initialize();
+
+  /*
+   * Maps a binary monitor image (.monb) written by writeImage(). The
+   * transition table is used directly from the mapping, and loading only
+   * reads it once to check that every transition stays within the monitor.
+   * verifyChecksum also hashes the whole image to catch any other damage.
+   * A mapped image must only ever be replaced (written elsewhere and renamed
+   * over it, as writeImage() does), never rewritten in place: truncating it
+   * makes every process that maps it crash with SIGBUS on its next step.
+   */
+  bool mapImage(std::string path, bool verifyChecksum = true);
+  bool writeImage(std::string path) const;
+
+  /*
+   * Same as mapImage() and writeImage(), with the image in memory, e.g. to
+   * send it to another process. readImage() copies the data.
+   */
+  bool readImage(const void *data, size_t size, bool verifyChecksum = true);
+  bool writeImage(std::vector<unsigned char> &image) const;
+
+  /*
+   * Merges equivalent states with Hopcroft's algorithm, drops unreachable
+   * states, and renumbers the rest in breadth-first order from the initial
+   * state, which becomes state 0, so that states visited together are close
+   * in the table. All accepting states are equivalent, as are all violating
+   * states, since step() never leaves them. Invalid transitions are kept
+   * apart from transitions into violating states so that LTLMonitor still
+   * reports them the same way.
+   */
+  MinimizeStats minimize();
+
+  ActionId internAction(std::string_view action) const;
+
+  /*
+   * Advances the instance with the action. Returns false if the action
+   * violates the property or is not valid in the current state; the instance
+   * keeps its state in that case. Unknown actions are ignored. Unlike
+   * LTLMonitor::step(), nothing is printed.
+   */
+  bool step(MonitorInstance &instance, ActionId action) const;
+
+  /*
+   * Thread-safe step(). The new state is published with compare-and-swap,
+   * retrying if another thread moved the instance first, so concurrent steps
+   * take effect one after another without a lock. previous is set to the
+   * state that the action was applied to.
+   */
+  bool step(AtomicMonitorInstance &instance, ActionId action,
+            IndexT &previous) const;
+
+  /*
+   * Steps the instance through a sequence of actions, with the same effect
+   * as calling step() for each of them until one returns false. Returns the
+   * index of the first violating action, or NO_VIOLATION. Runs of actions
+   * that loop on the current state are skipped without table lookups, and
+   * stepping stops as soon as an accepting or violating state is reached.
+   */
+  size_t stepBatch(MonitorInstance &instance, const ActionId *actions,
+                   size_t count) const;
+
+  MonitorInstance newInstance() const;
   std::string getProperty() const;
+  IndexT getStateCount() const;
+  IndexT getActionCount() const;
+  State getState(IndexT index) const;
+  State::StateType getStateType(IndexT index) const;
+  const std::string &getActionName(ActionId action) const;
+  IndexT getInitialState() const;
+  IndexT getTransition(IndexT from, ActionId action) const;
+  size_t getTableBytes() const;
+
+  /*
+   * Time bounds of the monitor, which are checked by TimedLTLMonitor. They
+   * are empty for untimed monitors, and ignored by step().
+   */
+  const std::vector<ClockConstraint> &getClockConstraints() const;
+
+  /*
+   * Hash of the property, sizes, initial state, state types, transition
+   * table, state and action names and clock constraints, used to check that
+   * a snapshot belongs to this automaton
+   */
+  std::uint64_t getFingerprint() const;
 };
+
+/*
+ * Optional instrumentation of a monitor: how often each transition was taken,
+ * how many events arrived after the monitor had settled in an accepting or
+ * violating state, how many events had an action that is not in the
+ * alphabet, and how long the monitor stayed in each state. Counters are
+ * relaxed atomics, so the profile can be updated from several threads; times
+ * are approximate when they are.
+ */
+class MonitorProfile {
+public:
+  using IndexT = MonitorAutomaton::IndexT;
+  using ActionId = MonitorAutomaton::ActionId;
+
+  explicit MonitorProfile(std::shared_ptr<const MonitorAutomaton> automaton);
+  MonitorProfile(const MonitorProfile &) = delete;
+  MonitorProfile &operator=(const MonitorProfile &) = delete;
+
+  /*
+   * Counts a step from state from with a known action. The transitions of
+   * accepting and violating states are never taken, so a step from one of
+   * them is counted as settled in that state instead.
+   */
+  void recordTransition(IndexT from, ActionId action);
+
+  /*
+   * Counts an event with an unknown action. The name is kept too, unless it
+   * is empty (e.g. for an out-of-range ActionId).
+   */
+  void recordUnknown(std::string_view action);
+
+  /*
+   * Charges the time since the last state change to from, and starts
+   * timing to
+   */
+  void recordStateChange(IndexT from, IndexT to);
+
+  std::uint64_t getHits(IndexT from, ActionId action) const;
+  std::uint64_t getSettled(IndexT state) const;
+  std::uint64_t getUnknownCount() const;
+  std::map<std::string, std::uint64_t> getUnknownActions() const;
+
+  /*
+   * Nanoseconds spent in the state, including the time so far if it is the
+   * current one
+   */
+  std::uint64_t getStateTime(IndexT state) const;
+
+  /*
+   * One row per transition that was taken, per state with time charged to
+   * it or events settled in it, and per unknown action, in the columns
+   * written by writeCSVHeader()
+   */
+  void writeCSV(std::ostream &out, size_t monitor) const;
+  static void writeCSVHeader(std::ostream &out);
+  void writeJSON(std::ostream &out) const;
+
+private:
+  std::shared_ptr<const MonitorAutomaton> automaton;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> hits;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> settled;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> stateTime;
+  std::atomic<std::int64_t> enteredAt;
+  std::atomic<IndexT> currentState;
+  std::atomic<std::uint64_t> unknownCount;
+  mutable std::mutex unknownMutex;
+  std::map<std::string, std::uint64_t, std::less<>> unknownActions;
+};
+
+/*
+ * Writes the profiles as a JSON array if path ends in .json, and as CSV
+ * otherwise. The file is replaced atomically.
+ */
+bool writeProfiles(const std::string &path,
+                   const std::vector<const MonitorProfile *> &profiles);
+
+/*
+ * A monitor for a single trace: a shared automaton plus one instance. Copies
+ * share the automaton and step independently. The instance is atomic, so one
+ * monitor can be stepped from several threads, e.g. gRPC handlers.
+ */
+class LTLMonitor {
+public:
+  using IndexT = MonitorAutomaton::IndexT;
+  using ActionId = MonitorAutomaton::ActionId;
+
+  static constexpr ActionId UNKNOWN_ACTION = MonitorAutomaton::UNKNOWN_ACTION;
+  static constexpr IndexT INVALID = MonitorAutomaton::INVALID;
+  static constexpr size_t NO_VIOLATION = MonitorAutomaton::NO_VIOLATION;
+
+private:
+  std::shared_ptr<const MonitorAutomaton> automaton;
+  AtomicMonitorInstance instance;
+  std::shared_ptr<MonitorProfile> profile;
+
+  bool attach(std::shared_ptr<MonitorAutomaton> loaded, bool success);
+  void reportViolation(IndexT state, ActionId action) const;
+
+public:
+  LTLMonitor();
+  explicit LTLMonitor(std::shared_ptr<const MonitorAutomaton> automaton);
+  LTLMonitor(const LTLMonitor &other);
+  LTLMonitor &operator=(const LTLMonitor &other);
+
+  /*
+   * Loads a .mon file, optionally minimizing the automaton after reading it
+   */
+  bool initialize(std::string path, bool minimize = false);
+  bool initialize(std::string property, std::vector<State> states,
+                  std::vector<std::string> actions,
+                  const std::vector<std::int32_t> &table, IndexT initial);
+  template <typename Table> bool initialize();
+  bool mapImage(std::string path, bool verifyChecksum = true);
+  bool writeImage(std::string path) const;
+  bool readImage(const void *data, size_t size, bool verifyChecksum = true);
+  bool writeImage(std::vector<unsigned char> &image) const;
+
+  ActionId internAction(std::string_view action) const;
+  bool step(ActionId action);
+  bool step(std::string_view action);
+
+  /*
+   * Applies the batch up to its first violation as a single step with
+   * respect to other threads
+   */
+  size_t stepBatch(const ActionId *actions, size_t count);
+  size_t stepBatch(const std::vector<ActionId> &actions);
+  std::string getProperty() const;
+
+  const MonitorAutomaton &getAutomaton() const;
+  std::shared_ptr<const MonitorAutomaton> shareAutomaton() const;
+  IndexT getCurrentState() const;
+
+  MonitorSnapshot snapshot() const;
+
+  /*
+   * Moves the monitor to a saved state. Fails if the snapshot was taken from
+   * a different automaton.
+   */
+  bool restore(const MonitorSnapshot &snapshot);
+
+  /*
+   * Starts counting transitions, unknown actions and time per state. While
+   * profiling, stepBatch() steps one action at a time. Copies of the monitor
+   * share the profile. Loading a new automaton stops profiling.
+   */
+  void enableProfiling();
+  MonitorProfile *getProfile() const;
+
+  /*
+   * Writes the profile with writeProfiles(); fails if profiling is off
+   */
+  bool writeProfile(const std::string &path) const;
+};
+
+template <typename Table> bool MonitorAutomaton::initialize() {
+  std::vector<State> tableStates;
+  for (IndexT i = 0; i < Table::stateCount; ++i) {
+    tableStates.push_back(State{Table::stateNames[i], Table::stateTypes[i]});
+  }
+  std::vector<std::string> tableActions(std::begin(Table::actionNames),
+                                        std::end(Table::actionNames));
+  std::vector<std::int32_t> table;
+  table.reserve(Table::stateCount * Table::actionCount);
+  for (auto next : Table::transitions) {
+    table.push_back((next == Table::INVALID_STATE) ? INVALID : next);
+  }
+  return initialize(Table::property, std::move(tableStates),
+                    std::move(tableActions), table, Table::initialState);
+}
+
+template <typename Table> bool LTLMonitor::initialize() {
+  auto loaded = std::make_shared<MonitorAutomaton>();
+  return attach(loaded, loaded->initialize<Table>());
+}
+
+#endif
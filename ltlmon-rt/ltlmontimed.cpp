@@ -0,0 +1,284 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "ltlmontimed.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+TimedLTLMonitor::TimedLTLMonitor()
+    : lastTime(0), earliestDeadline(NO_DEADLINE), started(false) {}
+
+TimedLTLMonitor::TimedLTLMonitor(
+    std::shared_ptr<const MonitorAutomaton> automaton, size_t pendingCapacity)
+    : monitor(automaton), lastTime(0), earliestDeadline(NO_DEADLINE),
+      started(false) {
+  setup(pendingCapacity);
+}
+
+bool TimedLTLMonitor::initialize(std::string path, bool minimize) {
+  if (!monitor.initialize(path, minimize)) {
+    return false;
+  }
+  setup(DEFAULT_PENDING);
+  return true;
+}
+
+void TimedLTLMonitor::setup(size_t pendingCapacity) {
+  const MonitorAutomaton &automaton = monitor.getAutomaton();
+  clocks = automaton.getClockConstraints();
+
+  const ActionId actionCount = automaton.getActionCount();
+  clockOffsets.assign(actionCount + 1, 0);
+  for (const auto &clock : clocks) {
+    if (clock.trigger != ClockConstraint::ORIGIN) {
+      ++clockOffsets[clock.trigger + 1];
+    }
+    ++clockOffsets[clock.response + 1];
+  }
+  for (ActionId a = 0; a < actionCount; ++a) {
+    clockOffsets[a + 1] += clockOffsets[a];
+  }
+  clockIndex.resize(clockOffsets[actionCount]);
+  vector<uint32_t> cursor(clockOffsets.begin(), clockOffsets.end() - 1);
+  for (uint32_t c = 0; c < clocks.size(); ++c) {
+    if (clocks[c].trigger != ClockConstraint::ORIGIN) {
+      clockIndex[cursor[clocks[c].trigger]++] = c;
+    }
+    clockIndex[cursor[clocks[c].response]++] = c;
+  }
+
+  ringOffset.resize(clocks.size());
+  ringMask.resize(clocks.size());
+  size_t offset = 0;
+  for (uint32_t c = 0; c < clocks.size(); ++c) {
+    size_t room = pendingCapacity;
+    if (clocks[c].pending != ClockConstraint::UNBOUNDED) {
+      room = min<size_t>(room, clocks[c].pending);
+    }
+    size_t capacity = 1;
+    while (capacity < room) {
+      capacity <<= 1;
+    }
+    ringOffset[c] = offset;
+    ringMask[c] = capacity - 1;
+    offset += capacity;
+  }
+  pending.assign(offset, 0);
+  pendingHead.assign(clocks.size(), 0);
+  pendingCount.assign(clocks.size(), 0);
+  earliestDeadline = NO_DEADLINE;
+  started = false;
+}
+
+void TimedLTLMonitor::start(TimeT origin) {
+  monitor = LTLMonitor(monitor.shareAutomaton());
+  fill(pendingHead.begin(), pendingHead.end(), 0);
+  fill(pendingCount.begin(), pendingCount.end(), 0);
+  for (uint32_t c = 0; c < clocks.size(); ++c) {
+    if (clocks[c].trigger == ClockConstraint::ORIGIN) {
+      pending[ringOffset[c]] = origin;
+      pendingCount[c] = 1;
+    }
+  }
+  lastTime = origin;
+  started = true;
+  updateDeadline();
+}
+
+TimedLTLMonitor::ActionId
+TimedLTLMonitor::internAction(std::string_view action) const {
+  return monitor.internAction(action);
+}
+
+/*
+ * Doubles the ring of a constraint, moving its pending triggers to the start
+ */
+void TimedLTLMonitor::grow(uint32_t clock) {
+  const uint32_t size = ringMask[clock] + 1;
+  vector<TimeT> waiting(pendingCount[clock]);
+  for (uint32_t k = 0; k < pendingCount[clock]; ++k) {
+    waiting[k] = pending[ringOffset[clock] +
+                         ((pendingHead[clock] + k) & ringMask[clock])];
+  }
+  pending.insert(pending.begin() + ringOffset[clock] + size, size, 0);
+  copy(waiting.begin(), waiting.end(), pending.begin() + ringOffset[clock]);
+  for (uint32_t c = clock + 1; c < clocks.size(); ++c) {
+    ringOffset[c] += size;
+  }
+  ringMask[clock] = 2 * size - 1;
+  pendingHead[clock] = 0;
+}
+
+/*
+ * Reports and drops the pending triggers whose deadline is before now
+ */
+bool TimedLTLMonitor::expire(TimeT now) {
+  bool ok = true;
+  for (uint32_t c = 0; c < clocks.size(); ++c) {
+    const TimeT *ring = &pending[ringOffset[c]];
+    while (pendingCount[c] > 0 &&
+           now - ring[pendingHead[c]] > clocks[c].upper) {
+      cout << "Deadline of " << clocks[c].name << " missed at " << now
+           << " (triggered at " << ring[pendingHead[c]] << ")" << endl;
+      pendingHead[c] = (pendingHead[c] + 1) & ringMask[c];
+      --pendingCount[c];
+      ok = false;
+    }
+  }
+  updateDeadline();
+  return ok;
+}
+
+void TimedLTLMonitor::updateDeadline() {
+  earliestDeadline = NO_DEADLINE;
+  for (uint32_t c = 0; c < clocks.size(); ++c) {
+    if (pendingCount[c] > 0) {
+      TimeT triggered = pending[ringOffset[c] + pendingHead[c]];
+      earliestDeadline = min(earliestDeadline, triggered + clocks[c].upper);
+    }
+  }
+}
+
+bool TimedLTLMonitor::advance(TimeT now) {
+  if (!started) {
+    start(now);
+  }
+  if (now < lastTime) {
+    cerr << "LTLMonitor: time " << now << " is before " << lastTime << endl;
+    return false;
+  }
+  lastTime = now;
+  return (now <= earliestDeadline) || expire(now);
+}
+
+bool TimedLTLMonitor::step(ActionId action, TimeT timestamp) {
+  if (started && timestamp < lastTime) {
+    cerr << "LTLMonitor: time " << timestamp << " is before " << lastTime
+         << endl;
+    return false;
+  }
+  // Missed deadlines are reported, and the event is still applied
+  bool ok = advance(timestamp);
+  ok = monitor.step(action) && ok;
+  if (action < 0 || clocks.empty()) {
+    return ok;
+  }
+
+  bool changed = false;
+  for (uint32_t i = clockOffsets[action]; i < clockOffsets[action + 1]; ++i) {
+    uint32_t c = clockIndex[i];
+    if (clocks[c].response == action) {
+      const TimeT *ring = &pending[ringOffset[c]];
+      while (pendingCount[c] > 0 &&
+             timestamp - ring[pendingHead[c]] >= clocks[c].lower) {
+        pendingHead[c] = (pendingHead[c] + 1) & ringMask[c];
+        --pendingCount[c];
+        changed = true;
+      }
+    } else if (clocks[c].pending != ClockConstraint::UNBOUNDED &&
+               pendingCount[c] >= clocks[c].pending) {
+      cout << "More than " << clocks[c].pending << " pending triggers of "
+           << clocks[c].name << " at " << timestamp << endl;
+      ok = false;
+    } else {
+      if (pendingCount[c] > ringMask[c]) {
+        grow(c);
+      }
+      pending[ringOffset[c] + ((pendingHead[c] + pendingCount[c]) &
+                               ringMask[c])] = timestamp;
+      ++pendingCount[c];
+      changed = true;
+    }
+  }
+  if (changed) {
+    updateDeadline();
+  }
+  return ok;
+}
+
+bool TimedLTLMonitor::step(std::string_view action, TimeT timestamp) {
+  return step(internAction(action), timestamp);
+}
+
+TimedLTLMonitor::TimeT TimedLTLMonitor::nextDeadline() const {
+  return earliestDeadline;
+}
+
+TimedSnapshot TimedLTLMonitor::snapshot() const {
+  TimedSnapshot saved{monitor.snapshot(), started, lastTime, {}};
+  saved.pending.resize(clocks.size());
+  for (uint32_t c = 0; c < clocks.size(); ++c) {
+    for (uint32_t k = 0; k < pendingCount[c]; ++k) {
+      saved.pending[c].push_back(
+          pending[ringOffset[c] + ((pendingHead[c] + k) & ringMask[c])]);
+    }
+  }
+  return saved;
+}
+
+bool TimedLTLMonitor::restore(const TimedSnapshot &saved) {
+  bool valid = saved.pending.size() == clocks.size();
+  for (uint32_t c = 0; valid && c < clocks.size(); ++c) {
+    valid = clocks[c].pending == ClockConstraint::UNBOUNDED ||
+            saved.pending[c].size() <= clocks[c].pending;
+  }
+  if (!valid) {
+    cerr << "LTLMonitor: snapshot doesn't match the clocks of "
+         << getProperty() << endl;
+    return false;
+  }
+  if (!monitor.restore(saved.monitor)) {
+    return false;
+  }
+  for (uint32_t c = 0; c < clocks.size(); ++c) {
+    pendingHead[c] = 0;
+    pendingCount[c] = 0;
+    while (saved.pending[c].size() > ringMask[c] + size_t(1)) {
+      grow(c);
+    }
+    copy(saved.pending[c].begin(), saved.pending[c].end(),
+         pending.begin() + ringOffset[c]);
+    pendingCount[c] = saved.pending[c].size();
+  }
+  started = saved.started;
+  lastTime = saved.lastTime;
+  updateDeadline();
+  return true;
+}
+
+std::string TimedLTLMonitor::getProperty() const {
+  return monitor.getProperty();
+}
+
+const MonitorAutomaton &TimedLTLMonitor::getAutomaton() const {
+  return monitor.getAutomaton();
+}
+
+TimedLTLMonitor::IndexT TimedLTLMonitor::getCurrentState() const {
+  return monitor.getCurrentState();
+}
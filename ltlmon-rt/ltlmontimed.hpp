@@ -0,0 +1,152 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef LTLMONTIMED_HPP_H
+#define LTLMONTIMED_HPP_H
+
+#include "ltlmonrt.hpp"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Monitor for a property with time bounds. The untimed part is checked by an
+ * LTLMonitor, and each ClockConstraint of the automaton is checked with a
+ * ring buffer of the times of its pending triggers. Timestamps never
+ * decrease, so the oldest pending trigger of a constraint always has the
+ * earliest deadline, and step() only compares the current time with the
+ * earliest deadline of the monitor before doing any other work. Deadlines
+ * are checked when events arrive; advance() checks them without an event.
+ *
+ * The semantics are those of a bounded response G(trigger -> F[lower,upper]
+ * response): a response discharges every pending trigger that is at least
+ * lower time units old, a response that comes too early is not an error by
+ * itself, and a trigger that gets no response within upper time units
+ * violates the property, as does a trigger that finds the number of pending
+ * triggers declared for its constraint already waiting. The unit of time is
+ * that of the timestamps; the assurance broker uses milliseconds.
+ *
+ * Unlike LTLMonitor, a TimedLTLMonitor must not be stepped from several
+ * threads at once.
+ */
+class TimedLTLMonitor {
+public:
+  using IndexT = LTLMonitor::IndexT;
+  using ActionId = LTLMonitor::ActionId;
+  using TimeT = std::int64_t;
+
+  static constexpr size_t DEFAULT_PENDING = 16;
+  static constexpr TimeT NO_DEADLINE = std::numeric_limits<TimeT>::max();
+
+  TimedLTLMonitor();
+
+  /*
+   * pendingCapacity is the number of triggers of one constraint that the
+   * monitor makes room for up front. The room grows when more triggers wait
+   * at once, up to the pending bound of the constraint if it has one.
+   */
+  explicit TimedLTLMonitor(std::shared_ptr<const MonitorAutomaton> automaton,
+                           size_t pendingCapacity = DEFAULT_PENDING);
+
+  bool initialize(std::string path, bool minimize = false);
+
+  /*
+   * Starts a new trace at time origin: the monitor goes back to its initial
+   * state, pending triggers are dropped, and constraints triggered by the
+   * origin start counting. If it is not called, the trace starts at the
+   * timestamp of the first step.
+   */
+  void start(TimeT origin);
+
+  ActionId internAction(std::string_view action) const;
+
+  /*
+   * Checks the deadlines that passed before timestamp, then steps the
+   * untimed monitor and updates the constraints of the action. Returns false
+   * if a deadline was missed, the action violates the property, or the
+   * timestamp is earlier than the previous one.
+   */
+  bool step(ActionId action, TimeT timestamp);
+  bool step(std::string_view action, TimeT timestamp);
+
+  /*
+   * Checks the deadlines that passed before now without an event
+   */
+  bool advance(TimeT now);
+
+  /*
+   * Earliest time at which a pending trigger misses its deadline, or
+   * NO_DEADLINE
+   */
+  TimeT nextDeadline() const;
+
+  TimedSnapshot snapshot() const;
+
+  /*
+   * Restores the state, clocks and pending triggers of a snapshot of the
+   * same automaton, e.g. to resume a trace after a restart
+   */
+  bool restore(const TimedSnapshot &snapshot);
+
+  std::string getProperty() const;
+  const MonitorAutomaton &getAutomaton() const;
+  IndexT getCurrentState() const;
+
+private:
+  LTLMonitor monitor;
+  std::vector<ClockConstraint> clocks;
+
+  /*
+   * Constraints that each action triggers or responds to, as one offset
+   * range per action into clockIndex
+   */
+  std::vector<std::uint32_t> clockOffsets;
+  std::vector<std::uint32_t> clockIndex;
+
+  /*
+   * Trigger times of each constraint c, in a ring of ringMask[c] + 1 entries
+   * starting at index ringOffset[c]. Ring sizes are powers of two.
+   */
+  std::vector<TimeT> pending;
+  std::vector<std::uint32_t> ringOffset;
+  std::vector<std::uint32_t> ringMask;
+  std::vector<std::uint32_t> pendingHead;
+  std::vector<std::uint32_t> pendingCount;
+
+  TimeT lastTime;
+  TimeT earliestDeadline;
+  bool started;
+
+  void setup(size_t pendingCapacity);
+  void grow(std::uint32_t clock);
+  bool expire(TimeT now);
+  void updateDeadline();
+};
+
+#endif
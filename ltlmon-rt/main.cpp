@@ -24,8 +24,26 @@
  * DM24-0251
  */
 
+#include "instancetable.hpp"
+#include "ltlmonaudit.hpp"
+#include "ltlmonbank.hpp"
+#include "ltlmoncheckpoint.hpp"
+#include "ltlmonimage.hpp"
 #include "ltlmonrt.hpp"
+#include "ltlmontimed.hpp"
+#include "prop1_monitor.hpp"
+#include "staticltlmon.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
 #include <vector>
 
 using namespace std;
@@ -47,19 +65,130 @@ std::vector<Test>
             {"nop", "nop", "at_destination", "nop", "drop_supplies", "nop"},
             true}});
 
-bool runTest(const Test &test) {
-  cout << "Starting test " << test.name << endl;
+struct TimedTest {
+  string name;
+  std::vector<pair<string, TimedLTLMonitor::TimeT>> events;
+  bool expected;
+};
+
+// tests/timed.mon requires at_destination within 30 s of each takeoff and
+// drop_supplies within an hour of the start of the mission, in milliseconds
+std::vector<TimedTest> timedTests(
+    {{"timed1",
+      {{"takeoff", 0}, {"at_destination", 20000}, {"drop_supplies", 25000}},
+      true},
+     {"timed2", {{"takeoff", 0}, {"nop", 10000}, {"at_destination", 40000}},
+      false},
+     {"timed3",
+      {{"takeoff", 0},
+       {"at_destination", 20000},
+       {"nop", 1000000},
+       {"drop_supplies", 3700000}},
+      false},
+     {"timed4",
+      {{"takeoff", 0},
+       {"takeoff", 5000},
+       {"at_destination", 30000},
+       {"drop_supplies", 31000}},
+      true},
+     {"timed5", {{"takeoff", 0}, {"drop_supplies", 1000}}, false}});
+
+enum class Mode { NAMES, INTERNED, IMAGE, MINIMIZED, MEMORY };
+
+bool runTest(const Test &test, Mode mode) {
+  const char *modeNames[] = {"", " (interned)", " (image)", " (minimized)",
+                             " (image in memory)"};
+  cout << "Starting test " << test.name << modeNames[static_cast<int>(mode)]
+       << endl;
   LTLMonitor monitor;
-  if (!monitor.initialize(test.monFile)) {
+  if (!monitor.initialize(test.monFile, mode == Mode::MINIMIZED)) {
     cout << "Could not load monitor from " << test.monFile << endl;
     return false;
   };
 
+  if (mode == Mode::IMAGE) {
+    auto imageFile = filesystem::temp_directory_path() /
+                     (filesystem::path(test.monFile).stem().string() + ".monb");
+    if (!monitor.writeImage(imageFile) || !monitor.mapImage(imageFile)) {
+      cout << "Could not convert monitor to " << imageFile << endl;
+      return false;
+    }
+    // Writing the image again while it is mapped must replace the file, not
+    // truncate the mapping that the monitor steps from
+    struct stat before, after;
+    if (stat(imageFile.c_str(), &before) != 0 ||
+        !monitor.writeImage(imageFile) ||
+        stat(imageFile.c_str(), &after) != 0 || before.st_ino == after.st_ino) {
+      cout << "Image " << imageFile << " was rewritten in place" << endl;
+      return false;
+    }
+  }
+  if (mode == Mode::MEMORY) {
+    std::vector<unsigned char> image;
+    if (!monitor.writeImage(image) ||
+        !monitor.readImage(image.data(), image.size())) {
+      cout << "Could not convert monitor to an image in memory" << endl;
+      return false;
+    }
+    // Damaged images are rejected even without the checksum: a transition
+    // out of the monitor, and a state type that does not exist
+    MonitorImageHeader header;
+    memcpy(&header, image.data(), sizeof(header));
+    for (uint64_t offset : {header.transitionsOffset + header.tableWidth - 1,
+                            header.typesOffset}) {
+      std::vector<unsigned char> damaged = image;
+      damaged[offset] = 0x7f;
+      LTLMonitor rejected;
+      if (rejected.readImage(damaged.data(), damaged.size(), false)) {
+        cout << "Damaged image at offset " << offset << " was loaded" << endl;
+        return false;
+      }
+    }
+  }
+
+  cout << "Property: " << monitor.getProperty() << endl;
+  std::vector<LTLMonitor::ActionId> actionIds;
+  for (const auto &event : test.events) {
+    actionIds.push_back(monitor.internAction(event));
+  }
+
+  bool result = true;
+  for (size_t i = 0; i < test.events.size(); ++i) {
+    const auto &event = test.events[i];
+    result = (mode == Mode::NAMES) ? monitor.step(event)
+                                   : monitor.step(actionIds[i]);
+    cout << "step[" << event << "] -> " << result << endl;
+    if (!result) {
+      break;
+    }
+  }
+
+  bool success = (result == test.expected);
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
+/*
+ * Runs a test against the prop1 monitor compiled in by ltlmongen
+ */
+template <typename Table> bool runStaticTest(const Test &test) {
+  cout << "Starting test " << test.name << " (static)" << endl;
+  StaticLTLMonitor<Table> monitor;
+  LTLMonitor compiled;
+  compiled.initialize<Table>();
+
   cout << "Property: " << monitor.getProperty() << endl;
   bool result = true;
   for (const auto &event : test.events) {
     result = monitor.step(event);
+    bool expected = compiled.step(event);
     cout << "step[" << event << "] -> " << result << endl;
+    if (result != expected) {
+      cout << "Static and compiled monitors disagree" << endl;
+      result = !test.expected;
+      break;
+    }
     if (!result) {
       break;
     }
@@ -71,12 +200,768 @@ bool runTest(const Test &test) {
   return success;
 }
 
+/*
+ * Minimizes a monitor for prop1 with a duplicated initial state, a
+ * duplicated accepting state and an unreachable state, and checks that it
+ * is reduced to the three states of tests/prop1.mon with the same verdicts
+ */
+bool runMinimizeTest() {
+  cout << "Starting test minimize" << endl;
+  std::vector<State> states = {{"(-1, 1)", State::VIOLATION},
+                               {"(0, 0)", State::INCONCLUSIVE},
+                               {"(0, 0)'", State::INCONCLUSIVE},
+                               {"(1, -1)", State::ACCEPT},
+                               {"(1, -1)'", State::ACCEPT},
+                               {"unreachable", State::INCONCLUSIVE}};
+  std::vector<string> actions = {"at_destination", "drop_supplies", "hover"};
+  const LTLMonitor::IndexT I = LTLMonitor::INVALID;
+  std::vector<int32_t> table = {0, 0, 0, //
+                                3, 0, 2, //
+                                4, 0, 1, //
+                                3, 3, 3, //
+                                4, 4, 4, //
+                                1, I, 5};
+  const string property("! drop_supplies U at_destination");
+  LTLMonitor original;
+  auto automaton = make_shared<MonitorAutomaton>();
+  if (!original.initialize(property, states, actions, table, 1) ||
+      !automaton->initialize(property, states, actions, table, 1)) {
+    cout << "Could not build monitor" << endl;
+    return false;
+  }
+  auto stats = automaton->minimize();
+  cout << "States: " << stats.statesBefore << " -> " << stats.statesAfter
+       << ", table bytes: " << stats.tableBytesBefore << " -> "
+       << stats.tableBytesAfter << endl;
+
+  bool success = (stats.statesAfter == 3 &&
+                  automaton->getState(0).name == "(0, 0)");
+  for (const auto &test : tests) {
+    LTLMonitor minimized(automaton);
+    LTLMonitor unminimized(original);
+    for (const auto &event : test.events) {
+      bool result = minimized.step(event);
+      success = success && (result == unminimized.step(event));
+      if (!result) {
+        break;
+      }
+    }
+  }
+
+  cout << "Test minimize: " << ((success) ? "SUCCESS" : "FAILED") << endl;
+  return success;
+}
+
+/*
+ * Checks that automata which differ only in one transition or in the name of
+ * one state have different fingerprints, so a checkpoint of one is not
+ * restored into the other
+ */
+bool runFingerprintTest() {
+  cout << "Starting test fingerprint" << endl;
+  std::vector<State> states = {{"(-1, 1)", State::VIOLATION},
+                               {"(0, 0)", State::INCONCLUSIVE},
+                               {"(1, -1)", State::ACCEPT}};
+  std::vector<string> actions = {"at_destination", "drop_supplies"};
+  std::vector<int32_t> table = {0, 0, 2, 0, 2, 2};
+  const string property("! drop_supplies U at_destination");
+  MonitorAutomaton original, retargeted, renamed;
+  std::vector<int32_t> otherTable = table;
+  otherTable[2] = 1;
+  std::vector<State> otherStates = states;
+  otherStates[2].name = "(1, 1)";
+  bool success =
+      original.initialize(property, states, actions, table, 1) &&
+      retargeted.initialize(property, states, actions, otherTable, 1) &&
+      renamed.initialize(property, otherStates, actions, table, 1) &&
+      original.getFingerprint() != retargeted.getFingerprint() &&
+      original.getFingerprint() != renamed.getFingerprint();
+
+  cout << "Test fingerprint: " << ((success) ? "SUCCESS" : "FAILED") << endl;
+  return success;
+}
+
+/*
+ * Runs a timed test on tests/timed.mon, and on a minimized copy of it that
+ * must keep the clock constraints
+ */
+bool runTimedTest(const TimedTest &test, bool minimize) {
+  cout << "Starting test " << test.name << ((minimize) ? " (minimized)" : "")
+       << endl;
+  TimedLTLMonitor monitor;
+  if (!monitor.initialize("tests/timed.mon", minimize)) {
+    cout << "Could not load monitor from tests/timed.mon" << endl;
+    return false;
+  }
+
+  bool result = true;
+  for (const auto &event : test.events) {
+    result = monitor.step(event.first, event.second);
+    cout << "step[" << event.first << "@" << event.second << "] -> " << result
+         << endl;
+    if (!result) {
+      break;
+    }
+  }
+
+  bool success = (result == test.expected &&
+                  monitor.getAutomaton().getClockConstraints().size() == 2);
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
+/*
+ * Checks deadlines without events
+ */
+bool runDeadlineTest() {
+  cout << "Starting test deadline" << endl;
+  TimedLTLMonitor monitor;
+  if (!monitor.initialize("tests/timed.mon")) {
+    cout << "Could not load monitor from tests/timed.mon" << endl;
+    return false;
+  }
+
+  monitor.start(1000);
+  bool success = monitor.nextDeadline() == 3601000;
+  success = success && monitor.step("takeoff", 2000) &&
+            monitor.nextDeadline() == 32000 && monitor.advance(32000) &&
+            !monitor.advance(32001) && monitor.nextDeadline() == 3601000 &&
+            monitor.step("at_destination", 40000) &&
+            monitor.step("drop_supplies", 50000) &&
+            monitor.nextDeadline() == TimedLTLMonitor::NO_DEADLINE &&
+            !monitor.step("nop", 49000);
+
+  cout << "Test deadline: " << ((success) ? "SUCCESS" : "FAILED") << endl;
+  return success;
+}
+
+/*
+ * Lets more triggers wait than the monitor makes room for up front, resumes
+ * them from a checkpoint, and checks that a declared pending bound is a
+ * violation once exceeded
+ */
+bool runPendingTest() {
+  cout << "Starting test pending" << endl;
+  TimedLTLMonitor monitor;
+  if (!monitor.initialize("tests/timed.mon")) {
+    cout << "Could not load monitor from tests/timed.mon" << endl;
+    return false;
+  }
+  monitor.start(0);
+  bool success = true;
+  for (int i = 1; i <= 4 * int(TimedLTLMonitor::DEFAULT_PENDING); ++i) {
+    success = monitor.step("takeoff", i) && success;
+  }
+
+  auto checkpointFile =
+      filesystem::temp_directory_path() / "pending_checkpoint.bin";
+  TimedSnapshots timed;
+  timed["mission"].push_back(monitor.snapshot());
+  std::vector<MonitorSnapshot> snapshots;
+  InstanceSnapshots instances;
+  TimedLTLMonitor restored;
+  success = success && restored.initialize("tests/timed.mon") &&
+            writeCheckpoint(checkpointFile, {}, {}, timed) &&
+            readCheckpoint(checkpointFile, snapshots, instances, timed) &&
+            timed.size() == 1 && restored.restore(timed["mission"][0]) &&
+            restored.nextDeadline() == 30001 &&
+            restored.step("at_destination", 20000) &&
+            restored.nextDeadline() == 3600000;
+
+  auto boundedFile = filesystem::temp_directory_path() / "pending.mon";
+  ifstream input("tests/timed.mon");
+  ofstream output(boundedFile);
+  string line;
+  while (getline(input, line)) {
+    output << line << (line.rfind("arrive,", 0) == 0 ? ",2" : "") << endl;
+  }
+  output.close();
+  TimedLTLMonitor bounded;
+  success = success && bounded.initialize(boundedFile) &&
+            bounded.step("takeoff", 1) && bounded.step("takeoff", 2) &&
+            !bounded.step("takeoff", 3) &&
+            bounded.step("at_destination", 4) && bounded.step("takeoff", 5);
+
+  cout << "Test pending: " << ((success) ? "SUCCESS" : "FAILED") << endl;
+  return success;
+}
+
+/*
+ * Steps one monitor, and a bank holding it twice, from several threads with
+ * an action that always changes the state. A lost update would leave them in
+ * the wrong state of the cycle.
+ */
+bool runConcurrentTest() {
+  const int THREADS = 8;
+  const int STEPS = 20000;
+  const int BATCH = 4;
+  const int STATES = 7;
+  cout << "Starting test concurrent (" << THREADS << " threads)" << endl;
+  std::vector<State> states;
+  std::vector<int32_t> table;
+  for (int s = 0; s < STATES; ++s) {
+    states.push_back(State{"(" + to_string(s) + ")", State::INCONCLUSIVE});
+    table.push_back((s + 1) % STATES);
+  }
+  LTLMonitor monitor;
+  LTLMonitorBank bank;
+  LTLMonitorBank batched;
+  if (!monitor.initialize("G true", states, {"tick"}, table, 0) ||
+      !bank.add(LTLMonitor(monitor)) || !bank.add(LTLMonitor(monitor)) ||
+      !batched.add(LTLMonitor(monitor))) {
+    cout << "Could not build monitor" << endl;
+    return false;
+  }
+
+  atomic<bool> stepsPassed(true);
+  std::vector<thread> threads;
+  for (int t = 0; t < THREADS; ++t) {
+    threads.emplace_back([&] {
+      LTLMonitor::ActionId tick = monitor.internAction("tick");
+      LTLMonitorBank::MaskT violated;
+      for (int i = 0; i < STEPS; ++i) {
+        bank.stepConcurrent(tick, violated);
+        if (!monitor.step(tick) || LTLMonitorBank::anyViolated(violated)) {
+          stepsPassed = false;
+        }
+      }
+      std::vector<LTLMonitor::ActionId> ticks(BATCH, tick);
+      for (int i = 0; i < STEPS; i += BATCH) {
+        batched.stepBatchConcurrent(ticks.data(), ticks.size(), violated);
+        if (LTLMonitorBank::anyViolated(violated)) {
+          stepsPassed = false;
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  const LTLMonitor::IndexT expected = (THREADS * STEPS) % STATES;
+  cout << "Final states: " << monitor.getCurrentState() << ", "
+       << bank.getState(0) << ", " << bank.getState(1) << ", "
+       << batched.getState(0) << " (expected " << expected << ")" << endl;
+  bool success = stepsPassed && monitor.getCurrentState() == expected &&
+                 bank.getState(0) == expected &&
+                 bank.getState(1) == expected &&
+                 batched.getState(0) == expected;
+  cout << "Test concurrent: " << ((success) ? "SUCCESS" : "FAILED") << endl;
+  return success;
+}
+
+/*
+ * Steps a monitor and a bank through the first half of a test, saves their
+ * states to a checkpoint file, with the monitor also saved as the instance
+ * of a key, and finishes the test on newly loaded copies restored from it,
+ * as the broker does after a restart
+ */
+bool runCheckpointTest(const Test &test) {
+  cout << "Starting test " << test.name << " (checkpoint)" << endl;
+  LTLMonitor monitor;
+  LTLMonitorBank bank;
+  if (!monitor.initialize(test.monFile) || !bank.load(test.monFile)) {
+    cout << "Could not load monitor from " << test.monFile << endl;
+    return false;
+  }
+
+  bool result = true;
+  size_t i = 0;
+  for (; i < test.events.size() / 2 && result; ++i) {
+    result = monitor.step(test.events[i]);
+    bank.step(test.events[i]);
+    cout << "step[" << test.events[i] << "] -> " << result << endl;
+  }
+
+  auto checkpointFile = filesystem::temp_directory_path() /
+                        (test.name + "_checkpoint.bin");
+  std::vector<MonitorSnapshot> snapshots = bank.snapshot();
+  snapshots.push_back(monitor.snapshot());
+  InstanceSnapshots instances;
+  instances[test.name].push_back(monitor.snapshot());
+  if (!writeCheckpoint(checkpointFile, snapshots, instances)) {
+    cout << "Could not write checkpoint " << checkpointFile << endl;
+    return false;
+  }
+
+  LTLMonitor restored;
+  LTLMonitorBank restoredBank;
+  std::vector<MonitorSnapshot> saved;
+  InstanceSnapshots savedInstances;
+  if (!restored.initialize(test.monFile) || !restoredBank.load(test.monFile) ||
+      !readCheckpoint(checkpointFile, saved, savedInstances) ||
+      savedInstances.size() != 1 || savedInstances[test.name].size() != 1 ||
+      savedInstances[test.name][0].state != monitor.getCurrentState() ||
+      !restored.restore(saved.back()) || restoredBank.restore(saved) != 1) {
+    cout << "Could not restore from " << checkpointFile << endl;
+    return false;
+  }
+  cout << "Restored state " << restored.getCurrentState() << endl;
+
+  bool sameState = restored.getCurrentState() == monitor.getCurrentState() &&
+                   restoredBank.getState(0) == bank.getState(0);
+  for (; i < test.events.size() && result; ++i) {
+    result = restored.step(test.events[i]);
+    cout << "step[" << test.events[i] << "] -> " << result << endl;
+  }
+
+  bool success = (sameState && result == test.expected);
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
+/*
+ * Runs a test on a profiled monitor and a profiled bank, checks that both
+ * count the same transitions and unknown actions, and writes the profiles
+ */
+bool runProfileTest(const Test &test) {
+  cout << "Starting test " << test.name << " (profile)" << endl;
+  LTLMonitor monitor;
+  LTLMonitorBank bank;
+  if (!monitor.initialize(test.monFile) || !bank.load(test.monFile)) {
+    cout << "Could not load monitor from " << test.monFile << endl;
+    return false;
+  }
+  monitor.enableProfiling();
+  bank.enableProfiling();
+
+  bool result = true;
+  uint64_t steps = 0;
+  uint64_t unknown = 0;
+  for (const auto &event : test.events) {
+    unknown += (monitor.internAction(event) == LTLMonitor::UNKNOWN_ACTION);
+    ++steps;
+    result = monitor.step(event);
+    bank.step(event);
+    if (!result) {
+      break;
+    }
+  }
+
+  const MonitorProfile &profile = *monitor.getProfile();
+  const MonitorProfile &bankProfile = *bank.getMonitor(0).getProfile();
+  const MonitorAutomaton &automaton = monitor.getAutomaton();
+  uint64_t hits = 0;
+  uint64_t settled = 0;
+  bool same = profile.getUnknownCount() == bankProfile.getUnknownCount();
+  for (LTLMonitor::IndexT s = 0; s < automaton.getStateCount(); ++s) {
+    settled += profile.getSettled(s);
+    same = same && profile.getSettled(s) == bankProfile.getSettled(s);
+    for (LTLMonitor::ActionId a = 0; a < automaton.getActionCount(); ++a) {
+      hits += profile.getHits(s, a);
+      same = same && profile.getHits(s, a) == bankProfile.getHits(s, a);
+    }
+  }
+  cout << "Transitions: " << hits << ", settled: " << settled
+       << ", unknown actions: " << profile.getUnknownCount() << endl;
+
+  auto csvFile = filesystem::temp_directory_path() / (test.name + "_profile.csv");
+  auto jsonFile =
+      filesystem::temp_directory_path() / (test.name + "_profile.json");
+  bool written = monitor.writeProfile(csvFile) && bank.writeProfile(jsonFile) &&
+                 filesystem::file_size(csvFile) > 0 &&
+                 filesystem::file_size(jsonFile) > 0;
+
+  // Quotes in CSV fields are doubled
+  MonitorProfile quotes(monitor.shareAutomaton());
+  quotes.recordUnknown("say \"hi\"");
+  ostringstream csv;
+  quotes.writeCSV(csv, 0);
+  written = written && csv.str().find("0,unknown,,\"say \"\"hi\"\"\",,1\n") !=
+                           string::npos;
+
+  bool success = (result == test.expected && same && written &&
+                  profile.getUnknownCount() == unknown &&
+                  profile.getUnknownActions()["nop"] == unknown &&
+                  hits + settled + unknown == steps);
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
+/*
+ * Runs a test through stepBatch(), checking that it reports the same first
+ * violation as stepping the events one at a time
+ */
+bool runBatchTest(const Test &test) {
+  cout << "Starting test " << test.name << " (batch)" << endl;
+  LTLMonitor monitor;
+  if (!monitor.initialize(test.monFile)) {
+    cout << "Could not load monitor from " << test.monFile << endl;
+    return false;
+  }
+
+  std::vector<LTLMonitor::ActionId> actionIds;
+  for (const auto &event : test.events) {
+    actionIds.push_back(monitor.internAction(event));
+  }
+
+  const MonitorAutomaton &automaton = monitor.getAutomaton();
+  MonitorInstance instance = automaton.newInstance();
+  size_t expectedIndex = LTLMonitor::NO_VIOLATION;
+  for (size_t i = 0; i < actionIds.size(); ++i) {
+    if (!automaton.step(instance, actionIds[i])) {
+      expectedIndex = i;
+      break;
+    }
+  }
+
+  size_t index = monitor.stepBatch(actionIds);
+  bool result = (index == LTLMonitor::NO_VIOLATION);
+  cout << "stepBatch -> " << result << endl;
+  bool success = (result == test.expected && index == expectedIndex &&
+                  monitor.getCurrentState() == instance.state);
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
+/*
+ * Runs a test with a bank holding the test monitor twice; both copies must
+ * give the same verdict as the test expects
+ */
+bool runBankTest(const Test &test) {
+  cout << "Starting test " << test.name << " (bank)" << endl;
+  LTLMonitorBank bank;
+  if (!bank.load(test.monFile) || !bank.load(test.monFile)) {
+    cout << "Could not load monitor from " << test.monFile << endl;
+    return false;
+  }
+
+  bool result = true;
+  for (const auto &event : test.events) {
+    const auto &violated = bank.step(event);
+    result = !LTLMonitorBank::anyViolated(violated);
+    cout << "step[" << event << "] -> " << result << endl;
+    if (!result) {
+      if (violated[0] != 0x3) {
+        cout << "Monitors in the bank disagree" << endl;
+        result = !test.expected;
+      }
+      break;
+    }
+  }
+
+  bool success = (result == test.expected);
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
+/*
+ * Steps a bank through a whole test with one stepBatchConcurrent() call, and
+ * checks each action's mask and the final states against a bank stepped one
+ * action at a time
+ */
+bool runBankBatchTest(const Test &test) {
+  cout << "Starting test " << test.name << " (bank batch)" << endl;
+  LTLMonitorBank batched;
+  LTLMonitorBank single;
+  if (!batched.load(test.monFile) || !batched.load(test.monFile) ||
+      !single.load(test.monFile) || !single.load(test.monFile)) {
+    cout << "Could not load monitor from " << test.monFile << endl;
+    return false;
+  }
+
+  std::vector<string_view> actions(test.events.begin(), test.events.end());
+  LTLMonitorBank::MaskT violated;
+  batched.stepBatchConcurrent(actions, violated);
+
+  const size_t words = batched.maskWords();
+  bool result = true;
+  bool same = violated.size() == actions.size() * words;
+  LTLMonitorBank::MaskT expected;
+  for (size_t e = 0; e < actions.size() && same; ++e) {
+    single.stepConcurrent(actions[e], expected);
+    same = equal(expected.begin(), expected.end(),
+                 violated.begin() + e * words);
+    result = result && !LTLMonitorBank::anyViolated(expected);
+  }
+  cout << "stepBatchConcurrent -> " << result << endl;
+  for (size_t i = 0; i < batched.size() && same; ++i) {
+    same = batched.getState(i) == single.getState(i);
+  }
+
+  bool success = (same && result == test.expected);
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
+/*
+ * Steps random monitors with small, mostly disjoint alphabets one by one and
+ * in banks, with step(), stepConcurrent() and stepBatchConcurrent(). The
+ * banks skip the monitors that don't know an action, and must still give the
+ * same verdicts, including for a monitor that starts in a violation. The
+ * transitions of stepConcurrent() must be those of the monitors that know
+ * the action.
+ */
+bool runIndexTest() {
+  const int MONITORS = 40;
+  const int ACTIONS = 60;
+  const int STATES = 5;
+  const int EVENTS = 5000;
+  const size_t BATCH = 7;
+  cout << "Starting test index (" << MONITORS << " monitors)" << endl;
+  mt19937 rng(7);
+  std::vector<LTLMonitor> monitors(MONITORS + 1);
+  for (int m = 0; m < MONITORS; ++m) {
+    std::vector<State> states;
+    for (int s = 0; s < STATES; ++s) {
+      auto type = (s == STATES - 1) ? State::VIOLATION
+                  : (s == STATES - 2) ? State::ACCEPT
+                                      : State::INCONCLUSIVE;
+      states.push_back(State{"(" + to_string(s) + ")", type});
+    }
+    std::vector<string> actions;
+    for (int a = 0; a < 3; ++a) {
+      actions.push_back("e" + to_string(rng() % ACTIONS));
+    }
+    sort(actions.begin(), actions.end());
+    actions.erase(unique(actions.begin(), actions.end()), actions.end());
+    std::vector<int32_t> table;
+    for (size_t t = 0; t < STATES * actions.size(); ++t) {
+      // Mostly back to the start, so that few monitors stop at a verdict
+      int32_t next = rng() % 8;
+      table.push_back(next < STATES ? next : 0);
+    }
+    monitors[m].initialize("random", states, actions, table, 0);
+  }
+  monitors[MONITORS].initialize("false", {State{"(0)", State::VIOLATION}},
+                                {"e0"}, {0}, 0);
+
+  LTLMonitorBank single;
+  LTLMonitorBank concurrent;
+  LTLMonitorBank batched;
+  for (const auto &monitor : monitors) {
+    if (!single.add(LTLMonitor(monitor.shareAutomaton())) ||
+        !concurrent.add(LTLMonitor(monitor.shareAutomaton())) ||
+        !batched.add(LTLMonitor(monitor.shareAutomaton()))) {
+      cout << "Could not build bank" << endl;
+      return false;
+    }
+  }
+
+  std::vector<string> events;
+  for (int e = 0; e < EVENTS; ++e) {
+    events.push_back("e" + to_string(rng() % (ACTIONS + 5)));
+  }
+
+  bool same = true;
+  size_t violations = 0;
+  LTLMonitorBank::MaskT mask;
+  LTLMonitorBank::MaskT batchMask;
+  std::vector<LTLMonitorBank::Transition> transitions;
+  const size_t words = batched.maskWords();
+  for (size_t begin = 0; begin < events.size() && same; begin += BATCH) {
+    size_t end = min(events.size(), begin + BATCH);
+    std::vector<string_view> batch(events.begin() + begin,
+                                   events.begin() + end);
+    batched.stepBatchConcurrent(batch, batchMask);
+    for (size_t e = begin; e < end && same; ++e) {
+      const auto &violated = single.step(events[e]);
+      transitions.clear();
+      concurrent.stepConcurrent(events[e], mask, &transitions);
+      size_t knowing = 0;
+      for (size_t i = 0; i < monitors.size(); ++i) {
+        knowing += monitors[i].internAction(events[e]) !=
+                   LTLMonitor::UNKNOWN_ACTION;
+      }
+      same = same && transitions.size() == knowing;
+      for (const auto &transition : transitions) {
+        const LTLMonitor &monitor = monitors[transition.monitor];
+        same = same && transition.from == monitor.getCurrentState() &&
+               transition.violated == !LTLMonitor(monitor).step(events[e]);
+      }
+      for (size_t i = 0; i < monitors.size(); ++i) {
+        bool expected = !monitors[i].step(events[e]);
+        violations += expected;
+        same = same && LTLMonitorBank::isViolated(violated, i) == expected &&
+               LTLMonitorBank::isViolated(mask, i) == expected &&
+               LTLMonitorBank::isViolated(
+                   batchMask, (e - begin) * words * 64 + i) == expected;
+      }
+    }
+  }
+  for (size_t i = 0; i < monitors.size() && same; ++i) {
+    LTLMonitor::IndexT expected = monitors[i].getCurrentState();
+    same = single.getState(i) == expected &&
+           concurrent.getState(i) == expected &&
+           batched.getState(i) == expected;
+  }
+
+  cout << "Violations: " << violations << endl;
+  cout << "Test index: " << ((same) ? "SUCCESS" : "FAILED") << endl;
+  return same;
+}
+
+/*
+ * Appends records from several threads to an audit log with small chunks,
+ * reopens it to append more, and reads it back. Texts of up to a few times
+ * AUDIT_TEXT_SIZE must come back whole.
+ */
+bool runAuditTest() {
+  const int THREADS = 4;
+  const int RECORDS = 3000;
+  auto text = [](int t, int i) {
+    return "mission" + to_string(t) + string(i % 80, 'a' + t);
+  };
+  cout << "Starting test audit" << endl;
+  auto path = filesystem::temp_directory_path() / "ltlmonrt_audit.log";
+  filesystem::remove(path);
+
+  bool durable = true;
+  for (int round = 0; round < 2; ++round) {
+    AuditLog log;
+    if (!log.open(path, 64, 1)) {
+      cout << "Could not open audit log " << path << endl;
+      return false;
+    }
+    std::vector<thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+      threads.emplace_back([&log, &text, t] {
+        for (int i = 0; i < RECORDS; ++i) {
+          AuditRecord record = {};
+          record.sequence = log.nextSequence();
+          record.kind = AUDIT_CHECK;
+          record.action = t;
+          record.monitor = i;
+          log.append(record, text(t, i));
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    log.flush();
+    durable = durable && log.getDurableCount() == log.getCount();
+  }
+
+  size_t count = 0;
+  set<uint64_t> sequences;
+  std::vector<int> nextRecord(THREADS, 0);
+  bool valid = readAuditLog(path, [&](const AuditRecord &record,
+                                      const string &recordText) {
+    ++count;
+    sequences.insert(record.sequence);
+    valid = valid && record.kind == AUDIT_CHECK && record.action >= 0 &&
+            record.action < THREADS &&
+            recordText == text(record.action, record.monitor);
+    // Records of one thread are in the order it appended them
+    if (valid) {
+      int &expected = nextRecord[record.action];
+      valid = record.monitor == expected % RECORDS;
+      ++expected;
+    }
+  });
+  filesystem::remove(path);
+
+  const size_t total = 2 * THREADS * RECORDS;
+  bool success = durable && valid && count == total &&
+                 sequences.size() == total && *sequences.begin() == 1 &&
+                 *sequences.rbegin() == total;
+  cout << "Records: " << count << endl;
+  cout << "Test audit: " << ((success) ? "SUCCESS" : "FAILED") << endl;
+  return success;
+}
+
+/*
+ * Runs a test on many instances of the test monitor in an InstanceTable, and
+ * checks that keys can be released and reused
+ */
+bool runInstanceTest(const Test &test) {
+  const InstanceTable::KeyT INSTANCES = 100000;
+  cout << "Starting test " << test.name << " (" << INSTANCES << " instances)"
+       << endl;
+  auto automaton = make_shared<MonitorAutomaton>();
+  if (!automaton->initialize(test.monFile)) {
+    cout << "Could not load monitor from " << test.monFile << endl;
+    return false;
+  }
+
+  InstanceTable table(automaton);
+  for (InstanceTable::KeyT key = 0; key < INSTANCES; ++key) {
+    table.acquire(key);
+  }
+  for (InstanceTable::KeyT key = 0; key < INSTANCES; key += 2) {
+    table.release(key);
+  }
+  bool released = table.find(0) == InstanceTable::NO_SLOT &&
+                  table.size() == INSTANCES / 2;
+  for (InstanceTable::KeyT key = 0; key < INSTANCES; key += 2) {
+    table.acquire(key);
+  }
+  cout << "Memory for " << table.size() << " instances: " << table.memoryBytes()
+       << " bytes" << endl;
+
+  bool success = released && table.size() == INSTANCES &&
+                 table.memoryBytes() < 500000;
+  for (InstanceTable::KeyT key = 0; key < INSTANCES && success; ++key) {
+    bool result = true;
+    InstanceTable::SlotT slot = table.find(key);
+    for (const auto &event : test.events) {
+      result = table.step(slot, automaton->internAction(event));
+      if (!result) {
+        break;
+      }
+    }
+    success = (slot != InstanceTable::NO_SLOT && result == test.expected);
+  }
+
+  cout << "Test " << test.name << ": " << ((success) ? "SUCCESS" : "FAILED")
+       << endl;
+  return success;
+}
+
 int main(int, char **) {
 
   for (const auto &test : tests) {
-    runTest(test);
+    runTest(test, Mode::NAMES);
+    cout << endl;
+    runTest(test, Mode::INTERNED);
+    cout << endl;
+    runTest(test, Mode::IMAGE);
+    cout << endl;
+    runTest(test, Mode::MINIMIZED);
+    cout << endl;
+    runTest(test, Mode::MEMORY);
+    cout << endl;
+    runBatchTest(test);
+    cout << endl;
+    runStaticTest<Prop1Monitor>(test);
+    cout << endl;
+    runBankTest(test);
+    cout << endl;
+    runBankBatchTest(test);
+    cout << endl;
+    runInstanceTest(test);
+    cout << endl;
+    runCheckpointTest(test);
+    cout << endl;
+    runProfileTest(test);
+    cout << endl;
+  }
+  runMinimizeTest();
+  cout << endl;
+  runFingerprintTest();
+  cout << endl;
+  runConcurrentTest();
+  cout << endl;
+  runIndexTest();
+  cout << endl;
+  runAuditTest();
+  cout << endl;
+  for (const auto &test : timedTests) {
+    runTimedTest(test, false);
+    cout << endl;
+    runTimedTest(test, true);
     cout << endl;
   }
+  runDeadlineTest();
+  cout << endl;
+  runPendingTest();
 
   return 0;
 }
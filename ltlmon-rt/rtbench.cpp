@@ -0,0 +1,248 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+/*
+ * Google Benchmark suite for the runtime, over random automata from 1 to 1M
+ * states and 2 to 1k actions: time to load a .mon file with initialize() and
+ * to map a binary image, step() throughput with action names and with
+ * interned ids, and memory used by a loaded monitor.
+ */
+
+#include "ltlmonrt.hpp"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <malloc.h>
+#include <map>
+#include <random>
+
+using namespace std;
+
+static const int EVENTS = 1 << 16;
+
+// Largest table generated, so that every size loads in a few seconds
+static const int64_t MAX_ENTRIES = int64_t(1) << 22;
+
+/*
+ * Random automaton where all states are inconclusive and every transition is
+ * defined, so stepping never stops at a verdict
+ */
+static void randomTables(int states, int actions, vector<State> &stateList,
+                         vector<string> &actionList, vector<int32_t> &table) {
+  mt19937 rng(states * 7919 + actions);
+  uniform_int_distribution<int32_t> stateDist(0, states - 1);
+  for (int s = 0; s < states; ++s) {
+    stateList.push_back(
+        State{"(" + to_string(s) + ", 0)", State::INCONCLUSIVE});
+  }
+  for (int a = 0; a < actions; ++a) {
+    actionList.push_back("action" + to_string(a));
+  }
+  table.resize(int64_t(states) * actions);
+  for (auto &next : table) {
+    next = stateDist(rng);
+  }
+}
+
+/*
+ * Writes the random automaton as a .mon file the first time it is needed
+ */
+static const string &monitorFile(int states, int actions) {
+  static map<pair<int, int>, string> files;
+  auto &path = files[{states, actions}];
+  if (!path.empty()) {
+    return path;
+  }
+
+  vector<State> stateList;
+  vector<string> actionList;
+  vector<int32_t> table;
+  randomTables(states, actions, stateList, actionList, table);
+  path = (filesystem::temp_directory_path() /
+          ("ltlmonrt_bench_" + to_string(states) + "_" + to_string(actions) +
+           ".mon"))
+             .string();
+  ofstream output(path);
+  output << "TLTMON:1\nrandom\n" << states << "\n";
+  for (const auto &state : stateList) {
+    output << "?" << state.name << "\n";
+  }
+  output << actions << "\n";
+  for (const auto &action : actionList) {
+    output << action << "\n";
+  }
+  for (int s = 0; s < states; ++s) {
+    for (int a = 0; a < actions; ++a) {
+      output << s << "," << a << "," << table[int64_t(s) * actions + a]
+             << "\n";
+    }
+  }
+  return path;
+}
+
+static const string &imageFile(int states, int actions) {
+  static map<pair<int, int>, string> files;
+  auto &path = files[{states, actions}];
+  if (path.empty()) {
+    MonitorAutomaton automaton;
+    automaton.initialize(monitorFile(states, actions));
+    string imagePath = monitorFile(states, actions) + "b";
+    automaton.writeImage(imagePath);
+    path = imagePath;
+  }
+  return path;
+}
+
+/*
+ * Loaded automata are kept across benchmark runs so that stepping large
+ * ones does not reparse the file every time
+ */
+static shared_ptr<const MonitorAutomaton> loadedAutomaton(int states,
+                                                          int actions) {
+  static map<pair<int, int>, shared_ptr<const MonitorAutomaton>> automata;
+  auto &automaton = automata[{states, actions}];
+  if (!automaton) {
+    vector<State> stateList;
+    vector<string> actionList;
+    vector<int32_t> table;
+    randomTables(states, actions, stateList, actionList, table);
+    auto loaded = make_shared<MonitorAutomaton>();
+    loaded->initialize("random", stateList, actionList, table, 0);
+    automaton = loaded;
+  }
+  return automaton;
+}
+
+static vector<string> randomEvents(int actions) {
+  mt19937 rng(actions);
+  uniform_int_distribution<int> actionDist(0, actions - 1);
+  vector<string> events;
+  for (int i = 0; i < EVENTS; ++i) {
+    events.push_back("action" + to_string(actionDist(rng)));
+  }
+  return events;
+}
+
+static void setSizeCounters(benchmark::State &state,
+                            const MonitorAutomaton &automaton) {
+  state.counters["states"] = automaton.getStateCount();
+  state.counters["actions"] = automaton.getActionCount();
+  state.counters["table_bytes"] = automaton.getTableBytes();
+}
+
+static void BM_Initialize(benchmark::State &state) {
+  const string &path = monitorFile(state.range(0), state.range(1));
+  for (auto _ : state) {
+    MonitorAutomaton automaton;
+    if (!automaton.initialize(path)) {
+      state.SkipWithError("could not load monitor");
+      return;
+    }
+    benchmark::DoNotOptimize(automaton.getStateCount());
+  }
+  setSizeCounters(state, *loadedAutomaton(state.range(0), state.range(1)));
+}
+
+static void BM_MapImage(benchmark::State &state) {
+  const string &path = imageFile(state.range(0), state.range(1));
+  for (auto _ : state) {
+    MonitorAutomaton automaton;
+    if (!automaton.mapImage(path, false)) {
+      state.SkipWithError("could not map image");
+      return;
+    }
+    benchmark::DoNotOptimize(automaton.getStateCount());
+  }
+  setSizeCounters(state, *loadedAutomaton(state.range(0), state.range(1)));
+}
+
+static void BM_StepString(benchmark::State &state) {
+  LTLMonitor monitor(loadedAutomaton(state.range(0), state.range(1)));
+  vector<string> events = randomEvents(state.range(1));
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(monitor.step(events[i]));
+    i = (i + 1) % events.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  setSizeCounters(state, monitor.getAutomaton());
+}
+
+static void BM_StepInterned(benchmark::State &state) {
+  LTLMonitor monitor(loadedAutomaton(state.range(0), state.range(1)));
+  vector<LTLMonitor::ActionId> events;
+  for (const auto &event : randomEvents(state.range(1))) {
+    events.push_back(monitor.internAction(event));
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(monitor.step(events[i]));
+    i = (i + 1) % events.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  setSizeCounters(state, monitor.getAutomaton());
+}
+
+/*
+ * Heap used by an automaton loaded from a .mon file, with the table and all
+ * the names and maps
+ */
+static void BM_Memory(benchmark::State &state) {
+  const string &path = monitorFile(state.range(0), state.range(1));
+  for (auto _ : state) {
+    size_t before = mallinfo2().uordblks;
+    auto automaton = make_unique<MonitorAutomaton>();
+    automaton->initialize(path);
+    size_t after = mallinfo2().uordblks;
+    state.counters["heap_bytes"] = after - before;
+    state.counters["heap_bytes_per_state"] =
+        double(after - before) / automaton->getStateCount();
+  }
+  setSizeCounters(state, *loadedAutomaton(state.range(0), state.range(1)));
+}
+
+/*
+ * States from 1 to 1M and actions from 2 to 1k, skipping tables larger than
+ * MAX_ENTRIES
+ */
+static void automatonSizes(benchmark::internal::Benchmark *benchmark) {
+  for (int64_t states : {1, 16, 256, 4096, 65536, 1 << 20}) {
+    for (int64_t actions : {2, 16, 128, 1024}) {
+      if (states * actions <= MAX_ENTRIES) {
+        benchmark->Args({states, actions});
+      }
+    }
+  }
+  benchmark->ArgNames({"states", "actions"});
+}
+
+BENCHMARK(BM_Initialize)->Apply(automatonSizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MapImage)->Apply(automatonSizes)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_StepString)->Apply(automatonSizes);
+BENCHMARK(BM_StepInterned)->Apply(automatonSizes);
+BENCHMARK(BM_Memory)->Apply(automatonSizes)->Iterations(1);
+
+BENCHMARK_MAIN();
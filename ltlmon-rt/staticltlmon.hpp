@@ -0,0 +1,92 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef STATICLTLMON_HPP_H
+#define STATICLTLMON_HPP_H
+
+#include "ltlmonrt.hpp"
+#include <string_view>
+
+/*
+ * Monitor over a transition table compiled into the binary by ltlmongen.
+ * Table is the struct generated from a .mon file. Stepping uses no heap, no
+ * file I/O and no parsing, and has the same semantics as LTLMonitor::step().
+ */
+template <typename Table> class StaticLTLMonitor {
+public:
+  using Action = typename Table::Action;
+  using IndexT = typename Table::IndexT;
+
+  constexpr StaticLTLMonitor() : state(Table::initialState) {}
+
+  static constexpr int internAction(std::string_view action) {
+    for (int i = 0; i < Table::actionCount; ++i) {
+      if (action == Table::actionNames[i]) {
+        return i;
+      }
+    }
+    return LTLMonitor::UNKNOWN_ACTION;
+  }
+
+  constexpr bool step(Action action) {
+    return step(static_cast<int>(action));
+  }
+
+  constexpr bool step(std::string_view action) {
+    return step(internAction(action));
+  }
+
+  constexpr bool step(int action) {
+    State::StateType type = Table::stateTypes[state];
+    if (type != State::INCONCLUSIVE) {
+      return type == State::ACCEPT;
+    }
+
+    if (action < 0 || action >= Table::actionCount) {
+      return true;
+    }
+
+    IndexT newState = Table::transitions[state * Table::actionCount + action];
+    if (newState == Table::INVALID_STATE ||
+        Table::stateTypes[newState] == State::VIOLATION) {
+      return false;
+    }
+
+    state = newState;
+    return true;
+  }
+
+  constexpr void reset() { state = Table::initialState; }
+
+  constexpr IndexT getState() const { return state; }
+
+  static constexpr const char *getProperty() { return Table::property; }
+
+private:
+  IndexT state;
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "workpool.hpp"
+
+using namespace std;
+
+/*
+ * Pool and deque index of the worker running on this thread, if any
+ */
+static thread_local const WorkStealingPool *currentPool = nullptr;
+static thread_local unsigned currentIndex = 0;
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+    : queued(0), pending(0), nextQueue(0), stopping(false) {
+  if (threads == 0) {
+    threads = max(1u, thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < threads; ++i) {
+    queues.push_back(make_unique<Queue>());
+  }
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.emplace_back(&WorkStealingPool::run, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  wait();
+  {
+    lock_guard<mutex> lock(idleMutex);
+    stopping = true;
+  }
+  idle.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+unsigned WorkStealingPool::size() const { return workers.size(); }
+
+void WorkStealingPool::submit(Task task) {
+  unsigned index = (currentPool == this)
+                       ? currentIndex
+                       : nextQueue.fetch_add(1) % queues.size();
+  pending.fetch_add(1);
+  {
+    lock_guard<mutex> lock(queues[index]->mutex);
+    queued.fetch_add(1);
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  {
+    // Pairs with the predicate check of idle workers, so none misses a task
+    lock_guard<mutex> lock(idleMutex);
+  }
+  idle.notify_one();
+}
+
+void WorkStealingPool::wait() {
+  unique_lock<mutex> lock(idleMutex);
+  done.wait(lock, [this] { return pending.load() == 0; });
+}
+
+/*
+ * Takes a task from the back of the worker's own deque, or steals one from the
+ * front of another deque
+ */
+bool WorkStealingPool::take(unsigned index, Task &task) {
+  for (unsigned i = 0; i < queues.size(); ++i) {
+    Queue &queue = *queues[(index + i) % queues.size()];
+    lock_guard<mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    queued.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingPool::run(unsigned index) {
+  currentPool = this;
+  currentIndex = index;
+  Task task;
+  while (true) {
+    if (take(index, task)) {
+      task();
+      task = nullptr;
+      if (pending.fetch_sub(1) == 1) {
+        lock_guard<mutex> lock(idleMutex);
+        done.notify_all();
+      }
+      continue;
+    }
+    unique_lock<mutex> lock(idleMutex);
+    idle.wait(lock, [this] { return stopping || queued.load() > 0; });
+    if (stopping && queued.load() == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,98 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef ASYNC_CLIENT_H_H
+#define ASYNC_CLIENT_H_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include <grpcpp/grpcpp.h>
+
+// One completion queue, served by one thread, for the calls that the clients
+// of the mission manager make without waiting for the peer. Each call has a
+// deadline, so a slow or dead peer only delays its own completion callback.
+class AsyncClientQueue {
+public:
+  template <typename Stub, typename Request, typename Reply>
+  using PrepareMethod =
+      std::unique_ptr<grpc::ClientAsyncResponseReader<Reply>> (Stub::*)(
+          grpc::ClientContext *, const Request &, grpc::CompletionQueue *);
+
+  static AsyncClientQueue *getInstance(void);
+
+  AsyncClientQueue(AsyncClientQueue const &) = delete;
+  void operator=(AsyncClientQueue const &) = delete;
+
+  // Starts a unary call with the PrepareAsync method of a stub. done is called
+  // on the queue thread with the status and the reply once the call finishes
+  // or deadline_ms have passed. It must not block, as it holds up the
+  // completion of every other call.
+  template <typename Stub, typename Request, typename Reply, typename Done>
+  void call(Stub *stub, PrepareMethod<Stub, Request, Reply> prepare,
+            const Request &request, long deadline_ms, Done done) {
+    auto *pending = new UnaryCall<Reply>(std::move(done));
+    pending->context.set_deadline(std::chrono::system_clock::now() +
+                                  std::chrono::milliseconds(deadline_ms));
+    pending->reader = (stub->*prepare)(&pending->context, request, &queue_);
+    pending->reader->StartCall();
+    pending->reader->Finish(&pending->reply, &pending->status, pending);
+  }
+
+private:
+  // A call in flight, which is the tag of its completion
+  struct Call {
+    virtual ~Call() {}
+    virtual void complete(void) = 0;
+  };
+
+  template <typename Reply> struct UnaryCall : Call {
+    explicit UnaryCall(
+        std::function<void(const grpc::Status &, const Reply &)> done)
+        : done(std::move(done)) {}
+    void complete(void) override {
+      if (done) {
+        done(status, reply);
+      }
+    }
+
+    grpc::ClientContext context;
+    Reply reply;
+    grpc::Status status;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<Reply>> reader;
+    std::function<void(const grpc::Status &, const Reply &)> done;
+  };
+
+  grpc::CompletionQueue queue_;
+  std::thread thread_;
+
+  AsyncClientQueue(void);
+  void run(void);
+};
+
+#endif
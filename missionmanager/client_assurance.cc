@@ -27,20 +27,662 @@
 #include "client_assurance.h"
 
 #include "IAssurance.grpc.pb.h"
+#include "async_client.h"
+#include "ltlmonbank.hpp"
+#include <atomic>
 #include <grpcpp/grpcpp.h>
 #include <iostream>
 #include <unistd.h>
 
 using grpc::Channel;
 using grpc::ClientContext;
+using grpc::ClientReader;
+using grpc::ClientReaderWriter;
 using grpc::Status;
 using namespace uav;
 
-bool ClientAssurance::checkState(std::string current_state) {
-  ClientContext context;
+// Time between attempts to subscribe while the broker can't be reached
+static const long RESUBSCRIBE_MS = 1000;
+
+// Deadline of a checkState call, after which its action has no verdict
+static const long CHECK_DEADLINE_MS = 1000;
+
+// Deadline of the calls of the replicator, so a broker that went away does
+// not hold up the next report
+static const long REPLICA_DEADLINE_MS = 1000;
+
+// Verdicts kept for the broker while it can't be reached; later ones are
+// only counted
+static const size_t MAX_UNREPORTED = 1024;
+
+// Monitor tables fetched from the broker, replaced as a whole when it has
+// another version. Checks come from several threads, so the bank is stepped
+// with stepConcurrent().
+struct ClientAssurance::Replica {
+  uint64_t version = 0;
+  LTLMonitorBank bank;
+  // Per monitor, whether its property was reported satisfied
+  std::unique_ptr<std::atomic<bool>[]> accepted;
+  std::atomic<uint64_t> events{0};
+};
+
+static bool IsAccepting(const LTLMonitorBank &bank, size_t monitor) {
+  return bank.getMonitor(monitor).getAutomaton().getStateType(
+             bank.getState(monitor)) == State::ACCEPT;
+}
+
+static std::chrono::system_clock::time_point ReplicaDeadline() {
+  return std::chrono::system_clock::now() +
+         std::chrono::milliseconds(REPLICA_DEADLINE_MS);
+}
+
+ClientAssurance::~ClientAssurance() {
+  {
+    std::lock_guard<std::mutex> lock(replica_mutex_);
+    replica_stopping_ = true;
+  }
+  replica_wake_.notify_one();
+  if (replicator_.joinable()) {
+    replicator_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(subscribe_mutex_);
+    subscribe_stopping_ = true;
+    if (subscribe_context_) {
+      subscribe_context_->TryCancel();
+    }
+  }
+  subscribe_retry_.notify_one();
+  if (subscriber_.joinable()) {
+    subscriber_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    batch_stopping_ = true;
+  }
+  batch_ready_.notify_one();
+  if (batcher_.joinable()) {
+    batcher_.join();
+  }
+  {
+    std::lock_guard<std::mutex> writeLock(write_mutex_);
+    bool open;
+    {
+      std::lock_guard<std::mutex> lock(stream_mutex_);
+      open = !stream_closed_;
+    }
+    if (open) {
+      stream_->WritesDone();
+    }
+  }
+  if (reader_.joinable()) {
+    reader_.join();
+  }
+}
+
+// Queues a checkState call, which starts when the previous one finishes
+void ClientAssurance::sendUnary(PendingCheck &check) {
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    unary_.push_back(check);
+    if (unary_.size() > 1) {
+      return;
+    }
+  }
+  startUnary(check.action);
+}
+
+void ClientAssurance::startUnary(const std::string &current_state) {
   ::google::protobuf::StringValue request;
-  ::google::protobuf::BoolValue reply;
   request.set_value(current_state);
-  Status status = stub_->checkState(&context, request, &reply);
-  return reply.value();
+  AsyncClientQueue::getInstance()->call(
+      stub_.get(), &Assurance::Stub::PrepareAsynccheckState, request,
+      CHECK_DEADLINE_MS,
+      [this](const Status &status, const ::google::protobuf::BoolValue &reply) {
+        finishUnary(status, reply.value());
+      });
+}
+
+// Called on the AsyncClientQueue thread when the first queued call finishes
+void ClientAssurance::finishUnary(const Status &status, bool verdict) {
+  PendingCheck check;
+  bool more;
+  std::string next;
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    check = std::move(unary_.front());
+    unary_.pop_front();
+    more = !unary_.empty();
+    if (more) {
+      next = unary_.front().action;
+    }
+  }
+  if (more) {
+    startUnary(next);
+  }
+  if (!status.ok()) {
+    std::cout << "No verdict for action " << check.action << ": "
+              << status.error_message() << std::endl;
+    verdict = false;
+  }
+  deliver(check, verdict);
+}
+
+bool ClientAssurance::checkState(std::string current_state) {
+  return send(current_state, true)->get_future().get();
+}
+
+std::future<bool> ClientAssurance::checkStateAsync(std::string current_state) {
+  return send(current_state, true)->get_future();
+}
+
+void ClientAssurance::postState(std::string current_state) {
+  send(current_state, false);
+}
+
+void ClientAssurance::setVerdictHandler(
+    std::function<void(const std::string &, bool)> handler) {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  verdict_handler_ = handler;
+}
+
+// Sends the action on the stream, opening it if needed. Falls back to a unary
+// call if streaming is off or the stream is broken.
+std::shared_ptr<std::promise<bool>>
+ClientAssurance::send(const std::string &current_state, bool wait) {
+  PendingCheck check{current_state,
+                     (wait) ? std::make_shared<std::promise<bool>>()
+                            : nullptr};
+  std::shared_ptr<std::promise<bool>> waiter = check.waiter;
+  if (stepReplica(check) || queue(check)) {
+    return waiter;
+  }
+  {
+    // write_mutex_ keeps the writes in the order of pending_; stream_mutex_
+    // is not held while writing, as the reader thread needs it to pop
+    std::lock_guard<std::mutex> writeLock(write_mutex_);
+    bool pushed = false;
+    uint64_t closes = 0;
+    {
+      std::unique_lock<std::mutex> lock(stream_mutex_);
+      if (use_stream_ && stream_closed_) {
+        lock.unlock();
+        openStream();
+        lock.lock();
+      }
+      if (use_stream_ && !stream_closed_) {
+        pending_.push_back(check);
+        pushed = true;
+        closes = stream_closes_;
+      }
+    }
+    if (pushed) {
+      ::google::protobuf::StringValue request;
+      request.set_value(current_state);
+      if (stream_->Write(request)) {
+        return waiter;
+      }
+      // The reader thread finds out that the stream is broken and closes it.
+      // If it already has, it took the check and answers it.
+      std::lock_guard<std::mutex> lock(stream_mutex_);
+      if (stream_closes_ != closes) {
+        return waiter;
+      }
+      pending_.pop_back();
+    }
+  }
+  sendUnary(check);
+  return waiter;
+}
+
+// Opens the stream and starts reading verdicts. Called with write_mutex_
+// held and stream_mutex_ not held, since the old reader may need it to finish.
+void ClientAssurance::openStream() {
+  if (reader_.joinable()) {
+    reader_.join();
+  }
+  stream_context_ = std::make_unique<ClientContext>();
+  stream_ = stub_->checkStateStream(stream_context_.get());
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    stream_closed_ = false;
+  }
+  reader_ = std::thread(&ClientAssurance::readVerdicts, this);
+}
+
+void ClientAssurance::readVerdicts() {
+  ::google::protobuf::BoolValue verdict;
+  while (stream_->Read(&verdict)) {
+    PendingCheck check;
+    {
+      std::lock_guard<std::mutex> lock(stream_mutex_);
+      check = std::move(pending_.front());
+      pending_.pop_front();
+    }
+    deliver(check, verdict.value());
+  }
+
+  std::deque<PendingCheck> unanswered;
+  bool unimplemented;
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    Status status = stream_->Finish();
+    unimplemented = status.error_code() == grpc::StatusCode::UNIMPLEMENTED;
+    if (unimplemented) {
+      std::cout << "Assurance broker has no checkStateStream, using "
+                   "checkState"
+                << std::endl;
+      use_stream_ = false;
+    } else if (!status.ok()) {
+      std::cout << "Assurance stream closed: " << status.error_message()
+                << std::endl;
+    }
+    unanswered.swap(pending_);
+    stream_closed_ = true;
+    stream_closes_++;
+  }
+  // A broker without the stream has not seen the checks, so they are sent
+  // again. Otherwise it may have applied them, so they are not; waiting
+  // callers get false as with a failed checkState.
+  for (auto &check : unanswered) {
+    if (unimplemented) {
+      sendUnary(check);
+      continue;
+    }
+    std::cout << "No verdict for action " << check.action << std::endl;
+    if (check.waiter) {
+      check.waiter->set_value(false);
+    }
+  }
+}
+
+void ClientAssurance::deliver(PendingCheck &check, bool verdict) {
+  std::function<void(const std::string &, bool)> handler;
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    handler = verdict_handler_;
+  }
+  if (handler) {
+    handler(check.action, verdict);
+  } else if (!verdict) {
+    std::cout << "Assurance broker reports a violation for action "
+              << check.action << std::endl;
+  }
+  if (check.waiter) {
+    check.waiter->set_value(verdict);
+  }
+}
+
+void ClientAssurance::enableBatching(size_t max_events,
+                                     std::chrono::microseconds max_delay,
+                                     const std::string &mission_id) {
+  std::lock_guard<std::mutex> lock(batch_mutex_);
+  batch_size_ = std::max<size_t>(1, max_events);
+  batch_delay_ = max_delay;
+  mission_id_ = mission_id;
+  batching_ = true;
+  if (!batcher_.joinable()) {
+    batcher_ = std::thread(&ClientAssurance::sendBatches, this);
+  }
+}
+
+// Adds the action to the current batch if batching is on. A checkState()
+// call sends the batch right away, so that it does not wait for the delay.
+bool ClientAssurance::queue(PendingCheck &check) {
+  {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    if (!batching_) {
+      return false;
+    }
+    if (batch_checks_.empty()) {
+      batch_start_ = std::chrono::steady_clock::now();
+    }
+    Event *event = batch_.add_events();
+    event->set_action(check.action);
+    event->set_missionid(mission_id_);
+    event->set_timestamp(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    batch_checks_.push_back(check);
+    batch_flush_ = batch_flush_ || check.waiter != nullptr;
+    if (batch_checks_.size() < batch_size_ && !batch_flush_) {
+      return true;
+    }
+  }
+  batch_ready_.notify_one();
+  return true;
+}
+
+void ClientAssurance::sendBatches() {
+  std::unique_lock<std::mutex> lock(batch_mutex_);
+  while (true) {
+    if (batch_checks_.empty()) {
+      if (batch_stopping_) {
+        return;
+      }
+      batch_ready_.wait(lock);
+      continue;
+    }
+    auto deadline = batch_start_ + batch_delay_;
+    if (batch_checks_.size() < batch_size_ && !batch_flush_ &&
+        !batch_stopping_ && std::chrono::steady_clock::now() < deadline) {
+      batch_ready_.wait_until(lock, deadline);
+      continue;
+    }
+
+    Events events;
+    events.Swap(&batch_);
+    std::vector<PendingCheck> checks;
+    checks.swap(batch_checks_);
+    batch_flush_ = false;
+    lock.unlock();
+    sendBatch(events, checks);
+    lock.lock();
+  }
+}
+
+void ClientAssurance::sendBatch(Events &events,
+                                std::vector<PendingCheck> &checks) {
+  ClientContext context;
+  Verdicts verdicts;
+  Status status = stub_->checkStates(&context, events, &verdicts);
+  if (status.ok() && verdicts.verdicts_size() == (int)checks.size()) {
+    for (size_t i = 0; i < checks.size(); ++i) {
+      deliver(checks[i], verdicts.verdicts(i).value());
+    }
+    return;
+  }
+
+  // As with the stream, a broker without checkStates has not seen the
+  // actions, so they are sent again one by one
+  if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+    std::cout << "Assurance broker has no checkStates, sending actions one "
+                 "by one"
+              << std::endl;
+    {
+      std::lock_guard<std::mutex> lock(batch_mutex_);
+      batching_ = false;
+    }
+    for (auto &check : checks) {
+      sendUnary(check);
+    }
+    return;
+  }
+  std::cout << "Assurance batch failed: " << status.error_message()
+            << std::endl;
+  for (auto &check : checks) {
+    std::cout << "No verdict for action " << check.action << std::endl;
+    if (check.waiter) {
+      check.waiter->set_value(false);
+    }
+  }
+}
+
+void ClientAssurance::subscribeVerdicts(
+    const std::string &mission_id, bool untagged,
+    std::function<void(const PropertyVerdict &)> handler) {
+  std::lock_guard<std::mutex> lock(subscribe_mutex_);
+  if (subscriber_.joinable()) {
+    return;
+  }
+  subscriber_handler_ = handler;
+  Subscription subscription;
+  subscription.set_missionid(mission_id);
+  subscription.set_untagged(untagged);
+  subscriber_ = std::thread(&ClientAssurance::receiveVerdicts, this,
+                            subscription, handler);
+}
+
+void ClientAssurance::receiveVerdicts(
+    Subscription subscription,
+    std::function<void(const PropertyVerdict &)> handler) {
+  while (true) {
+    ClientContext *context;
+    {
+      std::lock_guard<std::mutex> lock(subscribe_mutex_);
+      if (subscribe_stopping_) {
+        return;
+      }
+      subscribe_context_ = std::make_unique<ClientContext>();
+      context = subscribe_context_.get();
+      // Waits for the broker instead of failing while it is not up
+      context->set_wait_for_ready(true);
+    }
+    std::unique_ptr<ClientReader<PropertyVerdict>> reader =
+        stub_->subscribeVerdicts(context, subscription);
+    PropertyVerdict verdict;
+    while (reader->Read(&verdict)) {
+      if (verdict.dropped() > 0) {
+        std::cout << "Missed " << verdict.dropped()
+                  << " verdicts of the assurance broker" << std::endl;
+      }
+      if (verdict.replica()) {
+        // Those of this client's replica were handled when they were found
+        std::lock_guard<std::mutex> lock(replica_mutex_);
+        if (replicating_ && verdict.missionid() == replica_mission_) {
+          continue;
+        }
+      }
+      handler(verdict);
+    }
+    Status status = reader->Finish();
+    if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+      std::cout << "Assurance broker has no subscribeVerdicts" << std::endl;
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(subscribe_mutex_);
+    subscribe_retry_.wait_for(lock, std::chrono::milliseconds(RESUBSCRIBE_MS),
+                              [this] { return subscribe_stopping_; });
+  }
+}
+
+void ClientAssurance::enableReplica(const std::string &mission_id,
+                                    std::chrono::milliseconds report_period) {
+  std::lock_guard<std::mutex> lock(replica_mutex_);
+  if (replicator_.joinable()) {
+    return;
+  }
+  replica_mission_ = mission_id;
+  report_period_ = report_period;
+  replicating_ = true;
+  replicator_ = std::thread(&ClientAssurance::replicate, this);
+}
+
+// Checks the action against the local tables, if they have been fetched.
+// Violations and newly satisfied properties are handed to the subscriber and
+// kept for the next report.
+bool ClientAssurance::stepReplica(PendingCheck &check) {
+  std::shared_ptr<Replica> replica = std::atomic_load(&replica_);
+  if (replica == nullptr) {
+    return false;
+  }
+  LTLMonitorBank::MaskT violated;
+  replica->bank.stepConcurrent(check.action, violated);
+  replica->events.fetch_add(1, std::memory_order_relaxed);
+  bool result = !LTLMonitorBank::anyViolated(violated);
+
+  std::vector<PropertyVerdict> found;
+  for (size_t i = 0; i < replica->bank.size(); ++i) {
+    PropertyVerdict::Kind kind;
+    if (LTLMonitorBank::isViolated(violated, i)) {
+      kind = PropertyVerdict::VIOLATION;
+    } else if (IsAccepting(replica->bank, i) &&
+               !replica->accepted[i].exchange(true,
+                                              std::memory_order_relaxed)) {
+      kind = PropertyVerdict::ACCEPTANCE;
+    } else {
+      continue;
+    }
+    found.emplace_back();
+    PropertyVerdict &verdict = found.back();
+    verdict.set_kind(kind);
+    verdict.set_property(replica->bank.getMonitor(i).getProperty());
+    verdict.set_missionid(replica_mission_);
+    verdict.set_action(check.action);
+    verdict.set_timestamp(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    verdict.set_replica(true);
+  }
+
+  if (!found.empty()) {
+    std::function<void(const PropertyVerdict &)> handler;
+    {
+      std::lock_guard<std::mutex> lock(subscribe_mutex_);
+      handler = subscriber_handler_;
+    }
+    {
+      std::lock_guard<std::mutex> lock(replica_mutex_);
+      for (const auto &verdict : found) {
+        if (unreported_.size() < MAX_UNREPORTED) {
+          unreported_.push_back(verdict);
+        } else {
+          ++unreported_dropped_;
+        }
+      }
+    }
+    for (const auto &verdict : found) {
+      if (handler) {
+        handler(verdict);
+      }
+    }
+  }
+  deliver(check, result);
+  return true;
+}
+
+// Fetches the tables, then reports every report period until the client is
+// destroyed. The tables are fetched again when the broker serves another
+// version, or retried while they could not be fetched.
+void ClientAssurance::replicate() {
+  std::unique_lock<std::mutex> lock(replica_mutex_);
+  while (!replica_stopping_) {
+    lock.unlock();
+    std::shared_ptr<Replica> current = std::atomic_load(&replica_);
+    uint64_t served = 0;
+    if ((current == nullptr ||
+         (reportReplica(*current, served) && served != current->version)) &&
+        !fetchTables(current)) {
+      lock.lock();
+      replicating_ = false;
+      return;
+    }
+    lock.lock();
+    replica_wake_.wait_for(lock, report_period_,
+                           [this] { return replica_stopping_; });
+  }
+  lock.unlock();
+
+  // Hands the last verdicts over if the broker is there
+  std::shared_ptr<Replica> current = std::atomic_load(&replica_);
+  uint64_t served;
+  if (current != nullptr) {
+    reportReplica(*current, served);
+  }
+}
+
+// Replaces the local tables with those of the broker. The monitors of an
+// automaton that did not change keep their state. Checks that run during
+// the swap may only step the old tables. Returns false if the tables can't
+// be checked here at all, in which case actions keep going to the broker.
+bool ClientAssurance::fetchTables(const std::shared_ptr<Replica> &current) {
+  ClientContext context;
+  context.set_deadline(ReplicaDeadline());
+  MonitorTables tables;
+  Status status = stub_->getMonitorTables(
+      &context, ::google::protobuf::Empty(), &tables);
+  if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+    std::cout << "Assurance broker has no getMonitorTables, checking actions "
+                 "remotely"
+              << std::endl;
+    return false;
+  }
+  if (!status.ok()) {
+    return true;
+  }
+
+  auto replica = std::make_shared<Replica>();
+  replica->version = tables.version();
+  for (const auto &table : tables.tables()) {
+    LTLMonitor monitor;
+    if (!monitor.readImage(table.image().data(), table.image().size()) ||
+        !replica->bank.add(std::move(monitor))) {
+      std::cout << "Could not load the monitor table of "
+                << table.property() << ", checking actions remotely"
+                << std::endl;
+      return false;
+    }
+  }
+  if (current != nullptr) {
+    replica->bank.restore(current->bank.snapshot());
+    replica->events.store(current->events.load());
+  }
+  replica->accepted.reset(new std::atomic<bool>[replica->bank.size()]);
+  for (size_t i = 0; i < replica->bank.size(); ++i) {
+    replica->accepted[i].store(IsAccepting(replica->bank, i),
+                               std::memory_order_relaxed);
+  }
+  std::atomic_store(&replica_, replica);
+  std::cout << "Checking " << replica->bank.size()
+            << " monitor tables of version " << replica->version
+            << " locally" << std::endl;
+  return true;
+}
+
+// Sends the unreported verdicts and the monitor states. served is set to
+// the version of the tables the broker has if it answered. Verdicts that
+// could not be sent are kept for the next report.
+bool ClientAssurance::reportReplica(const Replica &replica, uint64_t &served) {
+  std::vector<PropertyVerdict> verdicts;
+  uint64_t dropped;
+  {
+    std::lock_guard<std::mutex> lock(replica_mutex_);
+    verdicts.swap(unreported_);
+    dropped = unreported_dropped_;
+    unreported_dropped_ = 0;
+  }
+  ReplicaReport report;
+  report.set_missionid(replica_mission_);
+  report.set_version(replica.version);
+  for (const auto &verdict : verdicts) {
+    *report.add_verdicts() = verdict;
+  }
+  report.set_dropped(dropped);
+  for (size_t i = 0; i < replica.bank.size(); ++i) {
+    report.add_states(replica.bank.getState(i));
+  }
+  report.set_events(replica.events.load(std::memory_order_relaxed));
+
+  ClientContext context;
+  context.set_deadline(ReplicaDeadline());
+  ReplicaStatus status;
+  Status result = stub_->reportReplica(&context, report, &status);
+  if (!result.ok()) {
+    {
+      std::lock_guard<std::mutex> lock(replica_mutex_);
+      verdicts.insert(verdicts.end(), unreported_.begin(), unreported_.end());
+      unreported_.swap(verdicts);
+      if (unreported_.size() > MAX_UNREPORTED) {
+        dropped += unreported_.size() - MAX_UNREPORTED;
+        unreported_.resize(MAX_UNREPORTED);
+      }
+      unreported_dropped_ += dropped;
+    }
+    if (replica_reachable_) {
+      std::cout << "Assurance broker can't be reached, checking actions "
+                   "locally: "
+                << result.error_message() << std::endl;
+      replica_reachable_ = false;
+    }
+    return false;
+  }
+  if (!replica_reachable_) {
+    std::cout << "Assurance broker reached again" << std::endl;
+    replica_reachable_ = true;
+  }
+  served = status.version();
+  return true;
 }
@@ -33,43 +33,192 @@
 
 using Poco::Logger;
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 #include "IAssurance.grpc.pb.h"
 #include "IAssurance.h"
+#include "async_client.h"
 #include <grpcpp/grpcpp.h>
 
 using grpc::Channel;
 using grpc::ClientContext;
+using grpc::ClientReader;
+using grpc::ClientReaderWriter;
 using grpc::Status;
 using namespace uav;
 
-// Client GRPC class that talks to the Assurance component
+// Client GRPC class that talks to the Assurance component. By default the
+// actions are sent over one long-lived checkStateStream call, and a reader
+// thread receives the verdicts. If the broker does not implement the stream,
+// the client falls back to one checkState call per action, made on the
+// AsyncClientQueue one at a time so that they stay in order. In batching mode,
+// actions are sent in batches with checkStates instead. In replica mode, the
+// monitors of the broker are fetched with getMonitorTables and stepped here.
 class ClientAssurance : public IAssurance {
 
 private:
+  // Verdicts come back in the order the actions were sent. waiter is set for
+  // checkState() calls, which block until their verdict arrives.
+  struct PendingCheck {
+    std::string action;
+    std::shared_ptr<std::promise<bool>> waiter;
+  };
+
   std::unique_ptr<Assurance::Stub> stub_;
+  bool use_stream_;
+
+  // Guards the pending checks and the stream state; the reader thread takes
+  // it for every verdict, so it is never held while writing
+  std::mutex stream_mutex_;
+  // Serializes opening, writing and closing the stream, so checks are written
+  // in the order they are pushed to pending_
+  std::mutex write_mutex_;
+  std::unique_ptr<ClientContext> stream_context_;
+  std::unique_ptr<ClientReaderWriter<::google::protobuf::StringValue,
+                                     ::google::protobuf::BoolValue>>
+      stream_;
+  bool stream_closed_;
+  // Counts the times the reader thread closed the stream and took the
+  // pending checks
+  uint64_t stream_closes_ = 0;
+  std::deque<PendingCheck> pending_;
+  // Checks sent with checkState; the first is in flight
+  std::deque<PendingCheck> unary_;
+  std::thread reader_;
+  std::function<void(const std::string &, bool)> verdict_handler_;
+
+  // Batching mode: actions wait in batch_ until there are batch_size_ of
+  // them, the oldest has waited batch_delay_, or a checkState() needs its
+  // verdict, and the batcher_ thread then sends them with one checkStates
+  // call
+  std::mutex batch_mutex_;
+  std::condition_variable batch_ready_;
+  bool batching_;
+  bool batch_stopping_;
+  bool batch_flush_;
+  size_t batch_size_;
+  std::chrono::microseconds batch_delay_;
+  std::string mission_id_;
+  Events batch_;
+  std::vector<PendingCheck> batch_checks_;
+  std::chrono::steady_clock::time_point batch_start_;
+  std::thread batcher_;
 
-  ClientAssurance(const std::string &client_addr_port)
+  // Verdict subscription, read by the subscriber_ thread. The context of the
+  // current call is kept so that the destructor can cancel it.
+  std::mutex subscribe_mutex_;
+  std::condition_variable subscribe_retry_;
+  bool subscribe_stopping_;
+  std::unique_ptr<ClientContext> subscribe_context_;
+  std::function<void(const PropertyVerdict &)> subscriber_handler_;
+  std::thread subscriber_;
+
+  // Replica mode: actions are checked against a local copy of the broker's
+  // monitor tables, once the replicator_ thread has fetched them. Every
+  // report_period_ it sends the verdicts found since the last report and the
+  // monitor states with reportReplica, and fetches the tables again if the
+  // broker has another version. Verdicts that can't be reported while the
+  // broker is away wait in unreported_, up to a limit.
+  struct Replica;
+  std::shared_ptr<Replica> replica_;
+  std::mutex replica_mutex_;
+  std::condition_variable replica_wake_;
+  bool replicating_;
+  bool replica_stopping_;
+  bool replica_reachable_;
+  std::chrono::milliseconds report_period_;
+  std::string replica_mission_;
+  std::vector<PropertyVerdict> unreported_;
+  uint64_t unreported_dropped_;
+  std::thread replicator_;
+
+  ClientAssurance(const std::string &client_addr_port, bool use_stream)
       : stub_(Assurance::NewStub(grpc::CreateChannel(
-            client_addr_port, grpc::InsecureChannelCredentials()))) {}
+            client_addr_port, grpc::InsecureChannelCredentials()))),
+        use_stream_(use_stream), stream_closed_(true), batching_(false),
+        batch_stopping_(false), batch_flush_(false), batch_size_(0),
+        subscribe_stopping_(false), replicating_(false),
+        replica_stopping_(false), replica_reachable_(true),
+        unreported_dropped_(0) {}
+
+  void sendUnary(PendingCheck &check);
+  void startUnary(const std::string &current_state);
+  void finishUnary(const Status &status, bool verdict);
+  std::shared_ptr<std::promise<bool>> send(const std::string &current_state,
+                                           bool wait);
+  void openStream();
+  void readVerdicts();
+  void deliver(PendingCheck &check, bool verdict);
+  bool queue(PendingCheck &check);
+  void sendBatches();
+  void sendBatch(Events &events, std::vector<PendingCheck> &checks);
+  void receiveVerdicts(Subscription subscription,
+                       std::function<void(const PropertyVerdict &)> handler);
+  bool stepReplica(PendingCheck &check);
+  void replicate();
+  bool fetchTables(const std::shared_ptr<Replica> &current);
+  bool reportReplica(const Replica &replica, uint64_t &served);
 
 public:
   static ClientAssurance *
-  getInstance(const std::string &client_addr_port = "0.0.0.0:0") {
+  getInstance(const std::string &client_addr_port = "0.0.0.0:0",
+              bool use_stream = true) {
     static ClientAssurance *instance = nullptr;
     if (instance == nullptr) {
-      instance = new ClientAssurance(client_addr_port);
+      instance = new ClientAssurance(client_addr_port, use_stream);
     }
     return instance;
   }
 
   ClientAssurance(ClientAssurance const &) = delete;
   void operator=(ClientAssurance const &) = delete;
+  ~ClientAssurance();
 
   bool checkState(std::string current_state);
+  void postState(std::string current_state);
+
+  // Same as checkState(), without waiting for the verdict
+  std::future<bool> checkStateAsync(std::string current_state);
+
+  // Called with each verdict of postState() and checkState(), from the
+  // thread that received it, so it must not block. Without a handler,
+  // violations are printed.
+  void
+  setVerdictHandler(std::function<void(const std::string &, bool)> handler);
+
+  // Sends actions in batches of up to max_events, each waiting at most
+  // max_delay, with the given mission id and the time they were posted.
+  // Falls back to sending them one by one if the broker has no checkStates.
+  void enableBatching(size_t max_events, std::chrono::microseconds max_delay,
+                      const std::string &mission_id);
+
+  // Passes the violations and acceptances that the broker publishes for the
+  // mission (all missions if empty), or with untagged for the events without
+  // a mission id only, to handler, as soon as they are found.
+  // The handler runs on a thread of its own, and the subscription is renewed
+  // if the broker goes away. Only the first call subscribes. In replica mode,
+  // the verdicts of local checks are passed to handler by the thread that
+  // checks, and not again when the broker publishes them.
+  void subscribeVerdicts(const std::string &mission_id, bool untagged,
+                         std::function<void(const PropertyVerdict &)> handler);
+
+  // Checks actions against the broker's monitor tables locally, reporting
+  // to the broker every report_period, so checks keep working while the
+  // broker can't be reached. Actions are sent to the broker until the tables
+  // have been fetched. Timed monitors are only checked by the broker.
+  void enableReplica(const std::string &mission_id,
+                     std::chrono::milliseconds report_period);
 };
 
 #endif
@@ -31,6 +31,7 @@
 #include "IMissionManager.grpc.pb.h"
 #include "IMissionManager.h"
 #include "Waypoint.pb.h"
+#include "async_client.h"
 #include <grpcpp/grpcpp.h>
 #include <iostream>
 #include <unistd.h>
@@ -42,6 +43,32 @@ using namespace uav;
 
 ClientGuidance *ClientGuidance ::instance = nullptr;
 
+// Guidance answers once MAVSDK has taken the command, which can take a few
+// seconds for takeoff
+static const long GUIDANCE_DEADLINE_MS = 5000;
+
+static void SetDeadline(ClientContext &context) {
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::milliseconds(GUIDANCE_DEADLINE_MS));
+}
+
+// Makes a call that returns nothing on the shared completion queue
+template <typename Request>
+static void CallAsync(
+    Guidance::Stub *stub,
+    AsyncClientQueue::PrepareMethod<Guidance::Stub, Request,
+                                    ::google::protobuf::Empty>
+        prepare,
+    const Request &request, ClientGuidance::StatusCallback done) {
+  AsyncClientQueue::getInstance()->call(
+      stub, prepare, request, GUIDANCE_DEADLINE_MS,
+      [done](const Status &status, const ::google::protobuf::Empty &) {
+        if (done) {
+          done(status);
+        }
+      });
+}
+
 // TODO: can the port change? Should there be a version that doesn't take a
 // port?
 ClientGuidance *
@@ -54,6 +81,7 @@ ClientGuidance ::getInstance(const std::string &client_addr_port) {
 
 void ClientGuidance ::addWaypoint(const Waypoint *waypoint) {
   ClientContext context;
+  SetDeadline(context);
   Waypoint request;
   request = *waypoint;
   ::google::protobuf::Empty reply;
@@ -62,6 +90,7 @@ void ClientGuidance ::addWaypoint(const Waypoint *waypoint) {
 
 void ClientGuidance ::clearRoute(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   last_status = stub_->clearRoute(&context, request, &reply);
@@ -69,6 +98,7 @@ void ClientGuidance ::clearRoute(void) {
 
 int ClientGuidance ::getWaypointCount(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Int32Value reply;
   last_status = stub_->getWaypointCount(&context, request, &reply);
@@ -77,6 +107,7 @@ int ClientGuidance ::getWaypointCount(void) {
 
 void ClientGuidance ::arm(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   last_status = stub_->arm(&context, request, &reply);
@@ -84,6 +115,7 @@ void ClientGuidance ::arm(void) {
 
 void ClientGuidance ::disarm(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   last_status = stub_->disarm(&context, request, &reply);
@@ -91,6 +123,7 @@ void ClientGuidance ::disarm(void) {
 
 void ClientGuidance ::land(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   last_status = stub_->land(&context, request, &reply);
@@ -98,6 +131,7 @@ void ClientGuidance ::land(void) {
 
 void ClientGuidance ::returnToBase(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   last_status = stub_->returnToBase(&context, request, &reply);
@@ -105,6 +139,7 @@ void ClientGuidance ::returnToBase(void) {
 
 void ClientGuidance ::start(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   last_status = stub_->start(&context, request, &reply);
@@ -112,6 +147,7 @@ void ClientGuidance ::start(void) {
 
 void ClientGuidance ::subscribeStatus(const unsigned int periodMsec) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Int32Value request;
   ::google::protobuf::Empty reply;
   request.set_value(periodMsec);
@@ -120,10 +156,51 @@ void ClientGuidance ::subscribeStatus(const unsigned int periodMsec) {
 
 void ClientGuidance ::takeOff(const double takeoffAltitude) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::DoubleValue request;
   ::google::protobuf::Empty reply;
   request.set_value(takeoffAltitude);
   last_status = stub_->takeOff(&context, request, &reply);
 }
 
-grpc::Status ClientGuidance::getLastGrpcStatus() { return last_status; }
\ No newline at end of file
+grpc::Status ClientGuidance::getLastGrpcStatus() { return last_status; }
+void ClientGuidance::addWaypointAsync(const Waypoint &waypoint,
+                                      StatusCallback done) {
+  CallAsync(stub_.get(), &Guidance::Stub::PrepareAsyncaddWaypoint, waypoint,
+            done);
+}
+
+void ClientGuidance::clearRouteAsync(StatusCallback done) {
+  CallAsync(stub_.get(), &Guidance::Stub::PrepareAsyncclearRoute,
+            ::google::protobuf::Empty(), done);
+}
+
+void ClientGuidance::landAsync(StatusCallback done) {
+  CallAsync(stub_.get(), &Guidance::Stub::PrepareAsyncland,
+            ::google::protobuf::Empty(), done);
+}
+
+void ClientGuidance::returnToBaseAsync(StatusCallback done) {
+  CallAsync(stub_.get(), &Guidance::Stub::PrepareAsyncreturnToBase,
+            ::google::protobuf::Empty(), done);
+}
+
+void ClientGuidance::startAsync(StatusCallback done) {
+  CallAsync(stub_.get(), &Guidance::Stub::PrepareAsyncstart,
+            ::google::protobuf::Empty(), done);
+}
+
+void ClientGuidance::subscribeStatusAsync(const unsigned int periodMsec,
+                                          StatusCallback done) {
+  ::google::protobuf::Int32Value request;
+  request.set_value(periodMsec);
+  CallAsync(stub_.get(), &Guidance::Stub::PrepareAsyncsubscribeStatus,
+            request, done);
+}
+
+void ClientGuidance::takeOffAsync(const double takeoffAltitude,
+                                  StatusCallback done) {
+  ::google::protobuf::DoubleValue request;
+  request.set_value(takeoffAltitude);
+  CallAsync(stub_.get(), &Guidance::Stub::PrepareAsynctakeOff, request, done);
+}
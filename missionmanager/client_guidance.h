@@ -33,6 +33,7 @@
 
 using Poco::Logger;
 
+#include <functional>
 #include <iostream>
 #include <string>
 #include <unistd.h>
@@ -42,6 +43,7 @@ using Poco::Logger;
 #include "IMissionManager.grpc.pb.h"
 #include "IMissionManager.h"
 #include "Waypoint.pb.h"
+#include "async_client.h"
 #include <grpcpp/grpcpp.h>
 
 using grpc::Channel;
@@ -49,7 +51,9 @@ using grpc::ClientContext;
 using grpc::Status;
 using namespace uav;
 
-// Client GRPC class that talks to the Guidance component
+// Client GRPC class that talks to the Guidance component. Every call has a
+// deadline. The Async variants return at once and pass the status of the
+// call to an optional callback, which runs on the AsyncClientQueue thread.
 class ClientGuidance : public IGuidance {
 
 private:
@@ -90,6 +94,25 @@ public:
   void takeOff(const double takeoffAltitude);
 
   grpc::Status getLastGrpcStatus();
+
+  using StatusCallback = std::function<void(const grpc::Status &)>;
+
+  void addWaypointAsync(const Waypoint &waypoint,
+                        StatusCallback done = nullptr);
+
+  void clearRouteAsync(StatusCallback done = nullptr);
+
+  void landAsync(StatusCallback done = nullptr);
+
+  void returnToBaseAsync(StatusCallback done = nullptr);
+
+  void startAsync(StatusCallback done = nullptr);
+
+  void subscribeStatusAsync(const unsigned int periodMsec,
+                            StatusCallback done = nullptr);
+
+  void takeOffAsync(const double takeoffAltitude,
+                    StatusCallback done = nullptr);
 };
 
 #endif
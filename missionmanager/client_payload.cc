@@ -30,6 +30,7 @@
 #include "IMissionManager.h"
 #include "IPayload.grpc.pb.h"
 #include "IPayload.h"
+#include "async_client.h"
 #include <grpcpp/grpcpp.h>
 #include <iostream>
 #include <unistd.h>
@@ -39,8 +40,17 @@ using grpc::ClientContext;
 using grpc::Status;
 using namespace uav;
 
+// The payload only moves the release mechanism, so it answers quickly
+static const long PAYLOAD_DEADLINE_MS = 1000;
+
+static void SetDeadline(ClientContext &context) {
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::milliseconds(PAYLOAD_DEADLINE_MS));
+}
+
 bool ClientPayload::getLockStatus(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::BoolValue reply;
   Status status = stub_->getLockStatus(&context, request, &reply);
@@ -49,6 +59,7 @@ bool ClientPayload::getLockStatus(void) {
 
 bool ClientPayload::hasReleased(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::BoolValue reply;
   Status status = stub_->hasReleased(&context, request, &reply);
@@ -57,6 +68,7 @@ bool ClientPayload::hasReleased(void) {
 
 void ClientPayload::lockReleaseMechanism(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   Status status = stub_->lockReleaseMechanism(&context, request, &reply);
@@ -64,6 +76,7 @@ void ClientPayload::lockReleaseMechanism(void) {
 
 bool ClientPayload::releasePayload(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::BoolValue reply;
   Status status = stub_->releasePayload(&context, request, &reply);
@@ -72,7 +85,42 @@ bool ClientPayload::releasePayload(void) {
 
 void ClientPayload::unlockReleaseMechanism(void) {
   ClientContext context;
+  SetDeadline(context);
   ::google::protobuf::Empty request;
   ::google::protobuf::Empty reply;
   Status status = stub_->unlockReleaseMechanism(&context, request, &reply);
 }
+
+void ClientPayload::lockReleaseMechanismAsync(StatusCallback done) {
+  AsyncClientQueue::getInstance()->call(
+      stub_.get(), &Payload::Stub::PrepareAsynclockReleaseMechanism,
+      ::google::protobuf::Empty(), PAYLOAD_DEADLINE_MS,
+      [done](const Status &status, const ::google::protobuf::Empty &) {
+        if (done) {
+          done(status);
+        }
+      });
+}
+
+void ClientPayload::releasePayloadAsync(
+    std::function<void(const grpc::Status &, bool released)> done) {
+  AsyncClientQueue::getInstance()->call(
+      stub_.get(), &Payload::Stub::PrepareAsyncreleasePayload,
+      ::google::protobuf::Empty(), PAYLOAD_DEADLINE_MS,
+      [done](const Status &status, const ::google::protobuf::BoolValue &reply) {
+        if (done) {
+          done(status, status.ok() && reply.value());
+        }
+      });
+}
+
+void ClientPayload::unlockReleaseMechanismAsync(StatusCallback done) {
+  AsyncClientQueue::getInstance()->call(
+      stub_.get(), &Payload::Stub::PrepareAsyncunlockReleaseMechanism,
+      ::google::protobuf::Empty(), PAYLOAD_DEADLINE_MS,
+      [done](const Status &status, const ::google::protobuf::Empty &) {
+        if (done) {
+          done(status);
+        }
+      });
+}
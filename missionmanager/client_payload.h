@@ -33,6 +33,7 @@
 
 using Poco::Logger;
 
+#include <functional>
 #include <iostream>
 #include <string>
 #include <unistd.h>
@@ -41,6 +42,7 @@ using Poco::Logger;
 #include "IMissionManager.h"
 #include "IPayload.grpc.pb.h"
 #include "IPayload.h"
+#include "async_client.h"
 #include <grpcpp/grpcpp.h>
 
 using grpc::Channel;
@@ -48,7 +50,9 @@ using grpc::ClientContext;
 using grpc::Status;
 using namespace uav;
 
-// Client GRPC class that talks to the Payload component
+// Client GRPC class that talks to the Payload component. Every call has a
+// deadline. The Async variants return at once and pass the status of the
+// call to an optional callback, which runs on the AsyncClientQueue thread.
 class ClientPayload : public IPayload {
 
 private:
@@ -76,6 +80,14 @@ public:
   void lockReleaseMechanism(void);
   bool releasePayload(void);
   void unlockReleaseMechanism(void);
+
+  using StatusCallback = std::function<void(const grpc::Status &)>;
+
+  void lockReleaseMechanismAsync(StatusCallback done = nullptr);
+  // released is the reply of the payload, false if the call failed
+  void releasePayloadAsync(
+      std::function<void(const grpc::Status &, bool released)> done = nullptr);
+  void unlockReleaseMechanismAsync(StatusCallback done = nullptr);
 };
 
 #endif
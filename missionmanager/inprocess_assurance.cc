@@ -0,0 +1,105 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#include "inprocess_assurance.h"
+#include "ltlmonbank.hpp"
+#include "prop1_monitor.hpp"
+#include <chrono>
+#include <iostream>
+
+InProcessAssurance::InProcessAssurance(
+    Logger *log, const std::vector<std::string> &monitor_paths,
+    const std::string &mission_id)
+    : log_ptr(log), mission_id_(mission_id), bank_(new LTLMonitorBank()) {
+  // Compiled in from ltlmon-rt/tests/prop1.mon, as in the broker. It is
+  // stepped in the bank rather than as a StaticLTLMonitor, so that
+  // concurrent checks step it without a lock, like the loaded monitors.
+  LTLMonitor prop1;
+  prop1.initialize<Prop1Monitor>();
+  bank_->add(std::move(prop1));
+  for (const auto &path : monitor_paths) {
+    if (!bank_->load(path)) {
+      log_ptr->error("Could not load monitor " + path);
+    }
+  }
+  accepted_.reset(new std::atomic<bool>[bank_->size()]);
+  for (size_t i = 0; i < bank_->size(); ++i) {
+    accepted_[i].store(false, std::memory_order_relaxed);
+    log_ptr->information("Monitoring property in process: " +
+                         bank_->getMonitor(i).getProperty());
+  }
+}
+
+InProcessAssurance::~InProcessAssurance() {}
+
+void InProcessAssurance::subscribeVerdicts(
+    std::function<void(const uav::PropertyVerdict &)> handler) {
+  verdict_handler_ = std::move(handler);
+}
+
+void InProcessAssurance::publish(uav::PropertyVerdict::Kind kind,
+                                 size_t monitor, const std::string &action) {
+  uav::PropertyVerdict verdict;
+  verdict.set_kind(kind);
+  verdict.set_property(bank_->getMonitor(monitor).getProperty());
+  verdict.set_missionid(mission_id_);
+  verdict.set_action(action);
+  verdict.set_timestamp(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  verdict_handler_(verdict);
+}
+
+bool InProcessAssurance::checkState(std::string current_state) {
+  // Several threads may check states, so the bank is stepped concurrently
+  // and each call has its own mask
+  LTLMonitorBank::MaskT violated;
+  bank_->stepConcurrent(current_state, violated);
+  bool result = !LTLMonitorBank::anyViolated(violated);
+
+  for (size_t i = 0; i < bank_->size(); ++i) {
+    if (LTLMonitorBank::isViolated(violated, i)) {
+      if (verdict_handler_) {
+        publish(uav::PropertyVerdict::VIOLATION, i, current_state);
+      } else {
+        std::cout << "Monitor reports a violation of "
+                  << bank_->getMonitor(i).getProperty() << " for action "
+                  << current_state << std::endl;
+      }
+    } else if (verdict_handler_ &&
+               bank_->getMonitor(i).getAutomaton().getStateType(
+                   bank_->getState(i)) == State::ACCEPT &&
+               !accepted_[i].exchange(true, std::memory_order_relaxed)) {
+      publish(uav::PropertyVerdict::ACCEPTANCE, i, current_state);
+    }
+  }
+  return result;
+}
+
+void InProcessAssurance::postState(std::string current_state) {
+  checkState(current_state);
+}
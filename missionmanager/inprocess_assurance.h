@@ -0,0 +1,93 @@
+/*
+ * FALSA Model Problem
+ * 
+ * Copyright 2024 Carnegie Mellon University.
+ * 
+ * NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ * INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ * UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED, AS
+ * TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR PURPOSE
+ * OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF THE
+ * MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF ANY KIND
+ * WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ * 
+ * Licensed under a MIT (SEI)-style license, please see license.txt or contact
+ * permission@sei.cmu.edu for full terms.
+ * 
+ * [DISTRIBUTION STATEMENT A] This material has been approved for public
+ * release and unlimited distribution.  Please see Copyright notice for non-US
+ * Government use and distribution.
+ * 
+ * This Software includes and/or makes use of Third-Party Software each subject
+ * to its own license.
+ * 
+ * DM24-0251
+ */
+
+#ifndef INPROCESS_ASSURANCE_H_H
+#define INPROCESS_ASSURANCE_H_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IAssurance.h"
+#include "IAssurance.pb.h"
+#include "Poco/Logger.h"
+
+using Poco::Logger;
+
+// Declared only: the State of ltlmon-rt would clash with that of Status.proto
+// in the mission manager
+class LTLMonitorBank;
+
+// Checks the states of the mission with monitors linked into the mission
+// manager, instead of sending them to the assurance broker. The monitors are
+// those the broker compiles in, and the .mon and .monb files it is given.
+// Each check steps them on the calling thread, so its verdict is known as
+// soon as the state changes, without a process, socket or thread in between.
+class InProcessAssurance : public IAssurance {
+
+private:
+  Logger *log_ptr;
+  std::string mission_id_;
+  std::unique_ptr<LTLMonitorBank> bank_;
+  // Per monitor, whether the handler was told that its property is satisfied
+  std::unique_ptr<std::atomic<bool>[]> accepted_;
+  std::function<void(const uav::PropertyVerdict &)> verdict_handler_;
+
+  InProcessAssurance(Logger *log, const std::vector<std::string> &monitor_paths,
+                     const std::string &mission_id);
+
+  void publish(uav::PropertyVerdict::Kind kind, size_t monitor,
+               const std::string &action);
+
+public:
+  static InProcessAssurance *
+  getInstance(Logger *log, const std::vector<std::string> &monitor_paths = {},
+              const std::string &mission_id = "") {
+    static InProcessAssurance *instance = nullptr;
+    if (instance == nullptr) {
+      instance = new InProcessAssurance(log, monitor_paths, mission_id);
+    }
+    return instance;
+  }
+
+  InProcessAssurance(InProcessAssurance const &) = delete;
+  void operator=(InProcessAssurance const &) = delete;
+  ~InProcessAssurance();
+
+  bool checkState(std::string current_state);
+  void postState(std::string current_state);
+
+  // Passes the violations and acceptances to handler, like
+  // ClientAssurance::subscribeVerdicts() does, but on the thread that checked
+  // the state and before checkState() returns. Must be called before the
+  // first check. Without a handler, violations are printed.
+  void subscribeVerdicts(
+      std::function<void(const uav::PropertyVerdict &)> handler);
+};
+
+#endif
@@ -32,6 +32,17 @@ ClientGuidance *ImplMissionManager::client1 = nullptr;
 Logger *ImplMissionManager::log_ptr = nullptr;
 StateControl *ImplMissionManager::state_control = nullptr;
 
+// Guidance calls are made without waiting, so that neither the GCS commands
+// nor the status handler wait on guidance; failures are only logged
+static ClientGuidance::StatusCallback LogFailure(Logger *log,
+                                                 const std::string &call) {
+  return [log, call](const grpc::Status &status) {
+    if (!status.ok()) {
+      log->error("Guidance " + call + " failed: " + status.error_message());
+    }
+  };
+}
+
 ImplMissionManager::ImplMissionManager(void) {
   std::cout << "ImplMissionManager called" << std::endl;
   if (client1 == nullptr) {
@@ -83,7 +94,7 @@ void ImplMissionManager::setMissionParams(LatLonCoord destinationInput,
     wp.mutable_latlon()->set_latitude(destination.latitude());
     wp.mutable_latlon()->set_longitude(destination.longitude());
     wp.set_altitude(takeoffAltitude);
-    client1->addWaypoint(&wp);
+    client1->addWaypointAsync(wp, LogFailure(log_ptr, "addWaypoint"));
     log_ptr->information("Sending Waypoint to guidance component.");
     state_control->SetLatLonCoordDest(destinationInput);
     state_control->SetTimeDest(endTimeInput.epoch() - startTimeInput.epoch());
@@ -113,7 +124,7 @@ void ImplMissionManager::clearMissionParams(void) {
 
 void ImplMissionManager::takeOff(void) {
   if (state_control->GetMissionState() == MissionState::PARAMETERS_SET) {
-    client1->takeOff(takeoffAltitude);
+    client1->takeOffAsync(takeoffAltitude, LogFailure(log_ptr, "takeOff"));
     state_control->SetMissionState(MissionState::TAKEOFF_STARTED);
     log_ptr->information("Takeoff Initiated. State is now TAKEOFF_STARTED");
   } else {
@@ -126,9 +137,14 @@ void ImplMissionManager::abort(void) {
   if (missionState != MissionState::INITIALIZED &&
       missionState != MissionState::PARAMETERS_SET &&
       missionState != MissionState::LANDED &&
-      missionState != MissionState::LANDING_AT_BASE) {
-    client1->clearRoute();
-    client1->returnToBase();
+      missionState != MissionState::LANDING_AT_BASE &&
+      missionState != MissionState::RETURNING_TO_BASE) {
+    // The route is cleared before guidance is told to return
+    Logger *log = log_ptr;
+    client1->clearRouteAsync([log](const grpc::Status &status) {
+      LogFailure(log, "clearRoute")(status);
+      client1->returnToBaseAsync(LogFailure(log, "returnToBase"));
+    });
     state_control->SetMissionState(MissionState::RETURNING_TO_BASE);
     log_ptr->information("Abort initiated. State is now RETURNING_TO_BASE");
   } else {
@@ -162,7 +178,7 @@ void ImplMissionManager::saveStatus(StatusMessage statusMessage) {
     state_control->SetMissionState(MissionState::FLYING_TO_DESTINATION);
     if ((previous_state == TAKINGOFF) || (previous_state == INITIALIZED)) {
       log_ptr->information("Sending start command");
-      client1->start();
+      client1->startAsync(LogFailure(log_ptr, "start"));
     }
     break;
   case FLYINGTOBASE:
@@ -175,13 +191,13 @@ void ImplMissionManager::saveStatus(StatusMessage statusMessage) {
       state_control->SetMissionState(MissionState::AT_DESTINATION);
     } else {
       log_ptr->information("ReturnToBase() sent.");
-      client1->returnToBase();
+      client1->returnToBaseAsync(LogFailure(log_ptr, "returnToBase"));
     }
     break;
   case BASEREACHED:
     log_ptr->information("State is now LANDING_AT_BASE");
     state_control->SetMissionState(MissionState::LANDING_AT_BASE);
-    client1->land();
+    client1->landAsync(LogFailure(log_ptr, "land"));
     break;
   case LASTWAYPOINTUNREACHABLE:
     log_ptr->information("State is now RETURNING_TO_BASE");
@@ -33,15 +33,20 @@
 #include "Poco/Task.h"
 #include "Poco/TaskManager.h"
 #include "Poco/Util/HelpFormatter.h"
+#include "Poco/Util/IntValidator.h"
 #include "Poco/Util/Option.h"
 #include "Poco/Util/OptionSet.h"
+#include "Poco/Util/RegExpValidator.h"
 #include "Poco/Util/ServerApplication.h"
 
 #include "portutils.h"
 
+#include "client_assurance.h"
 #include "client_guidance.h"
 #include "client_payload.h"
+#include "inprocess_assurance.h"
 #include "server_gcs.h"
+#include "missionmanager.h"
 #include "server_guidance.h"
 #include "timer_util.h"
 
@@ -55,9 +60,11 @@ using Poco::Task;
 using Poco::TaskManager;
 using Poco::Util::Application;
 using Poco::Util::HelpFormatter;
+using Poco::Util::IntValidator;
 using Poco::Util::Option;
 using Poco::Util::OptionCallback;
 using Poco::Util::OptionSet;
+using Poco::Util::RegExpValidator;
 using Poco::Util::ServerApplication;
 
 class ServerStatusTask : public Task {
@@ -100,7 +107,9 @@ private:
 
 class MissionManagerApp : public ServerApplication {
 public:
-  MissionManagerApp() : _helpRequested(false) {}
+  MissionManagerApp()
+      : _helpRequested(false), _batchEvents(0), _batchDelayUs(1000),
+        _abortOnViolation(false), _reportPeriodMs(1000) {}
 
   ~MissionManagerApp() {}
 
@@ -135,6 +144,104 @@ protected:
             .repeatable(false)
             .callback(OptionCallback<MissionManagerApp>(
                 this, &MissionManagerApp::handleHelp)));
+
+    options.addOption(
+        Option("batch", "b",
+               "send states to the assurance broker in batches of up to the "
+               "given number (default 0, no batching)")
+            .required(false)
+            .repeatable(false)
+            .argument("events")
+            .validator(new IntValidator(0, 100000))
+            .callback(OptionCallback<MissionManagerApp>(
+                this, &MissionManagerApp::handleBatch)));
+
+    options.addOption(
+        Option("batch-delay", "d",
+               "longest time a state waits for its batch to be sent "
+               "(default 1000)")
+            .required(false)
+            .repeatable(false)
+            .argument("microseconds")
+            .validator(new IntValidator(0, 10000000))
+            .callback(OptionCallback<MissionManagerApp>(
+                this, &MissionManagerApp::handleBatchDelay)));
+
+    options.addOption(
+        Option("mission", "m", "mission id sent with the batched states")
+            .required(false)
+            .repeatable(false)
+            .argument("id")
+            .callback(OptionCallback<MissionManagerApp>(
+                this, &MissionManagerApp::handleMission)));
+
+    options.addOption(
+        Option("abort-on-violation", "a",
+               "subscribe to the verdicts of the assurance broker and abort "
+               "the mission as soon as a property is violated")
+            .required(false)
+            .repeatable(false)
+            .callback(OptionCallback<MissionManagerApp>(
+                this, &MissionManagerApp::handleAbortOnViolation)));
+
+    options.addOption(
+        Option("assurance", "s",
+               "where states are checked: remote, by the assurance broker "
+               "(default), inprocess, by monitors linked into the mission "
+               "manager, or replica, by the monitor tables of the broker "
+               "stepped in the mission manager; also read from "
+               "assurance.backend in the configuration")
+            .required(false)
+            .repeatable(false)
+            .argument("backend")
+            .validator(new RegExpValidator("remote|inprocess|replica"))
+            .binding("assurance.backend"));
+
+    options.addOption(
+        Option("report-period", "r",
+               "with the replica backend, time between reports of verdicts "
+               "and monitor states to the broker (default 1000)")
+            .required(false)
+            .repeatable(false)
+            .argument("milliseconds")
+            .validator(new IntValidator(10, 600000))
+            .callback(OptionCallback<MissionManagerApp>(
+                this, &MissionManagerApp::handleReportPeriod)));
+
+    options.addOption(
+        Option("monitor", "o",
+               "with the inprocess backend, also check the monitor in the "
+               "given .mon or .monb file")
+            .required(false)
+            .repeatable(true)
+            .argument("file")
+            .callback(OptionCallback<MissionManagerApp>(
+                this, &MissionManagerApp::handleMonitor)));
+  }
+
+  void handleMonitor(const std::string &name, const std::string &value) {
+    _monitorPaths.push_back(value);
+  }
+
+  void handleReportPeriod(const std::string &name, const std::string &value) {
+    _reportPeriodMs = std::stoi(value);
+  }
+
+  void handleBatch(const std::string &name, const std::string &value) {
+    _batchEvents = std::stoi(value);
+  }
+
+  void handleBatchDelay(const std::string &name, const std::string &value) {
+    _batchDelayUs = std::stoi(value);
+  }
+
+  void handleMission(const std::string &name, const std::string &value) {
+    _missionId = value;
+  }
+
+  void handleAbortOnViolation(const std::string &name,
+                              const std::string &value) {
+    _abortOnViolation = true;
   }
 
   void handleHelp(const std::string &name, const std::string &value) {
@@ -186,9 +293,55 @@ protected:
       sleep(1); // Wait for first thread to be establsihed
       tm.start(new ServerStatusTask(status_server_port));
 
-      // Periodic timer thread
+      Logger *log = &logger();
+      auto on_verdict = [log](const PropertyVerdict &v) {
+        if (v.kind() == PropertyVerdict::VIOLATION) {
+          log->warning("Action " + v.action() + " violates property " +
+                       v.property() + ", aborting");
+          ImplMissionManager::getInstance(log)->abort();
+        } else {
+          log->information("Property " + v.property() + " is satisfied");
+        }
+      };
+
+      IAssurance *assurance;
+      std::string backend = config().getString("assurance.backend", "remote");
+      if (backend == "inprocess") {
+        log->information("Checking states in process");
+        InProcessAssurance *inprocess =
+            InProcessAssurance::getInstance(log, _monitorPaths, _missionId);
+        if (_abortOnViolation) {
+          inprocess->subscribeVerdicts(on_verdict);
+        }
+        assurance = inprocess;
+      } else {
+        ClientAssurance *client =
+            ClientAssurance::getInstance(assurancebrkr_client_port);
+        if (_batchEvents > 0) {
+          client->enableBatching(_batchEvents,
+                                 std::chrono::microseconds(_batchDelayUs),
+                                 _missionId);
+        }
+        if (backend == "replica") {
+          log->information("Checking states against the broker's monitor "
+                           "tables");
+          client->enableReplica(_missionId,
+                                std::chrono::milliseconds(_reportPeriodMs));
+        }
+        if (_abortOnViolation) {
+          // Only batches and replica reports carry the mission id. Other
+          // checks have none, so their verdicts are asked for as such,
+          // without those of the other missions.
+          bool tagged = _batchEvents > 0 || backend == "replica";
+          client->subscribeVerdicts(tagged ? _missionId : "", !tagged,
+                                    on_verdict);
+        }
+        assurance = client;
+      }
+
+      // Reactions to state changes, with a watchdog timer
       TimerUtil timerUtil(guidance_client_port, payload_client_port,
-                          assurancebrkr_client_port);
+                          assurance);
       Timer *timer = timerUtil.launchTimer();
 
       waitForTerminationRequest();
@@ -201,6 +354,12 @@ protected:
 
 private:
   bool _helpRequested;
+  int _batchEvents;
+  int _batchDelayUs;
+  std::string _missionId;
+  bool _abortOnViolation;
+  std::vector<std::string> _monitorPaths;
+  int _reportPeriodMs;
 };
 
 // This is a substitute for the main program in C++
@@ -28,7 +28,9 @@
 
 StateControl *StateControl ::instancePtr = nullptr;
 
-StateControl::StateControl(void) {}
+StateControl::StateControl(void)
+    : mission_state(MissionState::INITIALIZED),
+      locked_state(LockedState::LOCKED), altitude(0.0), time_dest(0.0) {}
 
 StateControl::~StateControl() {}
 
@@ -53,8 +55,12 @@ StateControl *StateControl::getInstance(void) {
 
 void StateControl::SetMissionState(const MissionState ms) {
   LockMissionState();
+  bool changed = mission_state != ms;
   mission_state = ms;
   UnlockMissionState();
+  if (changed) {
+    Publish(StateChange::MISSION_STATE, ms);
+  }
 }
 
 MissionState StateControl::GetMissionState(void) {
@@ -67,8 +73,12 @@ MissionState StateControl::GetMissionState(void) {
 
 void StateControl::SetLockedState(const LockedState ls) {
   LockLockedState();
+  bool changed = locked_state != ls;
   locked_state = ls;
   UnlockLockedState();
+  if (changed) {
+    Publish(StateChange::LOCKED_STATE, GetMissionState());
+  }
 }
 
 LockedState StateControl::GetLockedState(void) {
@@ -79,7 +89,10 @@ LockedState StateControl::GetLockedState(void) {
   return ret_ls;
 }
 
-void StateControl::SetLatLonCoord(LatLonCoord llc) { lat_lon = llc; }
+void StateControl::SetLatLonCoord(LatLonCoord llc) {
+  lat_lon = llc;
+  Publish(StateChange::POSITION, GetMissionState());
+}
 
 LatLonCoord StateControl::GetLatLonCoord() { return lat_lon; }
 
@@ -95,6 +108,26 @@ void StateControl::SetTimeDest(double t) { time_dest = t; }
 
 double StateControl::GetTimeDest(void) { return time_dest; }
 
+int StateControl::AddListener(StateListener listener) {
+  std::lock_guard<std::mutex> lock(listeners_mtx);
+  listeners[next_listener] = listener;
+  return next_listener++;
+}
+
+void StateControl::RemoveListener(int id) {
+  std::lock_guard<std::mutex> lock(listeners_mtx);
+  listeners.erase(id);
+}
+
+// Held while the listeners run, so that none is called after
+// RemoveListener() returns
+void StateControl::Publish(StateChange change, MissionState ms) {
+  std::lock_guard<std::mutex> lock(listeners_mtx);
+  for (auto &listener : listeners) {
+    listener.second(change, ms);
+  }
+}
+
 void StateControl::LockMissionState(void) { mission_state_mtx.lock(); }
 
 void StateControl::UnlockMissionState(void) { mission_state_mtx.unlock(); }
@@ -28,6 +28,8 @@
 #define STATE_CONTROL_H_H
 
 #include "LatLonCoord.pb.h"
+#include <functional>
+#include <map>
 #include <mutex>
 
 using namespace uav;
@@ -46,6 +48,13 @@ enum class MissionState {
 
 enum class LockedState { LOCKED = 0, UNLOCKED = 1 };
 
+// What a setter changed, as passed to the listeners. The mission and locked
+// states are only published when their value changes; the position on every
+// status update.
+enum class StateChange { MISSION_STATE, LOCKED_STATE, POSITION };
+
+using StateListener = std::function<void(StateChange, MissionState)>;
+
 // Class that allows management of different state vatiables
 class StateControl {
 public:
@@ -63,6 +72,11 @@ public:
   LatLonCoord GetLatLonCoordDest(void);
   void SetTimeDest(double t);
   double GetTimeDest(void);
+  // Listeners are called by the thread that sets the state, with the mission
+  // state after the change. They must return quickly and must not set state
+  // themselves, e.g. by handing the change to a thread of their own.
+  int AddListener(StateListener listener);
+  void RemoveListener(int id);
 
 private:
   MissionState mission_state;
@@ -73,6 +87,9 @@ private:
   double time_dest;
   std::mutex mission_state_mtx;
   std::mutex locked_state_mtx;
+  std::map<int, StateListener> listeners;
+  int next_listener = 0;
+  std::mutex listeners_mtx;
   static StateControl *instancePtr;
   StateControl(void);
   ~StateControl();
@@ -80,6 +97,7 @@ private:
   void UnlockMissionState(void);
   void LockLockedState(void);
   void UnlockLockedState(void);
+  void Publish(StateChange change, MissionState ms);
 };
 
 #endif
@@ -27,79 +27,166 @@
 #include "timer_util.h"
 
 const unsigned TimerUtil::STATUS_UPDATE_PERIOD_MSEC = 2000;
-static bool already_released = false;
+// Period of the watchdog, which also considers guidance gone after this long
+// without a status
+const unsigned TimerUtil::WATCHDOG_PERIOD_MSEC = 3 * STATUS_UPDATE_PERIOD_MSEC;
 
-void TimerUtil::periodicTimerCall(Timer &timer) {
+static long long SteadyMillis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Called by the thread that changed the state, e.g. the status handler
+void TimerUtil::post(StateChange change, MissionState ms) {
+  if (change == StateChange::POSITION) {
+    last_status_ms.store(SteadyMillis(), std::memory_order_relaxed);
+  }
+  {
+    std::lock_guard<std::mutex> lock(events_mtx);
+    if (change == StateChange::POSITION && !events.empty() &&
+        events.back().change == StateChange::POSITION) {
+      return;
+    }
+    events.push_back(StateEvent{change, ms});
+  }
+  events_cv.notify_one();
+}
+
+void TimerUtil::runReactions(void) {
+  std::unique_lock<std::mutex> lock(events_mtx);
+  while (true) {
+    events_cv.wait(lock, [this] { return stopping || !events.empty(); });
+    if (stopping) {
+      return;
+    }
+    StateEvent event = events.front();
+    events.pop_front();
+    lock.unlock();
+    react(event);
+    lock.lock();
+  }
+}
+
+// Mission states are reported in the order they were set. The payload
+// decisions use the current state, so a change that is already outdated
+// does nothing.
+void TimerUtil::react(const StateEvent &event) {
   const double delta = 0.001;
 
-  // if we haven't successfully subscribed to status yet, try again
-  if (!subscribed_to_status) {
-    clientGuidance->subscribeStatus(STATUS_UPDATE_PERIOD_MSEC);
-    subscribed_to_status = clientGuidance->getLastGrpcStatus().ok();
+  if (event.change == StateChange::MISSION_STATE) {
+    switch (event.mission_state) {
+    case MissionState::AT_DESTINATION:
+      std::cout << "State is AT_DESTINATION" << std::endl;
+      clientAssurance->postState("at_destination");
+      break;
+    case MissionState::DROP_SUPPLIES:
+      clientAssurance->postState("drop_supplies");
+      break;
+    default:
+      break;
+    }
   }
 
   MissionState mission_state = state_control->GetMissionState();
   LockedState locked_state = state_control->GetLockedState();
-  LatLonCoord lat_lon = state_control->GetLatLonCoord();
-  LatLonCoord lat_lon_dest = state_control->GetLatLonCoordDest();
-  double time_dest = state_control->GetTimeDest();
-  elapsed_time += 0.5; // We are called every 500ms
-
   switch (mission_state) {
   case MissionState::AT_DESTINATION:
-    std::cout << "State is AT_DESTINATION" << std::endl;
-    clientAssurance->checkState("at_destination");
-    if ((locked_state == LockedState::UNLOCKED) &&
-        (mission_state != MissionState::DROP_SUPPLIES)) {
+    if (locked_state == LockedState::UNLOCKED) {
       std::cout << std::endl
                 << "*** RELEASING PAYLOAD ***" << std::endl
                 << std::endl;
-      clientPayload->releasePayload();
+      // The mechanism is locked again once the payload has answered
+      clientPayload->releasePayloadAsync(
+          [this](const grpc::Status &status, bool released) {
+            if (!status.ok()) {
+              std::cout << "Payload release failed: "
+                        << status.error_message() << std::endl;
+            }
+            clientPayload->lockReleaseMechanismAsync();
+          });
       state_control->SetMissionState(MissionState::DROP_SUPPLIES);
       state_control->SetLockedState(LockedState::LOCKED);
-      clientPayload->lockReleaseMechanism();
       already_released = true;
     }
     break;
-  case MissionState::DROP_SUPPLIES:
-    clientAssurance->checkState("drop_supplies");
-    break;
-  case MissionState::FLYING_TO_DESTINATION:
+  case MissionState::FLYING_TO_DESTINATION: {
     // Check if we are close to the destination
     // If so then unlock the release mechanism
-    if (!already_released) {
-      if ((abs(lat_lon.latitude() - lat_lon_dest.latitude()) < delta) &&
-          (abs(lat_lon.longitude() - lat_lon_dest.longitude()) < delta) &&
-          (locked_state == LockedState::LOCKED)) {
-        std::cout << std::endl
-                  << "*** UNLOCKING RELEASE MECHANISM ***" << std::endl
-                  << std::endl;
-        clientPayload->unlockReleaseMechanism();
-        state_control->SetLockedState(LockedState::UNLOCKED);
-      }
+    LatLonCoord lat_lon = state_control->GetLatLonCoord();
+    LatLonCoord lat_lon_dest = state_control->GetLatLonCoordDest();
+    if (!already_released &&
+        (abs(lat_lon.latitude() - lat_lon_dest.latitude()) < delta) &&
+        (abs(lat_lon.longitude() - lat_lon_dest.longitude()) < delta) &&
+        (locked_state == LockedState::LOCKED)) {
+      std::cout << std::endl
+                << "*** UNLOCKING RELEASE MECHANISM ***" << std::endl
+                << std::endl;
+      clientPayload->unlockReleaseMechanismAsync();
+      state_control->SetLockedState(LockedState::UNLOCKED);
     }
     break;
   }
+  default:
+    break;
+  }
+}
+
+// Subscribes to status again if the last attempt failed, or if no status
+// arrived for a while
+void TimerUtil::watchdogTimerCall(Timer &timer) {
+  long long quiet_ms =
+      SteadyMillis() - last_status_ms.load(std::memory_order_relaxed);
+  if (subscribed_to_status && quiet_ms > WATCHDOG_PERIOD_MSEC) {
+    std::cout << "No status from guidance for " << quiet_ms
+              << " ms, subscribing again" << std::endl;
+    subscribed_to_status = false;
+  }
+  if (!subscribed_to_status) {
+    last_status_ms.store(SteadyMillis(), std::memory_order_relaxed);
+    clientGuidance->subscribeStatusAsync(
+        STATUS_UPDATE_PERIOD_MSEC, [this](const grpc::Status &status) {
+          subscribed_to_status = status.ok();
+        });
+  }
 }
 
 TimerUtil::TimerUtil(std::string guidance_client_port,
-                     std::string payload_client_port,
-                     std::string assurancebrkr_client_port) {
+                     std::string payload_client_port, IAssurance *assurance) {
   clientPayload = ClientPayload::getInstance(payload_client_port);
   clientPayload->lockReleaseMechanism();
   state_control = StateControl::getInstance();
-  clientAssurance = ClientAssurance::getInstance(assurancebrkr_client_port);
+  clientAssurance = assurance;
   clientGuidance = ClientGuidance::getInstance(guidance_client_port);
   clientGuidance->subscribeStatus(STATUS_UPDATE_PERIOD_MSEC);
   subscribed_to_status = clientGuidance->getLastGrpcStatus().ok();
-  elapsed_time = 0.0;
+  last_status_ms.store(SteadyMillis(), std::memory_order_relaxed);
 }
 
-TimerUtil::~TimerUtil() { delete clientPayload; }
+TimerUtil::~TimerUtil() {
+  if (listener_id >= 0) {
+    state_control->RemoveListener(listener_id);
+  }
+  {
+    std::lock_guard<std::mutex> lock(events_mtx);
+    stopping = true;
+  }
+  events_cv.notify_one();
+  if (executor.joinable()) {
+    executor.join();
+  }
+  delete clientPayload;
+}
 
 Timer *TimerUtil::launchTimer(void) {
-  TimerCallback<TimerUtil> timerCallback(*this, &TimerUtil::periodicTimerCall);
-  Timer *timer = new Timer(0, 500);
+  executor = std::thread(&TimerUtil::runReactions, this);
+  listener_id = state_control->AddListener(
+      [this](StateChange change, MissionState ms) { post(change, ms); });
+  // Reacts once to the state set before the listener was added
+  post(StateChange::LOCKED_STATE, state_control->GetMissionState());
+
+  TimerCallback<TimerUtil> timerCallback(*this, &TimerUtil::watchdogTimerCall);
+  Timer *timer = new Timer(WATCHDOG_PERIOD_MSEC, WATCHDOG_PERIOD_MSEC);
   timer->start(timerCallback);
   return timer;
 }
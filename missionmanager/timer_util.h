@@ -27,36 +27,72 @@
 #ifndef TIMER_UTIL_H_H
 #define TIMER_UTIL_H_H
 
+#include "IAssurance.h"
 #include "Poco/Logger.h"
 #include "Poco/Timer.h"
-#include "client_assurance.h"
 #include "client_guidance.h"
 #include "client_payload.h"
 #include "state_control.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <unistd.h>
 
 using Poco::Logger;
 using Poco::Timer;
 using Poco::TimerCallback;
 
-// Timer class that emulates a periodic task
+// Reacts to the changes that saveStatus makes to StateControl: unlocks the
+// release mechanism near the destination, releases the payload once there,
+// and reports mission states to assurance. Changes are queued in order and
+// handled on an executor thread of their own, so the status handler never
+// waits for the reactions, and the payload calls don't wait for the payload.
+// A low-rate watchdog timer only renews the status subscription when
+// guidance goes quiet.
 class TimerUtil {
 public:
+  // States are checked with assurance, the assurance broker or the monitors
+  // of the mission manager itself
   TimerUtil(std::string guidance_client_port, std::string payload_client_port,
-            std::string assurancebrkr_client_port);
+            IAssurance *assurance);
   ~TimerUtil();
-  void periodicTimerCall(Timer &timer);
+  void watchdogTimerCall(Timer &timer);
+  // Starts reacting to changes, and returns the watchdog timer
   Timer *launchTimer(void);
 
 private:
+  struct StateEvent {
+    StateChange change;
+    MissionState mission_state;
+  };
+
   ClientPayload *clientPayload;
-  ClientAssurance *clientAssurance;
+  IAssurance *clientAssurance;
   StateControl *state_control;
   ClientGuidance *clientGuidance;
-  double elapsed_time;
-  bool subscribed_to_status = false;
+  std::atomic<bool> subscribed_to_status{false};
+  bool already_released = false;
   static const unsigned STATUS_UPDATE_PERIOD_MSEC;
+  static const unsigned WATCHDOG_PERIOD_MSEC;
+
+  // Changes waiting for the executor. Consecutive position updates are
+  // merged, as only the latest position matters.
+  std::mutex events_mtx;
+  std::condition_variable events_cv;
+  std::deque<StateEvent> events;
+  bool stopping = false;
+  std::thread executor;
+  int listener_id = -1;
+  // Steady clock time of the last status, in milliseconds
+  std::atomic<long long> last_status_ms{0};
+
+  void post(StateChange change, MissionState ms);
+  void runReactions(void);
+  void react(const StateEvent &event);
 };
 
 #endif